@@ -0,0 +1,102 @@
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+// heap traffic counters, used by model.h to report what an import cost
+// allocations are only counted when built with -DTRACK_ALLOCATIONS (replaces the global operator new)
+// ! the replacement is not inline, only include this with TRACK_ALLOCATIONS from a single translation unit (main.cpp)
+
+// running totals, atomic since import work runs on the worker pool
+struct AllocCounters
+{
+    std::atomic<size_t> allocations{0};
+    std::atomic<size_t> bytesAllocated{0};
+    std::atomic<size_t> bytesCopied{0};
+};
+
+inline AllocCounters allocCounters;
+
+// snapshot of the counters, subtract two to get what happened in between
+struct AllocStats
+{
+    size_t allocations = 0;
+    size_t bytesAllocated = 0;
+    size_t bytesCopied = 0; // counted by hand wherever data is copied (model import: aiMesh -> Vertex / index buffers)
+
+    static AllocStats Now()
+    {
+        AllocStats now;
+        now.allocations = allocCounters.allocations.load(std::memory_order_relaxed);
+        now.bytesAllocated = allocCounters.bytesAllocated.load(std::memory_order_relaxed);
+        now.bytesCopied = allocCounters.bytesCopied.load(std::memory_order_relaxed);
+        return now;
+    }
+
+    AllocStats operator-(const AllocStats &other) const
+    {
+        AllocStats diff;
+        diff.allocations = allocations - other.allocations;
+        diff.bytesAllocated = bytesAllocated - other.bytesAllocated;
+        diff.bytesCopied = bytesCopied - other.bytesCopied;
+        return diff;
+    }
+
+    void Print(const char *label, size_t perCount = 1) const
+    {
+        if (perCount == 0)
+            perCount = 1;
+
+        std::cout << label << ": ";
+#ifdef TRACK_ALLOCATIONS
+        std::cout << allocations << " allocations (" << allocations / perCount << " each), "
+                  << bytesAllocated / 1024 << " KB allocated, ";
+#endif
+        std::cout << bytesCopied / 1024 << " KB copied (" << bytesCopied / perCount << " bytes each)" << std::endl;
+    }
+};
+
+// -------------------------------------------------------------------------------------------------------------------------
+
+#ifdef TRACK_ALLOCATIONS
+void *operator new(size_t size)
+{
+    allocCounters.allocations.fetch_add(1, std::memory_order_relaxed);
+    allocCounters.bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+
+    if (void *ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+#endif
+
+#endif
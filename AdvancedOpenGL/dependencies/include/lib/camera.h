@@ -5,6 +5,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <lib/frustum.h>
+
 enum Camera_Movement
 {
     FORWARD,
@@ -79,6 +81,12 @@ public:
         return glm::lookAt(Position, Position + LookDir, Up);
     }
 
+    // world space planes of what this camera sees through projection
+    Frustum GetFrustum(const glm::mat4 &projection)
+    {
+        return Frustum::FromMatrix(projection * GetViewMatrix());
+    }
+
     void ProcessKeyboard(Camera_Movement direction, float deltaTime)
     {
         float velocity = MovementSpeed * deltaTime;
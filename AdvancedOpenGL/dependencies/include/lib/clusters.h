@@ -0,0 +1,411 @@
+#ifndef CLUSTERS_H
+#define CLUSTERS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <lib/constants.h>
+#include <lib/lights.h>
+#include <lib/stats.h>
+#include <lib/thread_pool.h>
+
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CLUSTERS_SSE
+#include <emmintrin.h>
+#endif
+
+const int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+// view space bounds of one cluster
+struct ClusterBounds
+{
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::vec3 center; // bounding sphere, for the spot cone test
+    float radius;
+};
+
+// lights in view space as structure of arrays, padded to a multiple of 4 so the kernels can always load 4 lanes
+// padding lanes sit far away with range 0 and never hit anything
+struct ViewLights
+{
+    std::vector<float> x, y, z, range;
+    std::vector<float> dirX, dirY, dirZ, cosOuter, sinOuter; // spots only
+    std::vector<unsigned short> index;                       // into pointLights[] / spotLights[]
+
+    int Count() const { return (int)index.size(); }
+
+    void Clear()
+    {
+        x.clear(), y.clear(), z.clear(), range.clear();
+        dirX.clear(), dirY.clear(), dirZ.clear(), cosOuter.clear(), sinOuter.clear();
+        index.clear();
+    }
+
+    void Push(glm::vec3 position, float _range, unsigned short _index)
+    {
+        Push(position, _range, glm::vec3(0.0f), 1.0f, _index);
+    }
+
+    void Push(glm::vec3 position, float _range, glm::vec3 direction, float _cosOuter, unsigned short _index)
+    {
+        x.push_back(position.x);
+        y.push_back(position.y);
+        z.push_back(position.z);
+        range.push_back(_range);
+        dirX.push_back(direction.x);
+        dirY.push_back(direction.y);
+        dirZ.push_back(direction.z);
+        cosOuter.push_back(_cosOuter);
+        sinOuter.push_back(std::sqrt(std::max(1.0f - _cosOuter * _cosOuter, 0.0f)));
+        index.push_back(_index);
+    }
+
+    // copies light i of another set (used to gather the candidates of a slice)
+    void PushFrom(const ViewLights &other, int i)
+    {
+        x.push_back(other.x[i]);
+        y.push_back(other.y[i]);
+        z.push_back(other.z[i]);
+        range.push_back(other.range[i]);
+        dirX.push_back(other.dirX[i]);
+        dirY.push_back(other.dirY[i]);
+        dirZ.push_back(other.dirZ[i]);
+        cosOuter.push_back(other.cosOuter[i]);
+        sinOuter.push_back(other.sinOuter[i]);
+        index.push_back(other.index[i]);
+    }
+
+    // index is not padded, Count() stays the real number of lights
+    void Pad()
+    {
+        while (x.size() % 4 != 0)
+        {
+            x.push_back(1e18f), y.push_back(1e18f), z.push_back(1e18f), range.push_back(0.0f);
+            dirX.push_back(0.0f), dirY.push_back(0.0f), dirZ.push_back(-1.0f), cosOuter.push_back(1.0f), sinOuter.push_back(0.0f);
+        }
+    }
+};
+
+// + intersection kernels, 4 lights against one cluster, bit i of the result is set if light first + i touches it
+// ------------------------------------------------------------------------
+inline int SphereAABBMask4(const ViewLights &lights, int first, const ClusterBounds &box)
+{
+#ifdef CLUSTERS_SSE
+    const __m128 zero = _mm_setzero_ps();
+
+    // squared distance from the sphere center to the box along one axis
+    auto axis = [&](const float *c, float lo, float hi)
+    {
+        __m128 v = _mm_loadu_ps(c);
+        __m128 below = _mm_max_ps(_mm_sub_ps(_mm_set1_ps(lo), v), zero);
+        __m128 above = _mm_max_ps(_mm_sub_ps(v, _mm_set1_ps(hi)), zero);
+        __m128 d = _mm_add_ps(below, above);
+        return _mm_mul_ps(d, d);
+    };
+
+    __m128 distSq = _mm_add_ps(_mm_add_ps(axis(&lights.x[first], box.min.x, box.max.x),
+                                          axis(&lights.y[first], box.min.y, box.max.y)),
+                               axis(&lights.z[first], box.min.z, box.max.z));
+    __m128 r = _mm_loadu_ps(&lights.range[first]);
+
+    return _mm_movemask_ps(_mm_cmple_ps(distSq, _mm_mul_ps(r, r)));
+#else
+    int mask = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        float dx = std::max(box.min.x - lights.x[first + i], 0.0f) + std::max(lights.x[first + i] - box.max.x, 0.0f);
+        float dy = std::max(box.min.y - lights.y[first + i], 0.0f) + std::max(lights.y[first + i] - box.max.y, 0.0f);
+        float dz = std::max(box.min.z - lights.z[first + i], 0.0f) + std::max(lights.z[first + i] - box.max.z, 0.0f);
+        float r = lights.range[first + i];
+        if (dx * dx + dy * dy + dz * dz <= r * r)
+            mask |= 1 << i;
+    }
+    return mask;
+#endif
+}
+
+// spot cone against the bounding sphere of the cluster (only run on lights whose sphere already hit)
+inline int ConeSphereMask4(const ViewLights &lights, int first, const ClusterBounds &box)
+{
+#ifdef CLUSTERS_SSE
+    __m128 vx = _mm_sub_ps(_mm_set1_ps(box.center.x), _mm_loadu_ps(&lights.x[first]));
+    __m128 vy = _mm_sub_ps(_mm_set1_ps(box.center.y), _mm_loadu_ps(&lights.y[first]));
+    __m128 vz = _mm_sub_ps(_mm_set1_ps(box.center.z), _mm_loadu_ps(&lights.z[first]));
+
+    __m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+    __m128 alongAxis = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, _mm_loadu_ps(&lights.dirX[first])),
+                                             _mm_mul_ps(vy, _mm_loadu_ps(&lights.dirY[first]))),
+                                  _mm_mul_ps(vz, _mm_loadu_ps(&lights.dirZ[first])));
+    __m128 fromAxis = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lenSq, _mm_mul_ps(alongAxis, alongAxis)), _mm_setzero_ps()));
+
+    // distance from the sphere center to the cone surface
+    __m128 closest = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(&lights.cosOuter[first]), fromAxis),
+                                _mm_mul_ps(alongAxis, _mm_loadu_ps(&lights.sinOuter[first])));
+
+    __m128 radius = _mm_set1_ps(box.radius);
+    __m128 outside = _mm_or_ps(_mm_cmpgt_ps(closest, radius),
+                               _mm_or_ps(_mm_cmpgt_ps(alongAxis, _mm_add_ps(radius, _mm_loadu_ps(&lights.range[first]))),
+                                         _mm_cmplt_ps(alongAxis, _mm_sub_ps(_mm_setzero_ps(), radius))));
+
+    return ~_mm_movemask_ps(outside) & 0xF;
+#else
+    int mask = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        glm::vec3 v = box.center - glm::vec3(lights.x[first + i], lights.y[first + i], lights.z[first + i]);
+        float alongAxis = glm::dot(v, glm::vec3(lights.dirX[first + i], lights.dirY[first + i], lights.dirZ[first + i]));
+        float fromAxis = std::sqrt(std::max(glm::dot(v, v) - alongAxis * alongAxis, 0.0f));
+        float closest = lights.cosOuter[first + i] * fromAxis - alongAxis * lights.sinOuter[first + i];
+
+        bool outside = closest > box.radius || alongAxis > box.radius + lights.range[first + i] || alongAxis < -box.radius;
+        if (!outside)
+            mask |= 1 << i;
+    }
+    return mask;
+#endif
+}
+
+// clustered forward lighting: the view frustum is split into CLUSTER_X * CLUSTER_Y tiles * CLUSTER_Z exponential depth slices,
+// lights get assigned to clusters on the CPU (one slice per job on the worker pool) and the lists go to two texture buffers
+// litObject.fs (CLUSTERED) finds its cluster from gl_FragCoord and only shades the lights listed there
+// ------------------------------------------------------------------------
+class ClusteredLights
+{
+public:
+    ClusteredLights()
+    {
+        glGenBuffers(1, &gridBuffer);
+        glGenBuffers(1, &indexBuffer);
+        glGenTextures(1, &gridTexture);
+        glGenTextures(1, &indexTexture);
+
+        // grid: x = first index, y = point count | spot count << 16
+        glBindBuffer(GL_TEXTURE_BUFFER, gridBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, CLUSTER_COUNT * sizeof(glm::uvec2), NULL, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, gridTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, gridBuffer);
+
+        // indices: every cluster's point lights followed by its spot lights
+        glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(unsigned short), NULL, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R16UI, indexBuffer);
+
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        grid.resize(CLUSTER_COUNT);
+        slices.resize(CLUSTER_Z);
+    }
+
+    // assigns every light to the clusters it touches and uploads the lists
+    void Update(const LightManager &lights, const glm::mat4 &view, const glm::mat4 &projection, float near, float far)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        if (projection != boundsProjection || near != boundsNear || far != boundsFar)
+            buildBounds(projection, near, far);
+
+        // + lights to view space
+        pointLights.Clear();
+        for (int i = 0; i < lights.PointCount(); i++)
+        {
+            glm::vec3 position = glm::vec3(view * glm::vec4(lights.points.position[i], 1.0f));
+            pointLights.Push(position, lights.points.range[i], (unsigned short)i);
+        }
+
+        spotLights.Clear();
+        for (int i = 0; i < lights.SpotCount(); i++)
+        {
+            glm::vec3 position = glm::vec3(view * glm::vec4(lights.spots.position[i], 1.0f));
+            glm::vec3 direction = glm::normalize(glm::mat3(view) * lights.spots.direction[i]);
+            spotLights.Push(position, lights.spots.range[i], direction, lights.spots.outerCutoff[i], (unsigned short)i);
+        }
+
+        // + one job per depth slice, each writes its own part of the grid and its own index list
+        WorkerPool().ParallelFor(CLUSTER_Z, [this](int z)
+                                 { assignSlice(z); });
+
+        // + stitch the slices together
+        indices.clear();
+        for (int z = 0; z < CLUSTER_Z; z++)
+        {
+            unsigned int base = (unsigned int)indices.size();
+            for (int cluster = z * CLUSTER_X * CLUSTER_Y; cluster < (z + 1) * CLUSTER_X * CLUSTER_Y; cluster++)
+                grid[cluster].x += base;
+
+            indices.insert(indices.end(), slices[z].indices.begin(), slices[z].indices.end());
+        }
+
+        frameStats.clusterLightRefs += (unsigned int)indices.size();
+
+        upload();
+
+        frameStats.clusterMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // every frame, the units stay reserved for the cluster buffers (Shader points the samplers at them when it links)
+    void Bind()
+    {
+        glActiveTexture(GL_TEXTURE0 + CLUSTER_GRID_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, gridTexture);
+        glActiveTexture(GL_TEXTURE0 + CLUSTER_INDEX_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void del()
+    {
+        glDeleteTextures(1, &gridTexture);
+        glDeleteTextures(1, &indexTexture);
+        glDeleteBuffers(1, &gridBuffer);
+        glDeleteBuffers(1, &indexBuffer);
+    }
+
+private:
+    unsigned int gridBuffer, indexBuffer;
+    unsigned int gridTexture, indexTexture;
+
+    // per slice scratch, only touched by the job running that slice
+    struct Slice
+    {
+        ViewLights points;
+        ViewLights spots;
+        std::vector<unsigned short> indices;
+    };
+
+    std::vector<ClusterBounds> bounds;
+    glm::mat4 boundsProjection = glm::mat4(0.0f);
+    float boundsNear = 0.0f, boundsFar = 0.0f;
+    std::vector<float> sliceDepths; // CLUSTER_Z + 1 view distances
+
+    ViewLights pointLights, spotLights;
+    std::vector<Slice> slices;
+    std::vector<glm::uvec2> grid;
+    std::vector<unsigned short> indices;
+
+    // view space AABB of every cluster, only when the projection changes
+    // ------------------------------------------------------------------------
+    void buildBounds(const glm::mat4 &projection, float near, float far)
+    {
+        boundsProjection = projection;
+        boundsNear = near;
+        boundsFar = far;
+
+        // same exponential split as ClusterIndex() in litObject.fs
+        sliceDepths.resize(CLUSTER_Z + 1);
+        for (int z = 0; z <= CLUSTER_Z; z++)
+            sliceDepths[z] = near * std::pow(far / near, (float)z / CLUSTER_Z);
+
+        bounds.resize(CLUSTER_COUNT);
+        for (int z = 0; z < CLUSTER_Z; z++)
+            for (int y = 0; y < CLUSTER_Y; y++)
+                for (int x = 0; x < CLUSTER_X; x++)
+                {
+                    ClusterBounds &box = bounds[x + y * CLUSTER_X + z * CLUSTER_X * CLUSTER_Y];
+                    box.min = glm::vec3(1e30f);
+                    box.max = glm::vec3(-1e30f);
+
+                    // tile corners in NDC at both slice depths, back to view space (symmetric perspective projection)
+                    for (int corner = 0; corner < 8; corner++)
+                    {
+                        float ndcX = -1.0f + 2.0f * (x + (corner & 1)) / CLUSTER_X;
+                        float ndcY = -1.0f + 2.0f * (y + ((corner >> 1) & 1)) / CLUSTER_Y;
+                        float depth = sliceDepths[z + (corner >> 2)];
+
+                        glm::vec3 point(ndcX * depth / projection[0][0], ndcY * depth / projection[1][1], -depth);
+                        box.min = glm::min(box.min, point);
+                        box.max = glm::max(box.max, point);
+                    }
+
+                    box.center = (box.min + box.max) * 0.5f;
+                    box.radius = glm::length(box.max - box.min) * 0.5f;
+                }
+    }
+
+    // runs on a worker
+    // ------------------------------------------------------------------------
+    void assignSlice(int z)
+    {
+        Slice &slice = slices[z];
+        float sliceNear = sliceDepths[z];
+        float sliceFar = sliceDepths[z + 1];
+
+        // only lights overlapping the slice depth range go through the kernels
+        slice.points.Clear();
+        for (int i = 0; i < pointLights.Count(); i++)
+        {
+            float depth = -pointLights.z[i];
+            if (depth + pointLights.range[i] >= sliceNear && depth - pointLights.range[i] <= sliceFar)
+                slice.points.PushFrom(pointLights, i);
+        }
+        slice.points.Pad();
+
+        slice.spots.Clear();
+        for (int i = 0; i < spotLights.Count(); i++)
+        {
+            float depth = -spotLights.z[i];
+            if (depth + spotLights.range[i] >= sliceNear && depth - spotLights.range[i] <= sliceFar)
+                slice.spots.PushFrom(spotLights, i);
+        }
+        slice.spots.Pad();
+
+        slice.indices.clear();
+        for (int cluster = z * CLUSTER_X * CLUSTER_Y; cluster < (z + 1) * CLUSTER_X * CLUSTER_Y; cluster++)
+        {
+            const ClusterBounds &box = bounds[cluster];
+            unsigned int first = (unsigned int)slice.indices.size();
+
+            for (int i = 0; i < slice.points.Count(); i += 4)
+            {
+                int mask = SphereAABBMask4(slice.points, i, box);
+                for (; mask; mask &= mask - 1)
+                    slice.indices.push_back(slice.points.index[i + lowestBit(mask)]);
+            }
+            unsigned int pointCount = (unsigned int)slice.indices.size() - first;
+
+            for (int i = 0; i < slice.spots.Count(); i += 4)
+            {
+                int mask = SphereAABBMask4(slice.spots, i, box);
+                if (mask)
+                    mask &= ConeSphereMask4(slice.spots, i, box);
+                for (; mask; mask &= mask - 1)
+                    slice.indices.push_back(slice.spots.index[i + lowestBit(mask)]);
+            }
+            unsigned int spotCount = (unsigned int)slice.indices.size() - first - pointCount;
+
+            grid[cluster] = glm::uvec2(first, pointCount | spotCount << 16);
+        }
+    }
+
+    static int lowestBit(int mask)
+    {
+        int bit = 0;
+        while (!(mask & (1 << bit)))
+            bit++;
+        return bit;
+    }
+
+    // orphans both buffers, the driver doesn't have to wait for last frame's draws
+    void upload()
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, gridBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, grid.size() * sizeof(glm::uvec2), grid.data(), GL_STREAM_DRAW);
+
+        // a texture buffer can't be empty
+        if (indices.empty())
+            indices.push_back(0);
+
+        glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, indices.size() * sizeof(unsigned short), indices.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+};
+
+#endif
@@ -7,7 +7,61 @@
 #define POINT_LIGHT_NR 4
 #define DIR_LIGHT_NR 1
 #define SPOT_LIGHT_NR 1
+#define SCATTER_LIGHT_NR 192 // small colored lights, clustered lighting demo
 
 #define MAX_MATERIALS 4
 
+// capacity of the LightData block, the light counts themselves are runtime values
+#define MAX_POINT_LIGHTS 256
+#define MAX_DIR_LIGHTS 4
+#define MAX_SPOT_LIGHTS 32
+
+// lights stop contributing at their range (smooth window), clustering relies on it
+#define DEFAULT_LIGHT_RANGE 50.0
+
+// clustered forward: screen tiles x depth slices (exponential between NEAR_CLIP and FAR_CLIP)
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+
+// texture units the cluster buffers live on, material textures start at 0
+#define CLUSTER_GRID_UNIT 14
+#define CLUSTER_INDEX_UNIT 15
+#define HIZ_UNIT 13 // Hi-Z pyramid for the GPU culling pass (gpu_culling.h)
+
+// uniform buffer binding points, shared by every program
+#define FRAME_DATA_BINDING 0
+#define LIGHT_DATA_BINDING 1
+
+// starting size of the shared mesh buffers (geometry_heap.h), they double when full
+#define GEOMETRY_HEAP_VERTICES (1 << 18)
+#define GEOMETRY_HEAP_INDICES (1 << 21) // 2 byte slots: a 16 bit index takes one, a 32 bit index two
+
+// mesh LODs (mesh_simplify.h): chain length including LOD 0; a draw takes the coarsest LOD whose error projects to at most
+// MESH_LOD_PIXEL_ERROR pixels, one coarser than the current has to get under MESH_LOD_HYSTERESIS x that (no popping back and forth)
+#define MESH_MAX_LODS 4
+#define MESH_LOD_PIXEL_ERROR 1.0f
+#define MESH_LOD_HYSTERESIS 0.75f
+
+// software occlusion culling (occlusion.h): CPU depth buffer size, in tiles that are rasterized one row per job
+// model occluders use their coarsest LOD within OCCLUSION_LOD_ERROR x the mesh's diagonal (coarser ones bulge out of the surface)
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 144
+#define OCCLUSION_TILE_WIDTH 16
+#define OCCLUSION_TILE_HEIGHT 8
+#define OCCLUSION_LOD_ERROR 0.005f
+
+// GPU culled instance field (gpu_culling.h), small cubes around the scene
+#define GPU_CULL_INSTANCES 20000
+#define BACKPACK_COPIES 64 // instancing demo (B), a grid of backpacks behind the scene
+#define GPU_CULL_RING 3 // output buffers + count queries in flight, the GPU may run this many culls behind before Draw() stops waiting
+
+// texture streaming (texture_streamer.h): bytes uploaded per frame at most, pixel unpack buffer ring
+#define TEXTURE_UPLOAD_BUDGET (4 << 20)
+#define TEXTURE_STREAM_SLOTS 3
+#define TEXTURE_STREAM_SLOT_BYTES (2 << 20)
+
+// unreferenced textures the texture cache keeps around before evicting (texture_cache.h)
+#define TEXTURE_CACHE_BUDGET (64 << 20)
+
 #endif
\ No newline at end of file
@@ -0,0 +1,130 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <lib/frustum.h>
+#include <lib/stats.h>
+
+#include <vector>
+
+// 8 boxes per step with AVX (-mavx / -mavx2), 4 with SSE2, one at a time otherwise
+#if defined(__AVX__)
+#define CULLING_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+// axis aligned boxes as structure of arrays, padded to a multiple of 8 so the kernels always load full lanes
+// padding boxes are never reported, Count() stays the real number
+struct BoundingBoxes
+{
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+    unsigned int Count() const { return count; }
+
+    void Clear()
+    {
+        minX.clear(), minY.clear(), minZ.clear(), maxX.clear(), maxY.clear(), maxZ.clear();
+        count = 0;
+    }
+
+    void Push(glm::vec3 boundsMin, glm::vec3 boundsMax)
+    {
+        minX.push_back(boundsMin.x), minY.push_back(boundsMin.y), minZ.push_back(boundsMin.z);
+        maxX.push_back(boundsMax.x), maxY.push_back(boundsMax.y), maxZ.push_back(boundsMax.z);
+        count++;
+    }
+
+    void Pad()
+    {
+        while (minX.size() % 8 != 0)
+            minX.push_back(0.0f), minY.push_back(0.0f), minZ.push_back(0.0f), maxX.push_back(0.0f), maxY.push_back(0.0f), maxZ.push_back(0.0f);
+    }
+
+private:
+    unsigned int count = 0;
+};
+
+// + frustum kernels, bit i of the result is set if box first + i is at least partly inside
+// per plane only the box corner furthest along the normal matters: max(n.x * min.x, n.x * max.x) + ... + w >= 0
+// ------------------------------------------------------------------------
+#ifdef CULLING_AVX
+inline int BoxFrustumMask8(const BoundingBoxes &boxes, unsigned int first, const Frustum &frustum)
+{
+    __m256 minX = _mm256_loadu_ps(&boxes.minX[first]), maxX = _mm256_loadu_ps(&boxes.maxX[first]);
+    __m256 minY = _mm256_loadu_ps(&boxes.minY[first]), maxY = _mm256_loadu_ps(&boxes.maxY[first]);
+    __m256 minZ = _mm256_loadu_ps(&boxes.minZ[first]), maxZ = _mm256_loadu_ps(&boxes.maxZ[first]);
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+    for (const glm::vec4 &plane : frustum.planes)
+    {
+        __m256 nx = _mm256_set1_ps(plane.x), ny = _mm256_set1_ps(plane.y), nz = _mm256_set1_ps(plane.z);
+        __m256 d = _mm256_add_ps(_mm256_max_ps(_mm256_mul_ps(nx, minX), _mm256_mul_ps(nx, maxX)),
+                                 _mm256_max_ps(_mm256_mul_ps(ny, minY), _mm256_mul_ps(ny, maxY)));
+        d = _mm256_add_ps(d, _mm256_add_ps(_mm256_max_ps(_mm256_mul_ps(nz, minZ), _mm256_mul_ps(nz, maxZ)), _mm256_set1_ps(plane.w)));
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ));
+    }
+
+    return _mm256_movemask_ps(inside);
+}
+#endif
+
+#ifdef CULLING_SSE
+inline int BoxFrustumMask4(const BoundingBoxes &boxes, unsigned int first, const Frustum &frustum)
+{
+    __m128 minX = _mm_loadu_ps(&boxes.minX[first]), maxX = _mm_loadu_ps(&boxes.maxX[first]);
+    __m128 minY = _mm_loadu_ps(&boxes.minY[first]), maxY = _mm_loadu_ps(&boxes.maxY[first]);
+    __m128 minZ = _mm_loadu_ps(&boxes.minZ[first]), maxZ = _mm_loadu_ps(&boxes.maxZ[first]);
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+    for (const glm::vec4 &plane : frustum.planes)
+    {
+        __m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z);
+        __m128 d = _mm_add_ps(_mm_max_ps(_mm_mul_ps(nx, minX), _mm_mul_ps(nx, maxX)),
+                              _mm_max_ps(_mm_mul_ps(ny, minY), _mm_mul_ps(ny, maxY)));
+        d = _mm_add_ps(d, _mm_add_ps(_mm_max_ps(_mm_mul_ps(nz, minZ), _mm_mul_ps(nz, maxZ)), _mm_set1_ps(plane.w)));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+    }
+
+    return _mm_movemask_ps(inside);
+}
+#endif
+
+// visible[i] = box i is at least partly inside frustum (both in the same space), counted into frameStats; returns how many are
+inline unsigned int CullBoxes(const Frustum &frustum, const BoundingBoxes &boxes, std::vector<unsigned char> &visible)
+{
+    unsigned int count = boxes.Count();
+    visible.resize(count);
+
+    unsigned int i = 0;
+#if defined(CULLING_AVX)
+    for (; i < count; i += 8)
+    {
+        int mask = BoxFrustumMask8(boxes, i, frustum);
+        for (unsigned int lane = 0; lane < 8 && i + lane < count; lane++)
+            visible[i + lane] = (mask >> lane) & 1;
+    }
+#elif defined(CULLING_SSE)
+    for (; i < count; i += 4)
+    {
+        int mask = BoxFrustumMask4(boxes, i, frustum);
+        for (unsigned int lane = 0; lane < 4 && i + lane < count; lane++)
+            visible[i + lane] = (mask >> lane) & 1;
+    }
+#endif
+    for (; i < count; i++)
+        visible[i] = frustum.IntersectsBox(glm::vec3(boxes.minX[i], boxes.minY[i], boxes.minZ[i]), glm::vec3(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i]));
+
+    unsigned int drawn = 0;
+    for (unsigned char inside : visible)
+        drawn += inside;
+
+    frameStats.objectsDrawn += drawn;
+    frameStats.objectsCulled += count - drawn;
+    return drawn;
+}
+
+#endif
@@ -0,0 +1,391 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <lib/constants.h>
+#include <lib/lights.h>
+#include <lib/shader_s.h>
+#include <lib/shader_builder.h>
+#include <lib/stats.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// deferred shading: a geometry pass fills the G-buffer (gbuffer.fs variants through ShaderPermutations),
+// then every light is drawn as a volume and shades only the pixels it covers
+//
+// G-buffer
+//  0      RGBA8             albedo, specular intensity
+//  1      RG16F             octahedral world normal (UNLIT_MARKER for outlines)
+//  depth  DEPTH24_STENCIL8  world position gets rebuilt from it
+// ------------------------------------------------------------------------
+class DeferredRenderer
+{
+public:
+    DeferredRenderer(int width, int height)
+        : fullscreenShader(buildLighting("FULLSCREEN", 1.0)),
+          pointShader(buildLighting("POINT_VOLUME", sphereScale())),
+          spotShader(buildLighting("SPOT_VOLUME", coneScale())),
+          pointMarkShader(buildLighting("POINT_VOLUME", sphereScale(), true)),
+          spotMarkShader(buildLighting("SPOT_VOLUME", coneScale(), true))
+    {
+        glGenFramebuffers(1, &gBuffer);
+        glGenTextures(1, &albedoSpecTexture);
+        glGenTextures(1, &normalTexture);
+        glGenTextures(1, &depthTexture);
+        allocate(width, height);
+
+        static const UniformHandle albedoSpecHandle = Shader::Uniform("gAlbedoSpec");
+        static const UniformHandle normalHandle = Shader::Uniform("gNormal");
+        static const UniformHandle depthHandle = Shader::Uniform("gDepth");
+
+        for (Shader *shader : {&fullscreenShader, &pointShader, &spotShader})
+        {
+            shader->use();
+            shader->set(albedoSpecHandle, 0);
+            shader->set(normalHandle, 1);
+            shader->set(depthHandle, 2);
+        }
+
+        // + volumes
+        sphere = makeSphere();
+        cone = makeCone();
+        glGenVertexArrays(1, &emptyVAO); // the fullscreen triangle comes from gl_VertexID
+    }
+
+    // call every frame with the framebuffer size, only reallocates when it changed
+    void Resize(int width, int height)
+    {
+        if (width != this->width || height != this->height)
+            allocate(width, height);
+    }
+
+    // everything drawn until LightingPass() goes into the G-buffer
+    void BeginGeometryPass()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    }
+
+    // shades the G-buffer into target (the default framebuffer unless given), its color has to be cleared already
+    // depth comes along, so forward passes afterwards (light gizmos ...) still depth test against the scene
+    void LightingPass(const LightManager &lights, const glm::mat4 &view, const glm::mat4 &projection, unsigned int target = 0)
+    {
+        static const UniformHandle invViewProjectionHandle = Shader::Uniform("invViewProjection");
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, target);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, albedoSpecTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, normalTexture);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        glActiveTexture(GL_TEXTURE0);
+
+        glm::mat4 invViewProjection = glm::inverse(projection * view);
+        glDepthMask(GL_FALSE);
+
+        // + ambient + directional lights, replaces the clear color wherever there is geometry
+        glDisable(GL_DEPTH_TEST);
+
+        fullscreenShader.use();
+        fullscreenShader.set(invViewProjectionHandle, invViewProjection);
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        // + light volumes, added on top, one light at a time
+        // each volume first marks its pixels in the stencil (color off): back faces behind the surface +1, front faces behind it -1,
+        // so only pixels whose surface lies between the two sides end up != 0 and get shaded, which also zeroes them for the next light
+        // a volume the camera is inside has no front faces to count, it keeps the back faces with GEQUAL instead
+        // depth clamp keeps far sides behind the far plane instead of clipping them away
+        glm::vec3 cameraPos = glm::vec3(glm::inverse(view)[3]);
+
+        glEnable(GL_DEPTH_CLAMP);
+        glEnable(GL_STENCIL_TEST);
+        glStencilMask(0xFF);
+        glClearStencil(0);
+        glClear(GL_STENCIL_BUFFER_BIT); // the blit brought the opaque pass's outline marks along
+        glBlendFunc(GL_ONE, GL_ONE);
+
+        for (int i = 0; i < lights.PointCount(); i++)
+        {
+            float radius = lights.points.range[i] * (float)sphereScale();
+            bool inside = glm::length(cameraPos - lights.points.position[i]) < radius + CAMERA_VOLUME_MARGIN;
+            drawVolume(pointMarkShader, pointShader, sphere, i, inside, invViewProjection);
+        }
+
+        for (int i = 0; i < lights.SpotCount(); i++)
+        {
+            glm::vec3 toCamera = cameraPos - lights.spots.position[i];
+            glm::vec3 forward = glm::normalize(lights.spots.direction[i]);
+            float along = glm::dot(toCamera, forward);
+            float cosOuter = lights.spots.outerCutoff[i];
+            float radius = std::max(along, 0.0f) * std::sqrt(1.0f - cosOuter * cosOuter) / cosOuter * (float)coneScale();
+            bool inside = along > -CAMERA_VOLUME_MARGIN && along < lights.spots.range[i] + CAMERA_VOLUME_MARGIN &&
+                          glm::length(toCamera - forward * along) < radius + CAMERA_VOLUME_MARGIN;
+            drawVolume(spotMarkShader, spotShader, cone, i, inside, invViewProjection);
+        }
+
+        frameStats.lightVolumes += lights.PointCount() + lights.SpotCount();
+
+        // defaults
+        glDisable(GL_STENCIL_TEST);
+        glStencilFunc(GL_ALWAYS, 0, 0xFF);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+        glDisable(GL_BLEND);
+        glEnable(GL_CULL_FACE);
+        glEnable(GL_DEPTH_TEST);
+        glDisable(GL_DEPTH_CLAMP);
+        glCullFace(GL_BACK);
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+        glBindVertexArray(0);
+    }
+
+    void del()
+    {
+        fullscreenShader.del();
+        pointShader.del();
+        spotShader.del();
+        pointMarkShader.del();
+        spotMarkShader.del();
+
+        for (VolumeMesh *mesh : {&sphere, &cone})
+        {
+            glDeleteVertexArrays(1, &mesh->VAO);
+            glDeleteBuffers(1, &mesh->VBO);
+            glDeleteBuffers(1, &mesh->EBO);
+        }
+        glDeleteVertexArrays(1, &emptyVAO);
+
+        glDeleteTextures(1, &albedoSpecTexture);
+        glDeleteTextures(1, &normalTexture);
+        glDeleteTextures(1, &depthTexture);
+        glDeleteFramebuffers(1, &gBuffer);
+    }
+
+private:
+    struct VolumeMesh
+    {
+        unsigned int VAO, VBO, EBO;
+        int indexCount;
+    };
+
+    // tessellation of the volumes, low poly is enough, VOLUME_SCALE makes them cover the real shape
+    static const int SPHERE_RINGS = 8;
+    static const int SPHERE_SEGMENTS = 12;
+    static const int CONE_SEGMENTS = 12;
+
+    // the near plane's corners stick out of the camera position by a bit, closer than this to a volume counts as inside
+    static constexpr float CAMERA_VOLUME_MARGIN = (float)NEAR_CLIP * 2.0f;
+
+    unsigned int gBuffer;
+    unsigned int albedoSpecTexture, normalTexture, depthTexture;
+    int width = 0, height = 0;
+
+    Shader fullscreenShader, pointShader, spotShader;
+    Shader pointMarkShader, spotMarkShader; // same volumes, no shading, for the stencil marks
+    VolumeMesh sphere, cone;
+    unsigned int emptyVAO;
+
+    // one volume, the volumes go out one light at a time (lightOffset) since each needs its own stencil marks
+    void drawVolume(Shader &markShader, Shader &shader, const VolumeMesh &mesh, int light, bool cameraInside, const glm::mat4 &invViewProjection)
+    {
+        static const UniformHandle lightOffsetHandle = Shader::Uniform("lightOffset");
+        static const UniformHandle invViewProjectionHandle = Shader::Uniform("invViewProjection");
+
+        glBindVertexArray(mesh.VAO);
+
+        if (!cameraInside)
+        {
+            // + stencil marks, both faces, nothing but the depth fails counts
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            glDisable(GL_BLEND);
+            glEnable(GL_DEPTH_TEST);
+            glDepthFunc(GL_LESS);
+            glDisable(GL_CULL_FACE);
+            glStencilFunc(GL_ALWAYS, 0, 0xFF);
+            glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+            glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+
+            markShader.use();
+            markShader.set(lightOffsetHandle, light);
+            glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_SHORT, 0);
+
+            // + shading where marked, back faces cover the whole volume on screen so every mark gets zeroed again
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glDisable(GL_DEPTH_TEST);
+            glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+        }
+        else
+        {
+            // back faces with GEQUAL: only pixels whose surface is in front of the volume's far side
+            glEnable(GL_DEPTH_TEST);
+            glDepthFunc(GL_GEQUAL);
+            glStencilFunc(GL_ALWAYS, 0, 0xFF);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+        }
+
+        glEnable(GL_BLEND);
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_FRONT);
+
+        shader.use();
+        shader.set(lightOffsetHandle, light);
+        shader.set(invViewProjectionHandle, invViewProjection);
+        glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_SHORT, 0);
+    }
+
+    // one lighting program per volume type, both stages see LightData
+    // stencilMark: the fragment shader does nothing, color writes are off while marking anyway
+    static Shader buildLighting(const char *volume, double volumeScale, bool stencilMark = false)
+    {
+        ShaderBuilder builder("dependencies/shaders/deferred_light.vs", "dependencies/shaders/deferred_light.fs");
+        for (int stage = 0; stage < 2; stage++)
+        {
+            builder.define(stage, volume);
+            builder.define(stage, "MAX_POINT_LIGHTS", MAX_POINT_LIGHTS);
+            builder.define(stage, "MAX_DIR_LIGHTS", MAX_DIR_LIGHTS);
+            builder.define(stage, "MAX_SPOT_LIGHTS", MAX_SPOT_LIGHTS);
+            builder.include(stage, "dependencies/shaders/frame_data.glsl");
+            builder.include(stage, "dependencies/shaders/lighting.glsl");
+        }
+        builder.define(0, "VOLUME_SCALE", volumeScale);
+        if (stencilMark)
+            builder.define(1, "STENCIL_MARK");
+        return builder.build();
+    }
+
+    void allocate(int _width, int _height)
+    {
+        width = _width;
+        height = _height;
+
+        auto texture = [&](unsigned int id, GLint internalFormat, GLenum format, GLenum type)
+        {
+            glBindTexture(GL_TEXTURE_2D, id);
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        };
+
+        texture(albedoSpecTexture, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        texture(normalTexture, GL_RG16F, GL_RG, GL_FLOAT);
+        texture(depthTexture, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpecTexture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+
+        const GLenum attachments[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, attachments);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::DEFERRED::GBUFFER_INCOMPLETE" << std::endl;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // a polygon with n sides is inscribed in its circle, scale by 1 / cos(pi / n) to circumscribe it
+    static double sphereScale()
+    {
+        return 1.0 / (std::cos(glm::pi<double>() / SPHERE_SEGMENTS) * std::cos(glm::pi<double>() / (2 * SPHERE_RINGS)));
+    }
+
+    static double coneScale()
+    {
+        return 1.0 / std::cos(glm::pi<double>() / CONE_SEGMENTS);
+    }
+
+    static VolumeMesh upload(const std::vector<glm::vec3> &vertices, const std::vector<unsigned short> &indices)
+    {
+        VolumeMesh mesh;
+        mesh.indexCount = (int)indices.size();
+
+        glGenVertexArrays(1, &mesh.VAO);
+        glGenBuffers(1, &mesh.VBO);
+        glGenBuffers(1, &mesh.EBO);
+
+        glBindVertexArray(mesh.VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), indices.data(), GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+
+        glBindVertexArray(0);
+        return mesh;
+    }
+
+    // unit UV sphere, counter clockwise from outside
+    static VolumeMesh makeSphere()
+    {
+        std::vector<glm::vec3> vertices;
+        std::vector<unsigned short> indices;
+
+        for (int ring = 0; ring <= SPHERE_RINGS; ring++)
+        {
+            float phi = glm::pi<float>() * ring / SPHERE_RINGS;
+            for (int segment = 0; segment <= SPHERE_SEGMENTS; segment++)
+            {
+                float theta = glm::two_pi<float>() * segment / SPHERE_SEGMENTS;
+                vertices.push_back(glm::vec3(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta)));
+            }
+        }
+
+        for (int ring = 0; ring < SPHERE_RINGS; ring++)
+            for (int segment = 0; segment < SPHERE_SEGMENTS; segment++)
+            {
+                unsigned short a = ring * (SPHERE_SEGMENTS + 1) + segment;
+                unsigned short b = a + SPHERE_SEGMENTS + 1;
+
+                indices.insert(indices.end(), {a, (unsigned short)(a + 1), b});
+                indices.insert(indices.end(), {(unsigned short)(a + 1), (unsigned short)(b + 1), b});
+            }
+
+        return upload(vertices, indices);
+    }
+
+    // unit cone, apex at the origin, base circle of radius 1 at z = -1, closed, counter clockwise from outside
+    static VolumeMesh makeCone()
+    {
+        std::vector<glm::vec3> vertices = {glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f)};
+        std::vector<unsigned short> indices;
+
+        for (int segment = 0; segment < CONE_SEGMENTS; segment++)
+        {
+            float theta = glm::two_pi<float>() * segment / CONE_SEGMENTS;
+            vertices.push_back(glm::vec3(std::cos(theta), std::sin(theta), -1.0f));
+        }
+
+        for (int segment = 0; segment < CONE_SEGMENTS; segment++)
+        {
+            unsigned short current = 2 + segment;
+            unsigned short next = 2 + (segment + 1) % CONE_SEGMENTS;
+
+            indices.insert(indices.end(), {0, current, next}); // side
+            indices.insert(indices.end(), {1, next, current}); // base
+        }
+
+        return upload(vertices, indices);
+    }
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef FRAME_DATA_H
+#define FRAME_DATA_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <lib/constants.h>
+
+// std140 layout of the FrameData uniform block, keep in sync with the shaders
+// (only mat4 / vec4 members, so the C++ layout matches without padding)
+struct FrameData
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 cameraPos;  // xyz = camera position, w = time in seconds
+    glm::vec4 clipPlanes; // x = near, y = far
+    glm::vec4 viewport;   // xy = framebuffer size
+};
+
+// one uniform buffer at FRAME_DATA_BINDING, written once per frame and read by every program
+class FrameUniforms
+{
+public:
+    FrameUniforms()
+    {
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, UBO);
+    }
+
+    void Update(const FrameData &data)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void del()
+    {
+        glDeleteBuffers(1, &UBO);
+    }
+
+private:
+    unsigned int UBO;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// the six clip planes of a (view) projection matrix (Gribb & Hartmann), xyz = inward unit normal, w = distance
+// planes of projection * view * model are in that model's space, so model space bounds test without transforming them
+struct Frustum
+{
+    glm::vec4 planes[6]; // left, right, bottom, top, near, far
+
+    static Frustum FromMatrix(const glm::mat4 &m)
+    {
+        // glm is column major, m[column][row]
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        Frustum frustum;
+        frustum.planes[0] = row3 + row0;
+        frustum.planes[1] = row3 - row0;
+        frustum.planes[2] = row3 + row1;
+        frustum.planes[3] = row3 - row1;
+        frustum.planes[4] = row3 + row2;
+        frustum.planes[5] = row3 - row2;
+
+        for (glm::vec4 &plane : frustum.planes)
+            plane /= glm::length(glm::vec3(plane));
+
+        return frustum;
+    }
+
+    // false only if the sphere is entirely outside one plane (conservative near the frustum's corners)
+    bool IntersectsSphere(glm::vec3 center, float radius) const
+    {
+        for (const glm::vec4 &plane : planes)
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+
+        return true;
+    }
+
+    // false only if the box is entirely outside one plane, culling.h tests many of them at once
+    bool IntersectsBox(glm::vec3 boundsMin, glm::vec3 boundsMax) const
+    {
+        for (const glm::vec4 &plane : planes)
+        {
+            // the corner furthest along the plane's normal
+            glm::vec3 corner(plane.x > 0.0f ? boundsMax.x : boundsMin.x, plane.y > 0.0f ? boundsMax.y : boundsMin.y, plane.z > 0.0f ? boundsMax.z : boundsMin.z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+                return false;
+        }
+
+        return true;
+    }
+};
+
+#endif
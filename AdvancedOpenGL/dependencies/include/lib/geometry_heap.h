@@ -0,0 +1,536 @@
+#ifndef GEOMETRY_HEAP_H
+#define GEOMETRY_HEAP_H
+
+#include <glad/glad.h>
+
+#include <lib/constants.h>
+#include <lib/stats.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <vector>
+
+// one vertex attribute, as glVertexAttribPointer takes it
+struct VertexAttribute
+{
+    unsigned int location;
+    int size;
+    GLenum type;
+    bool normalized;
+    unsigned int offset;
+};
+
+struct VertexFormat
+{
+    unsigned int stride;
+    std::vector<VertexAttribute> attributes;
+};
+
+// -------------------------------------------------------------------------------------------------------------------------
+
+// first fit free list over [0, capacity), in elements (vertices / indices), neighbouring free blocks get merged
+class FreeList
+{
+public:
+    explicit FreeList(unsigned int capacity = 0)
+    {
+        Reset(capacity, 0);
+    }
+
+    // everything below used is taken, the rest is one free block
+    void Reset(unsigned int capacity, unsigned int used)
+    {
+        this->capacity = capacity;
+        blocks.clear();
+        if (used < capacity)
+            blocks[used] = capacity - used;
+    }
+
+    // offset of a block of size elements, or -1 if no block is big enough
+    long long Allocate(unsigned int size)
+    {
+        if (size == 0)
+            return 0;
+
+        for (auto it = blocks.begin(); it != blocks.end(); ++it)
+        {
+            if (it->second < size)
+                continue;
+
+            unsigned int offset = it->first;
+            unsigned int left = it->second - size;
+            blocks.erase(it);
+            if (left > 0)
+                blocks[offset + size] = left;
+
+            return offset;
+        }
+        return -1;
+    }
+
+    void Free(unsigned int offset, unsigned int size)
+    {
+        if (size == 0)
+            return;
+
+        auto next = blocks.lower_bound(offset);
+
+        // merge with the block right after
+        if (next != blocks.end() && offset + size == next->first)
+        {
+            size += next->second;
+            next = blocks.erase(next);
+        }
+
+        // merge with the block right before
+        if (next != blocks.begin())
+        {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset)
+            {
+                previous->second += size;
+                return;
+            }
+        }
+
+        blocks[offset] = size;
+    }
+
+    unsigned int Capacity() const { return capacity; }
+    unsigned int BlockCount() const { return (unsigned int)blocks.size(); }
+
+    unsigned int FreeSize() const
+    {
+        unsigned int total = 0;
+        for (auto &block : blocks)
+            total += block.second;
+        return total;
+    }
+
+    unsigned int LargestBlock() const
+    {
+        unsigned int largest = 0;
+        for (auto &block : blocks)
+            largest = std::max(largest, block.second);
+        return largest;
+    }
+
+private:
+    unsigned int capacity;
+    std::map<unsigned int, unsigned int> blocks; // offset -> size
+};
+
+// -------------------------------------------------------------------------------------------------------------------------
+
+typedef int GeometryHandle; // index into the heap's handle table, -1 = none
+
+// part of an allocation's indices (one LOD of a mesh, they all index the same vertices)
+struct GeometryRange
+{
+    GeometryHandle handle;
+    unsigned int firstIndex, indexCount; // in indices, from the allocation's first
+};
+
+struct GeometryHeapStats
+{
+    unsigned int vertexCapacity, verticesUsed;
+    unsigned int vertexStride;   // bytes per vertex of the heap's format
+    unsigned int indexCapacity, indicesUsed; // in 2 byte slots
+    unsigned int shortIndexAllocations;      // meshes with 16 bit indices
+    unsigned int allocations;
+    unsigned int freeBlocks;     // vertex + index free blocks
+    float fragmentation;         // 1 - largest free block / free space, worst of the two buffers (0 = one free block)
+    unsigned int compactions;    // relocations so far, including growing
+
+    void Print() const
+    {
+        std::cout << "geometry heap: " << allocations << " allocations"
+                  << " | vertices " << verticesUsed << " / " << vertexCapacity << " (" << (size_t)verticesUsed * vertexStride / 1024 << " KB, " << vertexStride << " B each)"
+                  << " | index slots " << indicesUsed << " / " << indexCapacity << " (" << (size_t)indicesUsed * 2 / 1024 << " KB, "
+                  << shortIndexAllocations << " / " << allocations << " meshes 16 bit)"
+                  << " | free blocks: " << freeBlocks
+                  << " | fragmentation: " << fragmentation * 100.0f << "%"
+                  << " | compactions: " << compactions << std::endl;
+    }
+};
+
+// shared vertex + index buffer for every mesh of one vertex format, drawn through a single VAO
+// meshes keep a handle, not offsets: Compact() moves their data around (glCopyBufferSubData) and only the table changes
+// indices are relative to the mesh's first vertex, draws add it back with the base vertex
+// meshes with at most 65536 vertices get 16 bit indices; the index buffer is handed out in 2 byte slots,
+// allocations always take an even number of them so 32 bit indices stay 4 byte aligned
+// a draw can cover part of an allocation's indices (GeometryRange), that's how meshes pick one of their LODs
+class GeometryHeap
+{
+public:
+    GeometryHeap(const VertexFormat &format, unsigned int vertexCapacity = GEOMETRY_HEAP_VERTICES, unsigned int indexCapacity = GEOMETRY_HEAP_INDICES)
+        : format(format)
+    {
+        glGenVertexArrays(1, &VAO);
+        createBuffers(vertexCapacity, indexCapacity, VBO, EBO);
+        vertexSpace.Reset(vertexCapacity, 0);
+        indexSpace.Reset(indexCapacity, 0);
+        setupVAO();
+    }
+
+    // copies the mesh in, compacts or grows the buffers if it doesn't fit anywhere
+    GeometryHandle Add(const void *vertices, unsigned int vertexCount, const unsigned int *indices, unsigned int indexCount)
+    {
+        GLenum indexType = vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        unsigned int indexSlots = indexType == GL_UNSIGNED_SHORT ? (indexCount + 1) & ~1u : indexCount * 2;
+
+        long long vertexOffset = vertexSpace.Allocate(vertexCount);
+        long long indexOffset = indexSpace.Allocate(indexSlots);
+
+        if (vertexOffset < 0 || indexOffset < 0)
+        {
+            if (vertexOffset >= 0)
+                vertexSpace.Free((unsigned int)vertexOffset, vertexCount);
+            if (indexOffset >= 0)
+                indexSpace.Free((unsigned int)indexOffset, indexSlots);
+
+            // compacted, everything free sits at the end; grow if that still isn't enough
+            unsigned int vertexCapacity = vertexSpace.Capacity();
+            unsigned int indexCapacity = indexSpace.Capacity();
+            while (vertexCapacity - verticesUsed < vertexCount)
+                vertexCapacity *= 2;
+            while (indexCapacity - indicesUsed < indexSlots)
+                indexCapacity *= 2;
+
+            relocate(vertexCapacity, indexCapacity);
+
+            vertexOffset = vertexSpace.Allocate(vertexCount);
+            indexOffset = indexSpace.Allocate(indexSlots);
+        }
+
+        GeometryHandle handle;
+        if (!freeHandles.empty())
+        {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+        }
+        else
+        {
+            handle = (GeometryHandle)table.size();
+            table.emplace_back();
+        }
+
+        Allocation &allocation = table[handle];
+        allocation.vertexOffset = (unsigned int)vertexOffset;
+        allocation.vertexCount = vertexCount;
+        allocation.indexOffset = (unsigned int)indexOffset;
+        allocation.indexCount = indexCount;
+        allocation.indexSlots = indexSlots;
+        allocation.indexType = indexType;
+        allocation.alive = true;
+
+        verticesUsed += vertexCount;
+        indicesUsed += indexSlots;
+
+        const void *indexData = indices;
+        if (indexType == GL_UNSIGNED_SHORT)
+        {
+            shortIndices.assign(indices, indices + indexCount);
+            indexData = shortIndices.data();
+        }
+
+        // copy targets, so neither the bound VAO's element buffer nor the array buffer binding change
+        glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)allocation.vertexOffset * format.stride, (GLsizeiptr)vertexCount * format.stride, vertices);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)allocation.indexOffset * 2, (GLsizeiptr)indexCount * indexSize(indexType), indexData);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        return handle;
+    }
+
+    void Free(GeometryHandle handle)
+    {
+        if (handle < 0 || handle >= (GeometryHandle)table.size() || !table[handle].alive)
+            return;
+
+        Allocation &allocation = table[handle];
+        vertexSpace.Free(allocation.vertexOffset, allocation.vertexCount);
+        indexSpace.Free(allocation.indexOffset, allocation.indexSlots);
+
+        verticesUsed -= allocation.vertexCount;
+        indicesUsed -= allocation.indexSlots;
+
+        allocation.alive = false;
+        freeHandles.push_back(handle);
+    }
+
+    // packs every allocation to the front of the buffers, same capacity
+    void Compact()
+    {
+        relocate(vertexSpace.Capacity(), indexSpace.Capacity());
+    }
+
+    unsigned int IndexCount(GeometryHandle handle) const
+    {
+        return table[handle].indexCount;
+    }
+
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    GLenum IndexType(GeometryHandle handle) const
+    {
+        return table[handle].indexType;
+    }
+
+    // the heap's VAO, has to be bound for Draw / MultiDraw
+    void Bind() const
+    {
+        glBindVertexArray(VAO);
+    }
+
+    // every index of handle
+    GeometryRange Range(GeometryHandle handle) const
+    {
+        return GeometryRange{handle, 0, table[handle].indexCount};
+    }
+
+    void Draw(GeometryHandle handle, GLenum mode = GL_TRIANGLES) const
+    {
+        Draw(Range(handle), mode);
+    }
+
+    void Draw(const GeometryRange &range, GLenum mode = GL_TRIANGLES) const
+    {
+        const Allocation &allocation = table[range.handle];
+        glDrawElementsBaseVertex(mode, range.indexCount, allocation.indexType, indexPointer(allocation, range.firstIndex), allocation.vertexOffset);
+        countTriangles(mode, range.indexCount);
+        frameStats.drawCalls++;
+    }
+
+    // instances copies of range in one draw, the bound VAO needs its instance attributes (instancing.h)
+    void DrawInstanced(const GeometryRange &range, int instances, GLenum mode = GL_TRIANGLES) const
+    {
+        if (instances <= 0)
+            return;
+
+        const Allocation &allocation = table[range.handle];
+        glDrawElementsInstancedBaseVertex(mode, range.indexCount, allocation.indexType, indexPointer(allocation, range.firstIndex), instances,
+                                          allocation.vertexOffset);
+        countTriangles(mode, range.indexCount * instances);
+        frameStats.drawCalls++;
+        frameStats.instancesDrawn += instances;
+    }
+
+    // every handle in one call per index type, for meshes that share all their state
+    void MultiDraw(const GeometryHandle *handles, int count, GLenum mode = GL_TRIANGLES)
+    {
+        ranges.clear();
+        for (int i = 0; i < count; i++)
+            ranges.push_back(Range(handles[i]));
+
+        MultiDraw(ranges.data(), count, mode);
+    }
+
+    void MultiDraw(const GeometryRange *draws, int count, GLenum mode = GL_TRIANGLES)
+    {
+        if (count == 1)
+        {
+            Draw(draws[0], mode);
+            return;
+        }
+
+        for (GLenum indexType : {GL_UNSIGNED_SHORT, GL_UNSIGNED_INT})
+        {
+            counts.clear();
+            offsets.clear();
+            baseVertices.clear();
+
+            for (int i = 0; i < count; i++)
+            {
+                const Allocation &allocation = table[draws[i].handle];
+                if (allocation.indexType != indexType)
+                    continue;
+
+                counts.push_back(draws[i].indexCount);
+                offsets.push_back(indexPointer(allocation, draws[i].firstIndex));
+                baseVertices.push_back(allocation.vertexOffset);
+                countTriangles(mode, draws[i].indexCount);
+            }
+
+            if (counts.empty())
+                continue;
+
+            glMultiDrawElementsBaseVertex(mode, counts.data(), indexType, offsets.data(), (GLsizei)counts.size(), baseVertices.data());
+            frameStats.multiDraws++;
+            frameStats.drawCalls++;
+        }
+    }
+
+    GeometryHeapStats Stats() const
+    {
+        GeometryHeapStats stats;
+        stats.vertexCapacity = vertexSpace.Capacity();
+        stats.verticesUsed = verticesUsed;
+        stats.vertexStride = format.stride;
+        stats.indexCapacity = indexSpace.Capacity();
+        stats.indicesUsed = indicesUsed;
+        stats.shortIndexAllocations = 0;
+        for (const Allocation &allocation : table)
+            stats.shortIndexAllocations += allocation.alive && allocation.indexType == GL_UNSIGNED_SHORT;
+        stats.allocations = (unsigned int)(table.size() - freeHandles.size());
+        stats.freeBlocks = vertexSpace.BlockCount() + indexSpace.BlockCount();
+        stats.fragmentation = std::max(fragmentation(vertexSpace), fragmentation(indexSpace));
+        stats.compactions = compactions;
+        return stats;
+    }
+
+    void del()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
+    }
+
+private:
+    struct Allocation
+    {
+        unsigned int vertexOffset, vertexCount;
+        unsigned int indexOffset, indexCount; // offset in slots, count in indices
+        unsigned int indexSlots;
+        GLenum indexType;
+        bool alive;
+    };
+
+    VertexFormat format;
+    unsigned int VAO, VBO, EBO;
+
+    FreeList vertexSpace, indexSpace;
+    unsigned int verticesUsed = 0, indicesUsed = 0;
+
+    std::vector<Allocation> table;
+    std::vector<GeometryHandle> freeHandles;
+    unsigned int compactions = 0;
+
+    // MultiDraw scratch, reused between calls
+    std::vector<GLsizei> counts;
+    std::vector<void *> offsets;
+    std::vector<GLint> baseVertices;
+    std::vector<GeometryRange> ranges;
+    std::vector<uint16_t> shortIndices; // Add scratch
+
+    static unsigned int indexSize(GLenum indexType)
+    {
+        return indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    }
+
+    // byte offset of index firstIndex of the allocation, as the draws take it
+    static void *indexPointer(const Allocation &allocation, unsigned int firstIndex)
+    {
+        return (void *)((size_t)allocation.indexOffset * 2 + (size_t)firstIndex * indexSize(allocation.indexType));
+    }
+
+    static void countTriangles(GLenum mode, unsigned int indexCount)
+    {
+        if (mode == GL_TRIANGLES)
+            frameStats.triangles += indexCount / 3;
+    }
+
+    static float fragmentation(const FreeList &space)
+    {
+        unsigned int free = space.FreeSize();
+        return free ? 1.0f - (float)space.LargestBlock() / free : 0.0f;
+    }
+
+    void createBuffers(unsigned int vertexCapacity, unsigned int indexCapacity, unsigned int &vbo, unsigned int &ebo)
+    {
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ebo);
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)vertexCapacity * format.stride, NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)indexCapacity * 2, NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    void setupVAO()
+    {
+        glBindVertexArray(VAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+        for (const VertexAttribute &attribute : format.attributes)
+        {
+            glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized, format.stride, (void *)(size_t)attribute.offset);
+            glEnableVertexAttribArray(attribute.location);
+        }
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // copies every live allocation, packed in offset order, into new buffers of the given capacity
+    // ! glCopyBufferSubData can't copy between overlapping ranges of one buffer, hence new buffers instead of in place
+    void relocate(unsigned int vertexCapacity, unsigned int indexCapacity)
+    {
+        unsigned int newVBO, newEBO;
+        createBuffers(vertexCapacity, indexCapacity, newVBO, newEBO);
+
+        std::vector<GeometryHandle> order;
+        for (GeometryHandle handle = 0; handle < (GeometryHandle)table.size(); handle++)
+            if (table[handle].alive)
+                order.push_back(handle);
+
+        // vertices
+        std::sort(order.begin(), order.end(), [this](GeometryHandle a, GeometryHandle b)
+                  { return table[a].vertexOffset < table[b].vertexOffset; });
+
+        glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, newVBO);
+
+        unsigned int vertexEnd = 0;
+        for (GeometryHandle handle : order)
+        {
+            Allocation &allocation = table[handle];
+            if (allocation.vertexCount > 0)
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)allocation.vertexOffset * format.stride,
+                                    (GLintptr)vertexEnd * format.stride, (GLsizeiptr)allocation.vertexCount * format.stride);
+            allocation.vertexOffset = vertexEnd;
+            vertexEnd += allocation.vertexCount;
+        }
+
+        // indices, relative to the first vertex so they move as they are
+        std::sort(order.begin(), order.end(), [this](GeometryHandle a, GeometryHandle b)
+                  { return table[a].indexOffset < table[b].indexOffset; });
+
+        glBindBuffer(GL_COPY_READ_BUFFER, EBO);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, newEBO);
+
+        unsigned int indexEnd = 0;
+        for (GeometryHandle handle : order)
+        {
+            Allocation &allocation = table[handle];
+            if (allocation.indexSlots > 0)
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)allocation.indexOffset * 2,
+                                    (GLintptr)indexEnd * 2, (GLsizeiptr)allocation.indexSlots * 2);
+            allocation.indexOffset = indexEnd;
+            indexEnd += allocation.indexSlots;
+        }
+
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        VBO = newVBO;
+        EBO = newEBO;
+
+        vertexSpace.Reset(vertexCapacity, vertexEnd);
+        indexSpace.Reset(indexCapacity, indexEnd);
+        setupVAO();
+
+        compactions++;
+    }
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+// glad is generated for 3.3 core only, entry points from newer versions / extensions are loaded here
+// call loadGLExtensions() right after gladLoadGLLoader()
+
+// + ARB_get_program_binary (core in 4.1)
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+
+typedef void(APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void(APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void(APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+inline PFNGLGETPROGRAMBINARYPROC ext_glGetProgramBinary = NULL;
+inline PFNGLPROGRAMBINARYPROC ext_glProgramBinary = NULL;
+inline PFNGLPROGRAMPARAMETERIPROC ext_glProgramParameteri = NULL;
+
+#define glGetProgramBinary ext_glGetProgramBinary
+#define glProgramBinary ext_glProgramBinary
+#define glProgramParameteri ext_glProgramParameteri
+
+// + KHR_parallel_shader_compile / ARB_parallel_shader_compile (same enums)
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+
+typedef void(APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+inline PFNGLMAXSHADERCOMPILERTHREADSKHRPROC ext_glMaxShaderCompilerThreadsKHR = NULL;
+
+#define glMaxShaderCompilerThreadsKHR ext_glMaxShaderCompilerThreadsKHR
+
+// + EXT_texture_compression_s3tc (BC1 - BC3), enums only; RGTC (BC4 / BC5) is core in 3.0
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+
+// which of the above are usable on the current context
+struct GLExtensions
+{
+    bool programBinary = false;
+    bool parallelShaderCompile = false; // GL_COMPLETION_STATUS_KHR can be polled without blocking
+    bool textureCompressionS3TC = false;
+};
+
+inline GLExtensions glExt;
+
+inline bool hasGLExtension(const char *name)
+{
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int i = 0; i < count; i++)
+    {
+        if (std::strcmp((const char *)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+            return true;
+    }
+    return false;
+}
+
+inline void loadGLExtensions(GLADloadproc load)
+{
+    bool gl41 = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 1);
+
+    if (gl41 || hasGLExtension("GL_ARB_get_program_binary"))
+    {
+        ext_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+        ext_glProgramBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+        ext_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+
+        // a driver can expose the entry points but support no binary formats at all
+        int formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+        glExt.programBinary = ext_glGetProgramBinary && ext_glProgramBinary && ext_glProgramParameteri && formats > 0;
+    }
+
+    if (hasGLExtension("GL_KHR_parallel_shader_compile"))
+        ext_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+    else if (hasGLExtension("GL_ARB_parallel_shader_compile"))
+        ext_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsARB");
+
+    if (ext_glMaxShaderCompilerThreadsKHR)
+    {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); // let the driver pick how many threads
+        glExt.parallelShaderCompile = true;
+    }
+
+    glExt.textureCompressionS3TC = hasGLExtension("GL_EXT_texture_compression_s3tc");
+}
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef GPU_CULLING_H
+#define GPU_CULLING_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <lib/constants.h>
+#include <lib/frustum.h>
+#include <lib/hiz.h>
+#include <lib/shader_s.h>
+#include <lib/shader_builder.h>
+#include <lib/stats.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// one instance of a mesh drawn many times, the layout instanced.vs reads (attributes INSTANCE_ATTRIBUTE, INSTANCE_ATTRIBUTE + 1)
+struct GpuInstance
+{
+    glm::vec4 positionScale; // xyz = position, w = uniform scale
+    glm::vec4 color;
+};
+
+const unsigned int INSTANCE_ATTRIBUTE = 3; // mesh attributes keep 0 - 2
+
+// GPU driven visibility for many instances of one mesh, the CPU never looks at a single instance after SetInstances()
+// Cull(): gpu_cull.vs tests every instance against the frustum and last frame's Hi-Z pyramid (hiz.h), gpu_cull.gs keeps the visible
+// ones and transform feedback packs them into an output buffer; a GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN query counts them
+// Draw(): one instanced draw of the output buffer, with the count from that query
+//
+// the query result is only read once GL_QUERY_RESULT_AVAILABLE says so, Draw() never waits: the output buffers and queries form a
+// ring of GPU_CULL_RING, the draw takes the newest cull whose count is in; if none is, the last count it read (its buffer is
+// still intact) or, before the first one / once that buffer got overwritten, every instance
+// (glDrawTransformFeedbackInstanced would take the *vertex* count from the stream, turning it into an instance count needs GL 4 indirect draws)
+// ------------------------------------------------------------------------
+class GpuInstanceCuller
+{
+public:
+    GpuInstanceCuller()
+        : cullShader(ShaderBuilder("dependencies/shaders/gpu_cull.vs", NULL, "dependencies/shaders/gpu_cull.gs")
+                         .feedback({"culledPositionScale", "culledColor"})
+                         .build())
+    {
+        glGenBuffers(1, &instanceBuffer);
+        glGenBuffers(GPU_CULL_RING, outputBuffers);
+        glGenQueries(GPU_CULL_RING, queries);
+
+        glGenVertexArrays(1, &cullVAO);
+        glBindVertexArray(cullVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        instanceAttributes(0);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        for (int i = 0; i < 6; i++)
+            planeHandles[i] = Shader::Uniform("frustumPlanes[" + std::to_string(i) + "]");
+
+        static const UniformHandle hiZHandle = Shader::Uniform("hiZ");
+        cullShader.use();
+        cullShader.set(hiZHandle, HIZ_UNIT);
+    }
+
+    // the instances from now on, uploaded once (static)
+    void SetInstances(const std::vector<GpuInstance> &instances)
+    {
+        count = (int)instances.size();
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(GpuInstance), instances.data(), GL_STATIC_DRAW);
+        for (unsigned int buffer : outputBuffers)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(GpuInstance), NULL, GL_DYNAMIC_COPY);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        for (int i = 0; i < GPU_CULL_RING; i++)
+            issued[i] = 0;
+        drawnSlot = -1;
+    }
+
+    int Count() const { return count; }
+
+    // frustum (world space) of the frame about to be drawn; hiZ: last frame's pyramid, NULL or not built yet = frustum only
+    // meshCenter / meshRadius: bounding sphere of the mesh every instance draws (model space, before the instance's scale)
+    void Cull(const Frustum &frustum, const HiZPyramid *hiZ, glm::vec3 meshCenter, float meshRadius)
+    {
+        static const UniformHandle meshBoundsHandle = Shader::Uniform("meshBounds");
+        static const UniformHandle useHiZHandle = Shader::Uniform("useHiZ");
+        static const UniformHandle hiZLevelsHandle = Shader::Uniform("hiZLevels");
+        static const UniformHandle hiZViewProjectionHandle = Shader::Uniform("hiZViewProjection");
+
+        if (count == 0)
+            return;
+
+        current = (current + 1) % GPU_CULL_RING;
+        if (current == drawnSlot) // about to be overwritten, can't be drawn again
+            drawnSlot = -1;
+
+        bool useHiZ = hiZ && hiZ->IsBuilt();
+        cullShader.use();
+        for (int i = 0; i < 6; i++)
+            cullShader.set(planeHandles[i], frustum.planes[i]);
+        cullShader.set(meshBoundsHandle, glm::vec4(meshCenter, meshRadius));
+        cullShader.set(useHiZHandle, useHiZ);
+        if (useHiZ)
+        {
+            cullShader.set(hiZLevelsHandle, hiZ->Levels());
+            cullShader.set(hiZViewProjectionHandle, hiZ->ViewProjection());
+            hiZ->Bind(HIZ_UNIT);
+        }
+
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, outputBuffers[current]);
+        glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, queries[current]);
+        glBeginTransformFeedback(GL_POINTS);
+
+        glBindVertexArray(cullVAO);
+        glDrawArrays(GL_POINTS, 0, count);
+
+        glEndTransformFeedback();
+        glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        glDisable(GL_RASTERIZER_DISCARD);
+        glBindVertexArray(0);
+
+        issued[current] = ++culls;
+    }
+
+    // draws the instances that survived the newest Cull() whose count is in, vao = the mesh (attributes 0 - 2, non indexed)
+    // the shader is up to the caller, instanced.vs reads the instance attributes
+    void Draw(unsigned int vao, int vertexCount)
+    {
+        // newest first, anything older than what was drawn last is of no use
+        for (int age = 0; age < GPU_CULL_RING; age++)
+        {
+            int slot = (current - age + GPU_CULL_RING) % GPU_CULL_RING;
+            if (issued[slot] == 0 || (drawnSlot >= 0 && issued[slot] <= issued[drawnSlot]))
+                break;
+
+            unsigned int available = 0;
+            glGetQueryObjectuiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+
+            glGetQueryObjectuiv(queries[slot], GL_QUERY_RESULT, &drawnCount);
+            drawnSlot = slot;
+            break;
+        }
+
+        if (drawnSlot < 0) // nothing culled yet that can be drawn
+        {
+            DrawAll(vao, vertexCount);
+            return;
+        }
+
+        frameStats.gpuInstancesDrawn += drawnCount;
+        frameStats.gpuInstancesCulled += count - drawnCount;
+        drawInstances(vao, vertexCount, outputBuffers[drawnSlot], (int)drawnCount);
+    }
+
+    // every instance, no culling (the A/B baseline)
+    void DrawAll(unsigned int vao, int vertexCount)
+    {
+        frameStats.gpuInstancesDrawn += count;
+        drawInstances(vao, vertexCount, instanceBuffer, count);
+    }
+
+    void del()
+    {
+        cullShader.del();
+        glDeleteVertexArrays(1, &cullVAO);
+        glDeleteBuffers(1, &instanceBuffer);
+        glDeleteBuffers(GPU_CULL_RING, outputBuffers);
+        glDeleteQueries(GPU_CULL_RING, queries);
+    }
+
+private:
+    Shader cullShader;
+    UniformHandle planeHandles[6];
+    unsigned int cullVAO;
+    unsigned int instanceBuffer;
+    unsigned int outputBuffers[GPU_CULL_RING];
+    unsigned int queries[GPU_CULL_RING];
+    unsigned int issued[GPU_CULL_RING] = {}; // which Cull() wrote the slot (1, 2 ...), 0 = none yet
+    unsigned int culls = 0;
+    int current = 0;
+    int drawnSlot = -1;          // slot Draw() read last, its buffer + count stay valid until Cull() comes back to it
+    unsigned int drawnCount = 0;
+    int count = 0;
+
+    // positionScale + color at location, location + 1 of the bound VAO, from the bound GL_ARRAY_BUFFER
+    static void instanceAttributes(unsigned int location)
+    {
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(GpuInstance), (void *)offsetof(GpuInstance, positionScale));
+        glEnableVertexAttribArray(location + 1);
+        glVertexAttribPointer(location + 1, 4, GL_FLOAT, GL_FALSE, sizeof(GpuInstance), (void *)offsetof(GpuInstance, color));
+    }
+
+    // points the mesh VAO's instance attributes at buffer, then one draw
+    static void drawInstances(unsigned int vao, int vertexCount, unsigned int buffer, int instances)
+    {
+        if (instances <= 0)
+            return;
+
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        instanceAttributes(INSTANCE_ATTRIBUTE);
+        glVertexAttribDivisor(INSTANCE_ATTRIBUTE, 1);
+        glVertexAttribDivisor(INSTANCE_ATTRIBUTE + 1, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, instances);
+        glBindVertexArray(0);
+    }
+};
+
+#endif
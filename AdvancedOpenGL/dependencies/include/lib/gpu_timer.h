@@ -0,0 +1,62 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+#include <lib/stats.h>
+
+// GPU time of everything between Begin() and End() (GL_TIME_ELAPSED, core since 3.3)
+// results come back a few frames later, reading them right away would stall on the GPU
+// ! only one can run at a time, time elapsed queries don't nest
+class GpuTimer
+{
+public:
+    GpuTimer()
+    {
+        glGenQueries(QUERY_COUNT, queries);
+    }
+
+    void Begin()
+    {
+        glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+    }
+
+    // ends this frame's query and reports the oldest one that is finished into frameStats.gpuMs
+    void End()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        pending[current] = true;
+        current = (current + 1) % QUERY_COUNT;
+
+        // the next slot gets reused next frame, it is the oldest
+        if (pending[current])
+        {
+            GLint available = 0;
+            glGetQueryObjectiv(queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+            {
+                GLuint64 nanoseconds = 0;
+                glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &nanoseconds);
+                lastMs = nanoseconds / 1.0e6f;
+            }
+            pending[current] = false; // not ready yet: dropped, the slot is needed
+        }
+
+        frameStats.gpuMs = lastMs;
+    }
+
+    void del()
+    {
+        glDeleteQueries(QUERY_COUNT, queries);
+    }
+
+private:
+    static const int QUERY_COUNT = 4;
+
+    unsigned int queries[QUERY_COUNT];
+    bool pending[QUERY_COUNT] = {};
+    int current = 0;
+    float lastMs = 0.0f;
+};
+
+#endif
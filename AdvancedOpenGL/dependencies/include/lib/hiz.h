@@ -0,0 +1,167 @@
+#ifndef HIZ_H
+#define HIZ_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <lib/shader_s.h>
+#include <lib/shader_builder.h>
+
+#include <algorithm>
+
+// hierarchical depth: a finished frame's depth buffer and max reduced levels of it, for occlusion tests on the GPU (gpu_culling.h)
+// level 0 = full resolution, a texel of level n holds the farthest depth of the 2x2 texels (+ odd leftovers) below it in level n - 1
+//
+//  depthTexture  DEPTH24_STENCIL8  blit target, the default framebuffer's depth can't be sampled directly
+//  pyramid       R32F + mips       written level by level through levelFBO
+// ------------------------------------------------------------------------
+class HiZPyramid
+{
+public:
+    HiZPyramid()
+        : copyShader(build("HIZ_COPY")), reduceShader(build("HIZ_REDUCE"))
+    {
+        glGenFramebuffers(1, &depthFBO);
+        glGenFramebuffers(1, &levelFBO);
+        glGenTextures(1, &depthTexture);
+        glGenTextures(1, &pyramid);
+        glGenVertexArrays(1, &emptyVAO);
+
+        static const UniformHandle depthLevelHandle = Shader::Uniform("depthLevel");
+        for (Shader *shader : {&copyShader, &reduceShader})
+        {
+            shader->use();
+            shader->set(depthLevelHandle, 0);
+        }
+    }
+
+    // call once the frame is drawn (before swapping): copies the default framebuffer's depth and reduces it
+    // viewProjection is what that frame was drawn with, tests against the pyramid have to project with it
+    void Build(int width, int height, const glm::mat4 &viewProjection)
+    {
+        if (width != this->width || height != this->height)
+            allocate(width, height);
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthFBO);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glBindFramebuffer(GL_FRAMEBUFFER, levelFBO);
+        glBindVertexArray(emptyVAO);
+        glActiveTexture(GL_TEXTURE0);
+
+        // + level 0
+        copyShader.use();
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid, 0);
+        glViewport(0, 0, width, height);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        // + level n from level n - 1, which is the only one the shader can see (no feedback loop with the level being written)
+        reduceShader.use();
+        glBindTexture(GL_TEXTURE_2D, pyramid);
+        for (int level = 1; level < levels; level++)
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid, level);
+            glViewport(0, 0, levelSize(width, level), levelSize(height, level));
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+        // defaults
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindVertexArray(0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, width, height);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+
+        this->viewProjection = viewProjection;
+        built = true;
+    }
+
+    // false until the first Build(), nothing to test against before that
+    bool IsBuilt() const { return built; }
+
+    int Levels() const { return levels; }
+    const glm::mat4 &ViewProjection() const { return viewProjection; }
+
+    void Bind(int unit) const
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, pyramid);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void del()
+    {
+        copyShader.del();
+        reduceShader.del();
+        glDeleteVertexArrays(1, &emptyVAO);
+        glDeleteTextures(1, &depthTexture);
+        glDeleteTextures(1, &pyramid);
+        glDeleteFramebuffers(1, &depthFBO);
+        glDeleteFramebuffers(1, &levelFBO);
+    }
+
+private:
+    unsigned int depthFBO, levelFBO;
+    unsigned int depthTexture, pyramid;
+    unsigned int emptyVAO;
+    int width = 0, height = 0, levels = 0;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    bool built = false;
+
+    Shader copyShader, reduceShader;
+
+    static Shader build(const char *pass)
+    {
+        return ShaderBuilder("dependencies/shaders/hiz.vs", "dependencies/shaders/hiz.fs").define(1, pass).build();
+    }
+
+    static int levelSize(int size, int level)
+    {
+        return std::max(size >> level, 1);
+    }
+
+    void allocate(int _width, int _height)
+    {
+        width = _width;
+        height = _height;
+        levels = 1;
+        while ((std::max(width, height) >> levels) > 0)
+            levels++;
+
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        glBindTexture(GL_TEXTURE_2D, pyramid);
+        for (int level = 0; level < levels; level++)
+            glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, levelSize(width, level), levelSize(height, level), 0, GL_RED, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, depthFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // a new size means old contents, the next Build() starts over
+        built = false;
+    }
+};
+
+#endif
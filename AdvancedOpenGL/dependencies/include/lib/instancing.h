@@ -0,0 +1,128 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <lib/stats.h>
+#include <lib/transform.h>
+
+#include <cstddef>
+#include <vector>
+
+// one placement of an instanced mesh, what INSTANCED shaders read instead of the model / normalMat uniforms
+struct InstanceTransform
+{
+    glm::mat4 model;
+    glm::mat3 normalMat;
+
+    InstanceTransform(const glm::mat4 &model = glm::mat4(1.0f))
+        : model(model), normalMat(glm::transpose(glm::inverse(glm::mat3(model))))
+    {
+    }
+
+    InstanceTransform(Transform transform)
+        : model(transform.GetModelMat()), normalMat(transform.GetNormalMat())
+    {
+    }
+};
+
+// model matrix columns at 3 - 6, normal matrix columns at 7 - 9; the mesh's own attributes keep 0 - 2
+const unsigned int INSTANCE_MODEL_ATTRIBUTE = 3;
+const unsigned int INSTANCE_NORMAL_ATTRIBUTE = 7;
+
+// per instance attribute buffer (divisor 1), N placements of a mesh go out as one draw instead of N
+// Attach() points the bound VAO at it, any VAO works: the mesh heap's, a hand made cube ...
+// Detach() after the draw, the mesh heap's VAO is shared with every non instanced draw
+// ------------------------------------------------------------------------
+class InstanceBuffer
+{
+public:
+    InstanceBuffer()
+    {
+        glGenBuffers(1, &VBO);
+    }
+
+    InstanceBuffer(const InstanceBuffer &) = delete;
+    InstanceBuffer &operator=(const InstanceBuffer &) = delete;
+
+    // replaces every instance, the buffer only grows (orphaned + refilled otherwise, so last frame's draws don't stall it)
+    void Upload(const std::vector<InstanceTransform> &instances)
+    {
+        count = (unsigned int)instances.size();
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        if (count > capacity)
+            capacity = count;
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)capacity * sizeof(InstanceTransform), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)count * sizeof(InstanceTransform), instances.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    unsigned int Count() const
+    {
+        return count;
+    }
+
+    // instance attributes of the bound VAO from this buffer
+    void Attach() const
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        for (unsigned int column = 0; column < 4; column++)
+        {
+            unsigned int location = INSTANCE_MODEL_ATTRIBUTE + column;
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform),
+                                  (void *)(offsetof(InstanceTransform, model) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(location, 1);
+        }
+        for (unsigned int column = 0; column < 3; column++)
+        {
+            unsigned int location = INSTANCE_NORMAL_ATTRIBUTE + column;
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform),
+                                  (void *)(offsetof(InstanceTransform, normalMat) + column * sizeof(glm::vec3)));
+            glVertexAttribDivisor(location, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // bound VAO back to per vertex attributes only, locations 3 - 9 off with divisor 0
+    static void Detach()
+    {
+        for (unsigned int location = INSTANCE_MODEL_ATTRIBUTE; location < INSTANCE_NORMAL_ATTRIBUTE + 3; location++)
+        {
+            glVertexAttribDivisor(location, 0);
+            glDisableVertexAttribArray(location);
+        }
+    }
+
+    // non indexed mesh in vao (attributes 0 - 2), every instance in one draw
+    void DrawArrays(unsigned int vao, int vertexCount, GLenum mode = GL_TRIANGLES) const
+    {
+        if (count == 0)
+            return;
+
+        glBindVertexArray(vao);
+        Attach();
+        glDrawArraysInstanced(mode, 0, vertexCount, count);
+        Detach();
+        glBindVertexArray(0);
+
+        frameStats.drawCalls++;
+        frameStats.instancesDrawn += count;
+    }
+
+    void del()
+    {
+        glDeleteBuffers(1, &VBO);
+        VBO = 0;
+    }
+
+private:
+    unsigned int VBO;
+    unsigned int count = 0, capacity = 0;
+};
+
+#endif
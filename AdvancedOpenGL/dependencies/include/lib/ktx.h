@@ -0,0 +1,137 @@
+#ifndef KTX_H
+#define KTX_H
+
+#include <glad/glad.h>
+
+#include <lib/gl_extensions.h>
+#include <lib/mapped_file.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// KTX 1.1 container for compressed textures with their whole mip chain (https://registry.khronos.org/KTX/specs/1.0/ktxspec.v1.html)
+// only what the streamer writes is read back: one 2D image, no array / faces, compressed format, little endian, no key / value data
+// layout: 64 byte header | per level: uint32 imageSize, imageSize bytes (padded to 4)
+
+static const uint8_t KTX_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+struct KTXHeader
+{
+    uint8_t identifier[12];
+    uint32_t endianness; // 0x04030201 when written by a machine of the reader's endianness
+    uint32_t glType, glTypeSize, glFormat; // 0, 1, 0 for compressed formats
+    uint32_t glInternalFormat, glBaseInternalFormat;
+    uint32_t pixelWidth, pixelHeight, pixelDepth;
+    uint32_t numberOfArrayElements, numberOfFaces, numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+struct KTXLevel
+{
+    int width, height;
+    const uint8_t *data;
+    size_t bytes;
+};
+
+// -------------------------------------------------------------------------------------------------------------------------
+
+inline GLenum ktxBaseFormat(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_COMPRESSED_RED_RGTC1:
+        return GL_RED;
+    case GL_COMPRESSED_RG_RGTC2:
+        return GL_RG;
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        return GL_RGB;
+    default:
+        return GL_RGBA;
+    }
+}
+
+// writes levels (largest first) to a temporary file and renames it, a reader never sees a half written file
+inline bool WriteKTX(const std::string &path, GLenum internalFormat, const std::vector<KTXLevel> &levels)
+{
+    KTXHeader header = {};
+    memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+    header.endianness = 0x04030201;
+    header.glTypeSize = 1;
+    header.glInternalFormat = internalFormat;
+    header.glBaseInternalFormat = ktxBaseFormat(internalFormat);
+    header.pixelWidth = levels[0].width;
+    header.pixelHeight = levels[0].height;
+    header.numberOfFaces = 1;
+    header.numberOfMipmapLevels = (uint32_t)levels.size();
+
+    std::string tempPath = path + ".tmp";
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        static const char padding[4] = {};
+
+        out.write((const char *)&header, sizeof(header));
+        for (const KTXLevel &level : levels)
+        {
+            uint32_t imageSize = (uint32_t)level.bytes;
+            out.write((const char *)&imageSize, 4);
+            out.write((const char *)level.data, level.bytes);
+            out.write(padding, (4 - level.bytes % 4) % 4);
+        }
+
+        if (!out)
+            return false;
+    }
+
+    std::filesystem::rename(tempPath, path, error);
+    return !error;
+}
+
+// maps path and points levels into it, only valid while file stays open
+// false for anything this reader doesn't handle, the caller rebuilds the file then
+inline bool OpenKTX(const std::string &path, MappedFile &file, GLenum &internalFormat, std::vector<KTXLevel> &levels)
+{
+    if (!file.Open(path) || file.Size() < sizeof(KTXHeader))
+        return false;
+
+    const KTXHeader *header = (const KTXHeader *)file.Data();
+    if (memcmp(header->identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0 || header->endianness != 0x04030201 ||
+        header->glType != 0 || header->pixelDepth != 0 || header->numberOfArrayElements != 0 || header->numberOfFaces != 1 ||
+        header->numberOfMipmapLevels == 0)
+        return false;
+
+    internalFormat = header->glInternalFormat;
+    levels.clear();
+
+    size_t offset = sizeof(KTXHeader) + header->bytesOfKeyValueData;
+    int width = header->pixelWidth, height = header->pixelHeight;
+    for (uint32_t i = 0; i < header->numberOfMipmapLevels; i++)
+    {
+        uint32_t imageSize;
+        if (offset + 4 > file.Size())
+            return false;
+        memcpy(&imageSize, file.Data() + offset, 4);
+        offset += 4;
+
+        if (offset + imageSize > file.Size())
+            return false;
+        levels.push_back({width, height, (const uint8_t *)file.Data() + offset, imageSize});
+        offset += (imageSize + 3) & ~(size_t)3;
+
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+
+    return true;
+}
+
+#endif
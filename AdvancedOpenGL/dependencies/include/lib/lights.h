@@ -6,56 +6,405 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include <lib/shader_s.h>
+#include <lib/constants.h>
+#include <lib/stats.h>
 
+#include <algorithm>
+#include <vector>
+
+// std140 layout of the LightData uniform block, keep in sync with shaders/lighting.glsl
+// (vec4 only, so the C++ structs need no padding)
+// ------------------------------------------------------------------------
+struct GPUPointLight
+{
+    glm::vec4 colorStrength; // rgb = color, a = strength
+    glm::vec4 position;      // xyz = position, w = range
+};
+
+struct GPUDirectionalLight
+{
+    glm::vec4 colorStrength;
+    glm::vec4 direction; // xyz = direction
+};
+
+struct GPUSpotLight
+{
+    glm::vec4 colorStrength;
+    glm::vec4 position;  // xyz = position, w = range
+    glm::vec4 direction; // xyz = direction
+    glm::vec4 cutoffs;   // x = cos(inner cutoff), y = cos(outer cutoff)
+};
+
+// byte offsets inside the block
+const size_t LIGHT_COUNTS_OFFSET = 0; // ivec4: point, directional, spot
+const size_t POINT_LIGHTS_OFFSET = sizeof(glm::ivec4);
+const size_t DIR_LIGHTS_OFFSET = POINT_LIGHTS_OFFSET + MAX_POINT_LIGHTS * sizeof(GPUPointLight);
+const size_t SPOT_LIGHTS_OFFSET = DIR_LIGHTS_OFFSET + MAX_DIR_LIGHTS * sizeof(GPUDirectionalLight);
+const size_t LIGHT_DATA_SIZE = SPOT_LIGHTS_OFFSET + MAX_SPOT_LIGHTS * sizeof(GPUSpotLight);
+
+// owns every light of the scene (SoA on the CPU), packs them into the LightData uniform block
+// setters only mark ranges dirty, Upload() sends the dirty ranges once per frame
+// setters ignore indices out of range, -1 is what the Add*() calls hand out when a type is full
+// ------------------------------------------------------------------------
+class LightManager
+{
+public:
+    struct PointLights
+    {
+        std::vector<glm::vec3> color;
+        std::vector<float> strength;
+        std::vector<glm::vec3> position;
+        std::vector<float> range;
+    } points;
+
+    struct DirectionalLights
+    {
+        std::vector<glm::vec3> color;
+        std::vector<float> strength;
+        std::vector<glm::vec3> direction;
+    } directionals;
+
+    struct SpotLights
+    {
+        std::vector<glm::vec3> color;
+        std::vector<float> strength;
+        std::vector<glm::vec3> position;
+        std::vector<glm::vec3> direction;
+        std::vector<float> range;
+        std::vector<float> innerCutoff; // cosines
+        std::vector<float> outerCutoff;
+    } spots;
+
+    LightManager()
+    {
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, LIGHT_DATA_SIZE, NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_DATA_BINDING, UBO);
+    }
+
+    int PointCount() const { return (int)points.position.size(); }
+    int DirectionalCount() const { return (int)directionals.direction.size(); }
+    int SpotCount() const { return (int)spots.position.size(); }
+
+    // + point lights
+    // ------------------------------------------------------------------------
+    int AddPointLight(glm::vec3 color, float strength, glm::vec3 position, float range = DEFAULT_LIGHT_RANGE)
+    {
+        if (PointCount() >= MAX_POINT_LIGHTS)
+        {
+            std::cout << "LightManager: more than MAX_POINT_LIGHTS point lights" << std::endl;
+            return -1;
+        }
+
+        points.color.push_back(color);
+        points.strength.push_back(strength);
+        points.position.push_back(position);
+        points.range.push_back(range);
+
+        countsDirty = true;
+        markDirty(pointDirty, PointCount() - 1);
+        return PointCount() - 1;
+    }
+
+    void SetPointLightColor(int index, glm::vec3 color)
+    {
+        if (index < 0 || index >= PointCount())
+            return;
+        points.color[index] = color;
+        markDirty(pointDirty, index);
+    }
+
+    void SetPointLightStrength(int index, float strength)
+    {
+        if (index < 0 || index >= PointCount())
+            return;
+        points.strength[index] = strength;
+        markDirty(pointDirty, index);
+    }
+
+    void SetPointLightPos(int index, glm::vec3 position)
+    {
+        if (index < 0 || index >= PointCount())
+            return;
+        points.position[index] = position;
+        markDirty(pointDirty, index);
+    }
+
+    void SetPointLightRange(int index, float range)
+    {
+        if (index < 0 || index >= PointCount())
+            return;
+        points.range[index] = range;
+        markDirty(pointDirty, index);
+    }
+
+    // + directional lights
+    // ------------------------------------------------------------------------
+    int AddDirectionalLight(glm::vec3 color, float strength, glm::vec3 direction)
+    {
+        if (DirectionalCount() >= MAX_DIR_LIGHTS)
+        {
+            std::cout << "LightManager: more than MAX_DIR_LIGHTS directional lights" << std::endl;
+            return -1;
+        }
+
+        directionals.color.push_back(color);
+        directionals.strength.push_back(strength);
+        directionals.direction.push_back(direction);
+
+        countsDirty = true;
+        markDirty(dirDirty, DirectionalCount() - 1);
+        return DirectionalCount() - 1;
+    }
+
+    void SetDirectionalLightColor(int index, glm::vec3 color)
+    {
+        if (index < 0 || index >= DirectionalCount())
+            return;
+        directionals.color[index] = color;
+        markDirty(dirDirty, index);
+    }
+
+    void SetDirectionalLightStrength(int index, float strength)
+    {
+        if (index < 0 || index >= DirectionalCount())
+            return;
+        directionals.strength[index] = strength;
+        markDirty(dirDirty, index);
+    }
+
+    void SetDirectionalLightDir(int index, glm::vec3 direction)
+    {
+        if (index < 0 || index >= DirectionalCount())
+            return;
+        directionals.direction[index] = direction;
+        markDirty(dirDirty, index);
+    }
+
+    // + spot lights, cutoffs in degrees
+    // ------------------------------------------------------------------------
+    int AddSpotLight(glm::vec3 color, float strength, glm::vec3 position, glm::vec3 direction, float innerCutoff, float outerCutoff, float range = DEFAULT_LIGHT_RANGE)
+    {
+        if (SpotCount() >= MAX_SPOT_LIGHTS)
+        {
+            std::cout << "LightManager: more than MAX_SPOT_LIGHTS spot lights" << std::endl;
+            return -1;
+        }
+
+        spots.color.push_back(color);
+        spots.strength.push_back(strength);
+        spots.position.push_back(position);
+        spots.direction.push_back(direction);
+        spots.range.push_back(range);
+        spots.innerCutoff.push_back(glm::cos(glm::radians(innerCutoff)));
+        spots.outerCutoff.push_back(glm::cos(glm::radians(outerCutoff)));
+
+        countsDirty = true;
+        markDirty(spotDirty, SpotCount() - 1);
+        return SpotCount() - 1;
+    }
+
+    void SetSpotLightColor(int index, glm::vec3 color)
+    {
+        if (index < 0 || index >= SpotCount())
+            return;
+        spots.color[index] = color;
+        markDirty(spotDirty, index);
+    }
+
+    void SetSpotLightStrength(int index, float strength)
+    {
+        if (index < 0 || index >= SpotCount())
+            return;
+        spots.strength[index] = strength;
+        markDirty(spotDirty, index);
+    }
+
+    void SetSpotLightPos(int index, glm::vec3 position)
+    {
+        if (index < 0 || index >= SpotCount())
+            return;
+        spots.position[index] = position;
+        markDirty(spotDirty, index);
+    }
+
+    void SetSpotLightDir(int index, glm::vec3 direction)
+    {
+        if (index < 0 || index >= SpotCount())
+            return;
+        spots.direction[index] = direction;
+        markDirty(spotDirty, index);
+    }
+
+    void SetSpotLightRange(int index, float range)
+    {
+        if (index < 0 || index >= SpotCount())
+            return;
+        spots.range[index] = range;
+        markDirty(spotDirty, index);
+    }
+
+    void SetSpotLightCutoffs(int index, float innerCutoff, float outerCutoff)
+    {
+        if (index < 0 || index >= SpotCount())
+            return;
+        spots.innerCutoff[index] = glm::cos(glm::radians(innerCutoff));
+        spots.outerCutoff[index] = glm::cos(glm::radians(outerCutoff));
+        markDirty(spotDirty, index);
+    }
+
+    // packs + uploads whatever changed since the last call
+    // ------------------------------------------------------------------------
+    void Upload()
+    {
+        if (!countsDirty && pointDirty.empty() && dirDirty.empty() && spotDirty.empty())
+            return;
+
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+
+        if (countsDirty)
+        {
+            glm::ivec4 counts(PointCount(), DirectionalCount(), SpotCount(), 0);
+            upload(LIGHT_COUNTS_OFFSET, &counts, sizeof(counts));
+            countsDirty = false;
+        }
+
+        if (!pointDirty.empty())
+        {
+            std::vector<GPUPointLight> packed(pointDirty.end - pointDirty.begin);
+            for (int i = pointDirty.begin; i < pointDirty.end; i++)
+            {
+                packed[i - pointDirty.begin].colorStrength = glm::vec4(points.color[i], points.strength[i]);
+                packed[i - pointDirty.begin].position = glm::vec4(points.position[i], points.range[i]);
+            }
+            upload(POINT_LIGHTS_OFFSET + pointDirty.begin * sizeof(GPUPointLight), packed.data(), packed.size() * sizeof(GPUPointLight));
+            pointDirty = DirtyRange();
+        }
+
+        if (!dirDirty.empty())
+        {
+            std::vector<GPUDirectionalLight> packed(dirDirty.end - dirDirty.begin);
+            for (int i = dirDirty.begin; i < dirDirty.end; i++)
+            {
+                packed[i - dirDirty.begin].colorStrength = glm::vec4(directionals.color[i], directionals.strength[i]);
+                packed[i - dirDirty.begin].direction = glm::vec4(directionals.direction[i], 0.0f);
+            }
+            upload(DIR_LIGHTS_OFFSET + dirDirty.begin * sizeof(GPUDirectionalLight), packed.data(), packed.size() * sizeof(GPUDirectionalLight));
+            dirDirty = DirtyRange();
+        }
+
+        if (!spotDirty.empty())
+        {
+            std::vector<GPUSpotLight> packed(spotDirty.end - spotDirty.begin);
+            for (int i = spotDirty.begin; i < spotDirty.end; i++)
+            {
+                packed[i - spotDirty.begin].colorStrength = glm::vec4(spots.color[i], spots.strength[i]);
+                packed[i - spotDirty.begin].position = glm::vec4(spots.position[i], spots.range[i]);
+                packed[i - spotDirty.begin].direction = glm::vec4(spots.direction[i], 0.0f);
+                packed[i - spotDirty.begin].cutoffs = glm::vec4(spots.innerCutoff[i], spots.outerCutoff[i], 0.0f, 0.0f);
+            }
+            upload(SPOT_LIGHTS_OFFSET + spotDirty.begin * sizeof(GPUSpotLight), packed.data(), packed.size() * sizeof(GPUSpotLight));
+            spotDirty = DirtyRange();
+        }
+
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void del()
+    {
+        glDeleteBuffers(1, &UBO);
+    }
+
+private:
+    unsigned int UBO;
+
+    // [begin, end) of the lights that changed, one contiguous range per type is enough for how lights get edited
+    struct DirtyRange
+    {
+        int begin = 0;
+        int end = 0;
+
+        bool empty() const { return begin >= end; }
+    };
+
+    bool countsDirty = true;
+    DirtyRange pointDirty, dirDirty, spotDirty;
+
+    void markDirty(DirtyRange &range, int index)
+    {
+        if (range.empty())
+        {
+            range.begin = index;
+            range.end = index + 1;
+            return;
+        }
+        range.begin = std::min(range.begin, index);
+        range.end = std::max(range.end, index + 1);
+    }
+
+    void upload(size_t offset, const void *data, size_t size)
+    {
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+        frameStats.lightUploads++;
+        frameStats.lightBytesUploaded += (unsigned int)size;
+    }
+};
+
+// thin handles to a light inside a LightManager, same interface as before the manager existed
+// index is -1 when the manager was full, Valid() tells, setters then only keep the values
+// ------------------------------------------------------------------------
 class PointLight
 {
 public:
     glm::vec3 lightColor;
     float lightStrength;
     glm::vec3 lightPos;
-    Shader *shaderProg;
+    float lightRange;
+    LightManager *manager;
+    int index;
 
-    PointLight(Shader *_shaderProg, glm::vec3 _lightColor, float _lightStrength, glm::vec3 _lightPos, int index)
+    PointLight(LightManager *_manager, glm::vec3 _lightColor, float _lightStrength, glm::vec3 _lightPos, float _lightRange = DEFAULT_LIGHT_RANGE)
     {
-        shaderProg = _shaderProg;
+        manager = _manager;
         lightColor = _lightColor;
         lightStrength = _lightStrength;
         lightPos = _lightPos;
+        lightRange = _lightRange;
 
-        posChar = "pointLights[" + std::to_string(index) + "].lightPos";
-        colorChar = "pointLights[" + std::to_string(index) + "].lightColor";
-        strengthChar = "pointLights[" + std::to_string(index) + "].lightStrength";
-
-        shaderProg->use();
+        index = manager->AddPointLight(lightColor, lightStrength, lightPos, lightRange);
+    }
 
-        shaderProg->setVec3(colorChar, glm::value_ptr(lightColor));
-        shaderProg->setFloat(strengthChar, lightStrength);
-        shaderProg->setVec3(posChar, glm::value_ptr(lightPos));
+    bool Valid() const
+    {
+        return index >= 0;
     }
 
     void SetLightColor(glm::vec3 _lightColor)
     {
         lightColor = _lightColor;
-        shaderProg->setVec3(colorChar, glm::value_ptr(lightColor));
+        manager->SetPointLightColor(index, lightColor);
     }
 
     void SetLightStrength(float _lightStrength)
     {
         lightStrength = _lightStrength;
-        shaderProg->setFloat(strengthChar, lightStrength);
+        manager->SetPointLightStrength(index, lightStrength);
     }
 
     void SetLightPos(glm::vec3 _lightPos)
     {
         lightPos = _lightPos;
-        shaderProg->setVec3(posChar, glm::value_ptr(lightPos));
+        manager->SetPointLightPos(index, lightPos);
     }
 
-private:
-    std::string posChar;
-    std::string colorChar;
-    std::string strengthChar;
+    void SetLightRange(float _lightRange)
+    {
+        lightRange = _lightRange;
+        manager->SetPointLightRange(index, lightRange);
+    }
 };
 
 class DirectionalLight
@@ -64,48 +413,41 @@ public:
     glm::vec3 lightColor;
     float lightStrength;
     glm::vec3 lightDir;
-    Shader *shaderProg;
+    LightManager *manager;
+    int index;
 
-    DirectionalLight(Shader *_shaderProg, glm::vec3 _lightColor, float _lightStrength, glm::vec3 _lightDir, int index)
+    DirectionalLight(LightManager *_manager, glm::vec3 _lightColor, float _lightStrength, glm::vec3 _lightDir)
     {
-        shaderProg = _shaderProg;
+        manager = _manager;
         lightColor = _lightColor;
         lightStrength = _lightStrength;
         lightDir = _lightDir;
 
-        shaderProg->use();
-
-        dirChar = "directionalLights[" + std::to_string(index) + "].lightDir";
-        colorChar = "directionalLights[" + std::to_string(index) + "].lightColor";
-        strengthChar = "directionalLights[" + std::to_string(index) + "].lightStrength";
+        index = manager->AddDirectionalLight(lightColor, lightStrength, lightDir);
+    }
 
-        shaderProg->setVec3(colorChar, glm::value_ptr(lightColor));
-        shaderProg->setFloat(strengthChar, lightStrength);
-        shaderProg->setVec3(dirChar, glm::value_ptr(lightDir));
+    bool Valid() const
+    {
+        return index >= 0;
     }
 
     void SetLightColor(glm::vec3 _lightColor)
     {
         lightColor = _lightColor;
-        shaderProg->setVec3(colorChar, glm::value_ptr(lightColor));
+        manager->SetDirectionalLightColor(index, lightColor);
     }
 
     void SetLightStrength(float _lightStrength)
     {
         lightStrength = _lightStrength;
-        shaderProg->setFloat(strengthChar, lightStrength);
+        manager->SetDirectionalLightStrength(index, lightStrength);
     }
 
     void SetLightDir(glm::vec3 _lightDir)
     {
         lightDir = _lightDir;
-        shaderProg->setVec3(dirChar, glm::value_ptr(lightDir));
+        manager->SetDirectionalLightDir(index, lightDir);
     }
-
-private:
-    std::string dirChar;
-    std::string colorChar;
-    std::string strengthChar;
 };
 
 class SpotLight
@@ -115,79 +457,72 @@ public:
     float lightStrength;
     glm::vec3 lightPos;
     glm::vec3 lightDir;
-    float innerCutoff;
+    float innerCutoff; // degrees
     float outerCutoff;
-    Shader *shaderProg;
+    float lightRange;
+    LightManager *manager;
+    int index;
 
-    SpotLight(Shader *_shaderProg, glm::vec3 _lightColor, float _lightStrength, glm::vec3 _lightPos, glm::vec3 _lightDir, float _innerCutoff, float _outerCutoff, int index)
+    SpotLight(LightManager *_manager, glm::vec3 _lightColor, float _lightStrength, glm::vec3 _lightPos, glm::vec3 _lightDir, float _innerCutoff, float _outerCutoff, float _lightRange = DEFAULT_LIGHT_RANGE)
     {
-        shaderProg = _shaderProg;
+        manager = _manager;
         lightColor = _lightColor;
         lightStrength = _lightStrength;
         lightPos = _lightPos;
         lightDir = _lightDir;
         innerCutoff = _innerCutoff;
         outerCutoff = _outerCutoff;
+        lightRange = _lightRange;
 
-        dirChar = "spotLights[" + std::to_string(index) + "].lightDir";
-        colorChar = "spotLights[" + std::to_string(index) + "].lightColor";
-        posChar = "spotLights[" + std::to_string(index) + "].lightPos";
-        strengthChar = "spotLights[" + std::to_string(index) + "].lightStrength";
-        innerCutoffChar = "spotLights[" + std::to_string(index) + "].innerCutoff";
-        outerCutoffChar = "spotLights[" + std::to_string(index) + "].outerCutoff";
-
-        shaderProg->use();
+        index = manager->AddSpotLight(lightColor, lightStrength, lightPos, lightDir, innerCutoff, outerCutoff, lightRange);
+    }
 
-        shaderProg->setVec3(colorChar, glm::value_ptr(lightColor));
-        shaderProg->setFloat(strengthChar, lightStrength);
-        shaderProg->setVec3(posChar, glm::value_ptr(lightPos));
-        shaderProg->setFloat(innerCutoffChar, glm::cos(glm::radians(innerCutoff)));
-        shaderProg->setFloat(outerCutoffChar, glm::cos(glm::radians(outerCutoff)));
+    bool Valid() const
+    {
+        return index >= 0;
     }
 
     void SetLightColor(glm::vec3 _lightColor)
     {
         lightColor = _lightColor;
-        shaderProg->setVec3(colorChar, glm::value_ptr(lightColor));
+        manager->SetSpotLightColor(index, lightColor);
     }
 
     void SetLightStrength(float _lightStrength)
     {
         lightStrength = _lightStrength;
-        shaderProg->setFloat(strengthChar, lightStrength);
+        manager->SetSpotLightStrength(index, lightStrength);
     }
 
     void SetLightPos(glm::vec3 _lightPos)
     {
         lightPos = _lightPos;
-        shaderProg->setVec3(posChar, glm::value_ptr(lightPos));
+        manager->SetSpotLightPos(index, lightPos);
     }
 
     void SetLightDir(glm::vec3 _lightDir)
     {
         lightDir = _lightDir;
-        shaderProg->setVec3(dirChar, glm::value_ptr(lightDir));
+        manager->SetSpotLightDir(index, lightDir);
+    }
+
+    void SetLightRange(float _lightRange)
+    {
+        lightRange = _lightRange;
+        manager->SetSpotLightRange(index, lightRange);
     }
 
     void SetInnerCutoff(float _innerCutoff)
     {
         innerCutoff = _innerCutoff;
-        shaderProg->setFloat(innerCutoffChar, innerCutoff);
+        manager->SetSpotLightCutoffs(index, innerCutoff, outerCutoff);
     }
 
     void SetOuterCutoff(float _outerCutoff)
     {
         outerCutoff = _outerCutoff;
-        shaderProg->setFloat(outerCutoffChar, outerCutoff);
+        manager->SetSpotLightCutoffs(index, innerCutoff, outerCutoff);
     }
-
-private:
-    std::string posChar;
-    std::string dirChar;
-    std::string colorChar;
-    std::string strengthChar;
-    std::string innerCutoffChar;
-    std::string outerCutoffChar;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,68 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// read only mapping of a whole file, unmapped when it goes out of scope
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    bool Open(const std::string &path)
+    {
+        Close();
+#ifndef _WIN32
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            void *mapped = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED)
+            {
+                data = (const char *)mapped;
+                size = (size_t)info.st_size;
+            }
+        }
+        close(fd); // the mapping stays valid
+#endif
+        return data != NULL;
+    }
+
+    void Close()
+    {
+#ifndef _WIN32
+        if (data)
+            munmap((void *)data, size);
+#endif
+        data = NULL;
+        size = 0;
+    }
+
+    const char *Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    const char *data = NULL;
+    size_t size = 0;
+};
+
+#endif
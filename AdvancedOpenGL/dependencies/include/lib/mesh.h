@@ -7,13 +7,25 @@
 
 #include <lib/constants.h>
 #include <lib/shader_s.h>
+#include <lib/shader_permutations.h>
 #include <lib/outline.h>
-
+#include <lib/geometry_heap.h>
+#include <lib/instancing.h>
+#include <lib/vertex_packing.h>
+#include <lib/meshlet.h>
+#include <lib/frustum.h>
+#include <lib/stats.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 using namespace std;
 
+// import / CPU side vertex, the GPU gets it as a PackedVertex (vertex_packing.h)
 struct Vertex
 {
     glm::vec3 Position;
@@ -21,6 +33,14 @@ struct Vertex
     glm::vec2 TexCoords;
 };
 
+// one level of detail: a range of the mesh's indices (every LOD indexes the same vertices) and how far it strays from LOD 0
+struct MeshLod
+{
+    unsigned int firstIndex, indexCount;
+    float error; // model units
+    unsigned int firstMeshlet = 0, meshletCount = 0; // its meshlets (meshlet.h), none: drawn whole
+};
+
 struct Texture
 {
     unsigned int id;
@@ -28,57 +48,291 @@ struct Texture
     string path;
 };
 
+// small id per distinct texture set (texture + sampler uniform per slot), what the render queue sorts materials by; 0 = no textures
+inline unsigned int MaterialId(const vector<Texture> &textures, const vector<UniformHandle> &samplerHandles)
+{
+    static std::map<vector<unsigned int>, unsigned int> ids;
+
+    if (textures.empty())
+        return 0;
+
+    vector<unsigned int> set;
+    for (unsigned int i = 0; i < textures.size(); i++)
+    {
+        set.push_back(textures[i].id);
+        set.push_back((unsigned int)samplerHandles[i]);
+    }
+    return ids.emplace(set, (unsigned int)ids.size() + 1).first->second;
+}
+
+// what one placement of a mesh drew last: the LOD it picked (the hysteresis compares against it) and what meshlet culling left
+// a mesh drawn at several places needs one per place (ModelPlacement, model.h), one shared state would see the other copies' LODs
+struct MeshDrawState
+{
+    unsigned int lod = 0;
+    vector<GeometryRange> visible; // ranges left after CullMeshlets, Mesh::InitialState() has the whole LOD 0
+};
+
+// every Mesh lives in this one heap (one VAO for the PackedVertex layout), created on first use
+// ! needs a current context the first time, and MeshHeap().del() before it goes away
+inline GeometryHeap &MeshHeap()
+{
+    static GeometryHeap heap(PackedVertexFormat());
+    return heap;
+}
+
 class Mesh
 {
 public:
     vector<Vertex> vertices;
     vector<unsigned int> indices;
     vector<Texture> textures;
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f); // model space AABB
+    VertexQuantization quantization; // box the GPU positions are stored in
+    vector<MeshLod> lods;            // finest first, all of them back to back in indices (one heap allocation)
+    vector<Meshlet> meshlets;        // every LOD's, each LOD has its run of them
+
+    // takes the buffers over, Model fills them once and moves them in
+    // positions get quantized inside quantization if given (Model shares one box so its meshes batch), else inside the mesh's own AABB
+    // without lods all indices are LOD 0
+    Mesh(vector<Vertex> &&vertices, vector<unsigned int> &&indices, vector<Texture> &&textures, const VertexQuantization *quantization = NULL,
+         vector<MeshLod> &&lods = {}, vector<Meshlet> &&meshlets = {})
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), lods(std::move(lods)), meshlets(std::move(meshlets))
+    {
+        if (this->lods.empty())
+            this->lods.push_back(MeshLod{0, (unsigned int)this->indices.size(), 0.0f});
+
+        if (!this->vertices.empty())
+        {
+            boundsMin = boundsMax = this->vertices[0].Position;
+            for (const Vertex &vertex : this->vertices)
+            {
+                boundsMin = glm::min(boundsMin, vertex.Position);
+                boundsMax = glm::max(boundsMax, vertex.Position);
+            }
+        }
+        this->quantization = quantization ? *quantization : VertexQuantization::FromBounds(boundsMin, boundsMax);
 
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+        vector<PackedVertex> packed(this->vertices.size());
+        PackVertices(this->vertices.data(), (unsigned int)this->vertices.size(), this->quantization, packed.data());
+
+        setupMesh(packed.data(), (unsigned int)packed.size(), this->indices.data(), (unsigned int)this->indices.size());
+    }
+
+    // uploads already packed vertices from memory it doesn't keep (the mapped model cache), vertices / indices stay empty
+    Mesh(const PackedVertex *vertexData, unsigned int vertexCount, const unsigned int *indexData, unsigned int indexCount,
+         vector<Texture> &&textures, glm::vec3 boundsMin, glm::vec3 boundsMax, const VertexQuantization &quantization, vector<MeshLod> &&lods = {},
+         vector<Meshlet> &&meshlets = {})
+        : textures(std::move(textures)), boundsMin(boundsMin), boundsMax(boundsMax), quantization(quantization), lods(std::move(lods)),
+          meshlets(std::move(meshlets))
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        if (this->lods.empty())
+            this->lods.push_back(MeshLod{0, indexCount, 0.0f});
 
-        setupMesh();
+        setupMesh(vertexData, vertexCount, indexData, indexCount);
     }
 
-    // albedo00 -> albedo texture for material 0;
-    void Draw(Shader *shader)
+    // owns its range of the mesh heap, a copy would share (and later double free or leak) it
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+
+    // noexcept, so vector<Mesh> moves instead of copying when it grows
+    Mesh(Mesh &&other) noexcept
+        : vertices(std::move(other.vertices)), indices(std::move(other.indices)), textures(std::move(other.textures)),
+          boundsMin(other.boundsMin), boundsMax(other.boundsMax), quantization(other.quantization), lods(std::move(other.lods)), meshlets(std::move(other.meshlets)), geometry(other.geometry), samplerHandles(std::move(other.samplerHandles)), features(other.features), materialId(other.materialId)
     {
-        // ? maybe put shader.use() for safety?
+        other.geometry = -1;
+    }
 
-        unsigned int diffuseNR = 0;
-        unsigned int specularNR = 0;
-        unsigned int normalNR = 0;
+    Mesh &operator=(Mesh &&other) noexcept
+    {
+        if (this != &other)
+        {
+            del();
+
+            vertices = std::move(other.vertices);
+            indices = std::move(other.indices);
+            textures = std::move(other.textures);
+            boundsMin = other.boundsMin;
+            boundsMax = other.boundsMax;
+            quantization = other.quantization;
+            lods = std::move(other.lods);
+            meshlets = std::move(other.meshlets);
+            samplerHandles = std::move(other.samplerHandles);
+            features = other.features;
+            materialId = other.materialId;
+
+            geometry = other.geometry;
+            other.geometry = -1;
+        }
+        return *this;
+    }
+
+    ~Mesh()
+    {
+        del();
+    }
+
+    // gives the mesh's vertices and indices back to the heap, only bookkeeping so the destructor is fine too
+    // textures belong to the Model, they can be shared between meshes
+    void del()
+    {
+        if (geometry >= 0)
+            MeshHeap().Free(geometry);
+
+        geometry = -1;
+    }
+
+    GeometryHandle Geometry() const
+    {
+        return geometry;
+    }
+
+    // the indices of a LOD, past the coarsest one means the coarsest
+    GeometryRange Range(unsigned int lod = 0) const
+    {
+        const MeshLod &level = lods[std::min(lod, (unsigned int)lods.size() - 1)];
+        return GeometryRange{geometry, level.firstIndex, level.indexCount};
+    }
+
+    // a placement that hasn't been culled yet: the whole of LOD 0
+    MeshDrawState InitialState() const
+    {
+        MeshDrawState state;
+        state.visible.assign(1, Range(0));
+        return state;
+    }
+
+    // picks the coarsest LOD whose error covers at most MESH_LOD_PIXEL_ERROR pixels, pixelsPerUnit = how many pixels a model unit
+    // covers where the mesh is; the placement's LOD is kept until its error gets too big, a coarser one needs some margin (MESH_LOD_HYSTERESIS)
+    unsigned int SelectLod(MeshDrawState &state, float pixelsPerUnit) const
+    {
+        unsigned int selected = 0;
+        for (unsigned int i = 1; i < lods.size(); i++)
+        {
+            float limit = i > state.lod ? MESH_LOD_PIXEL_ERROR * MESH_LOD_HYSTERESIS : MESH_LOD_PIXEL_ERROR;
+            if (lods[i].error * pixelsPerUnit > limit)
+                break;
+            selected = i;
+        }
+
+        if (selected != state.lod)
+            state.visible.assign(1, Range(selected));
+        return state.lod = selected;
+    }
+
+    // keeps the placement's LOD's meshlets that can be seen from camera: inside frustum and not facing away (both in model space)
+    // neighbouring survivors merge into one range, Draw draws what is left
+    void CullMeshlets(MeshDrawState &state, const Frustum &frustum, glm::vec3 camera) const
+    {
+        const MeshLod &level = lods[state.lod];
+        vector<GeometryRange> &visible = state.visible;
+        visible.clear();
+        if (level.meshletCount == 0)
+        {
+            visible.push_back(Range(state.lod));
+            return;
+        }
 
+        for (unsigned int i = level.firstMeshlet; i < level.firstMeshlet + level.meshletCount; i++)
+        {
+            const Meshlet &meshlet = meshlets[i];
+            if (!frustum.IntersectsSphere(meshlet.center, meshlet.radius) || meshlet.BackFacing(camera))
+            {
+                frameStats.meshletsCulled++;
+                continue;
+            }
+
+            frameStats.meshletsDrawn++;
+            if (!visible.empty() && visible.back().firstIndex + visible.back().indexCount == meshlet.firstIndex)
+                visible.back().indexCount += meshlet.indexCount;
+            else
+                visible.push_back(GeometryRange{geometry, meshlet.firstIndex, meshlet.indexCount});
+        }
+    }
+
+    // same textures bound the same way and the same quantization box, Model batches such meshes into one multi draw
+    bool CanBatchWith(const Mesh &other) const
+    {
+        if (textures.size() != other.textures.size() || !(quantization == other.quantization))
+            return false;
+
+        for (unsigned int i = 0; i < textures.size(); i++)
+            if (textures[i].id != other.textures[i].id || samplerHandles[i] != other.samplerHandles[i])
+                return false;
+
+        return true;
+    }
+
+    // albedo00 -> albedo texture for material 0;
+    void BindTextures(Shader *shader)
+    {
         for (int i = 0; i < textures.size(); i++)
         {
             glActiveTexture(GL_TEXTURE0 + i); // activate proper texture before binding
 
-            string index;
-            string type = textures[i].type;
+            shader->set(samplerHandles[i], i);
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        }
+    }
 
-            if (type == "albedo")
-                index = to_string(diffuseNR++);
-            else if (type == "specular")
-                index = to_string(specularNR++);
-            else if (type == "normal")
-                index = to_string(normalNR++);
+    // dequantization for QUANTIZED shaders, set whenever a shader draws this mesh
+    void BindQuantization(Shader *shader) const
+    {
+        static const UniformHandle positionScaleHandle = Shader::Uniform("positionScale");
+        static const UniformHandle positionOffsetHandle = Shader::Uniform("positionOffset");
 
-            shader->setInt("textureMaterials[" + index + "]." + type, i);
-            glBindTexture(GL_TEXTURE_2D, textures[i].id); // + possible optimization, put this part in setup, instead of draw
-        }
+        shader->set(positionScaleHandle, quantization.scale);
+        shader->set(positionOffsetHandle, quantization.offset);
+    }
+
+    // FEATURE_TEXTURED / FEATURE_NORMAL_MAP depending on which maps this mesh has, + FEATURE_QUANTIZED
+    unsigned int Features() const
+    {
+        return features;
+    }
+
+    // the texture set, meshes with the same one can share texture binds (render_queue.h)
+    unsigned int MaterialId() const
+    {
+        return materialId;
+    }
 
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+    // ranges: what a placement has left (MeshDrawState::visible)
+    void Draw(Shader *shader, const vector<GeometryRange> &ranges)
+    {
+        // ? maybe put shader.use() for safety?
+
+        BindTextures(shader);
+        BindQuantization(shader);
+
+        MeshHeap().Bind();
+        MeshHeap().MultiDraw(ranges.data(), (int)ranges.size());
 
         glBindVertexArray(0);
         glActiveTexture(GL_TEXTURE0);
     }
 
-    void DrawWithOutline(Shader *shader, Outline outline)
+    // every instance at lod in one draw, the shader has to be an INSTANCED one
+    // whole LOD: meshlet culling works for one placement, instances don't share one
+    void DrawInstanced(Shader *shader, const InstanceBuffer &instances, unsigned int lod)
+    {
+        if (instances.Count() == 0)
+            return;
+
+        BindTextures(shader);
+        BindQuantization(shader);
+
+        MeshHeap().Bind();
+        instances.Attach();
+        MeshHeap().DrawInstanced(Range(lod), (int)instances.Count());
+        InstanceBuffer::Detach();
+
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void DrawWithOutline(Shader *shader, Outline outline, const vector<GeometryRange> &ranges)
     {
         // init
         glEnable(GL_STENCIL_TEST);
@@ -88,7 +342,7 @@ public:
 
         // draw (normal shader)
         shader->use();
-        Draw(shader);
+        Draw(shader, ranges);
 
         // disable
         glDisable(GL_CULL_FACE);
@@ -97,17 +351,20 @@ public:
         glStencilMask(0x00);
 
         // draw (outline shader)
+        static const UniformHandle outlineColorHandle = Shader::Uniform("outlineColor");
+        static const UniformHandle modelHandle = Shader::Uniform("model");
+
         outline.outlineShader->use();
-        outline.outlineShader->setVec3("outlineColor", glm::value_ptr(outline.outlineColor));
+        outline.outlineShader->set(outlineColorHandle, outline.outlineColor);
 
         Transform scaledTranform = outline.transform;
         scaledTranform.scale += outline.outlineThickness;
 
-        glm::mat4 modelMat = scaledTranform.GetModelMat();
-        outline.outlineShader->setMat4("model", glm::value_ptr(modelMat));
+        outline.outlineShader->set(modelHandle, scaledTranform.GetModelMat());
+        BindQuantization(outline.outlineShader);
 
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+        MeshHeap().Bind();
+        MeshHeap().MultiDraw(ranges.data(), (int)ranges.size());
 
         // defaults
         glStencilMask(0xFF);
@@ -124,35 +381,42 @@ public:
     }
 
 private:
-    unsigned int VAO, VBO, EBO;
+    GeometryHandle geometry = -1;
+    vector<UniformHandle> samplerHandles; // textureMaterials[n].<type> for every texture, resolved once
+    unsigned int features = FEATURE_QUANTIZED;
+    unsigned int materialId = 0;
 
-    void setupMesh()
+    void setupMesh(const PackedVertex *vertexData, unsigned int vertexCount, const unsigned int *indexData, unsigned int indexCount)
     {
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
+        unsigned int diffuseNR = 0;
+        unsigned int specularNR = 0;
+        unsigned int normalNR = 0;
 
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);                                                            // * contains type Vertex
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW); // * directly pass pointer since structs stored continguous
+        samplerHandles.reserve(textures.size());
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            string index;
+            const string &type = textures[i].type;
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+            if (type == "albedo")
+                index = to_string(diffuseNR++);
+            else if (type == "specular")
+                index = to_string(specularNR++);
+            else if (type == "normal")
+                index = to_string(normalNR++);
 
-        // vertex position
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Position)); // * "offsetof(Vertex, Position)" evaluates to 0
-        glEnableVertexAttribArray(0);
+            if (type == "albedo")
+                features |= FEATURE_TEXTURED;
+            else if (type == "normal")
+                features |= FEATURE_NORMAL_MAP;
 
-        // vertex normals
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, Normal));
-        glEnableVertexAttribArray(1);
+            samplerHandles.push_back(Shader::Uniform("textureMaterials[" + index + "]." + type));
+        }
 
-        // vertex textures
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, TexCoords));
-        glEnableVertexAttribArray(2);
+        materialId = ::MaterialId(textures, samplerHandles);
 
-        glBindVertexArray(0);
+        // indices stay relative to this mesh's vertices, the draw adds the base vertex
+        geometry = MeshHeap().Add(vertexData, vertexCount, indexData, indexCount);
     }
 };
 
@@ -0,0 +1,461 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <lib/mesh.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// import time mesh optimization, CPU only (runs on the workers next to the aiMesh conversion)
+// 1. weld bitwise identical vertices     2. drop degenerate triangles
+// 3. Tipsify (Sander et al. 2007) for the post transform cache     4. cluster + sort for less overdraw (same paper)
+// 5. vertices renumbered in first use order, so fetches walk the vertex buffer forward
+#define MESH_VERTEX_CACHE_SIZE 16   // FIFO entries Tipsify targets and ACMR is measured with
+#define MESH_OVERDRAW_THRESHOLD 1.05f // how much worse than the best ACMR a cluster may get for the sake of overdraw
+#define MESH_OVERDRAW_GRID 256      // resolution of the overdraw analysis
+
+// before / after numbers of one mesh
+struct MeshOptimizeStats
+{
+    unsigned int verticesBefore = 0, verticesAfter = 0;
+    unsigned int trianglesBefore = 0, trianglesAfter = 0;
+    float acmrBefore = 0.0f, acmrAfter = 0.0f;         // transformed vertices per triangle, 0.5 is ideal, 3 is no reuse
+    float overdrawBefore = 0.0f, overdrawAfter = 0.0f; // shaded / covered pixels, 1 is no overdraw
+
+    void Print(const std::string &label) const
+    {
+        std::cout << label << ": vertices " << verticesBefore << " -> " << verticesAfter
+                  << " | triangles " << trianglesBefore << " -> " << trianglesAfter
+                  << " | ACMR " << acmrBefore << " -> " << acmrAfter
+                  << " | overdraw " << overdrawBefore << " -> " << overdrawAfter << std::endl;
+    }
+};
+
+// -------------------------------------------------------------------------------------------------------------------------
+
+// average cache misses per triangle for a FIFO cache of cacheSize vertices
+inline float AnalyzeVertexCache(const std::vector<unsigned int> &indices, unsigned int vertexCount, unsigned int cacheSize = MESH_VERTEX_CACHE_SIZE)
+{
+    if (indices.size() < 3)
+        return 0.0f;
+
+    // a vertex is in the cache while fewer than cacheSize misses happened since it was loaded
+    std::vector<unsigned int> loadedAt(vertexCount, 0);
+    unsigned int misses = 0;
+
+    for (unsigned int index : indices)
+    {
+        if (loadedAt[index] == 0 || misses - (loadedAt[index] - 1) >= cacheSize)
+        {
+            misses++;
+            loadedAt[index] = misses; // 1 based, 0 = never loaded
+        }
+    }
+
+    return (float)misses / (indices.size() / 3);
+}
+
+// orthographic views from the 6 axis directions, back faces culled, depth tested; shaded / covered pixels
+inline float AnalyzeOverdraw(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, int grid = MESH_OVERDRAW_GRID)
+{
+    if (vertices.empty() || indices.size() < 3)
+        return 0.0f;
+
+    glm::vec3 boundsMin = vertices[0].Position, boundsMax = vertices[0].Position;
+    for (const Vertex &vertex : vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex.Position);
+        boundsMax = glm::max(boundsMax, vertex.Position);
+    }
+    float extent = std::max(std::max(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y), std::max(boundsMax.z - boundsMin.z, 1e-6f));
+
+    std::vector<float> depth((size_t)grid * grid);
+    std::vector<glm::vec3> projected(vertices.size());
+    size_t shaded = 0, covered = 0;
+
+    for (int view = 0; view < 6; view++)
+    {
+        // screen x, screen y, depth (smaller is closer) in [0, 1], every view right handed so front faces stay counter clockwise
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            glm::vec3 p = (vertices[i].Position - boundsMin) / extent;
+            switch (view)
+            {
+            case 0: projected[i] = glm::vec3(p.x, p.y, 1.0f - p.z); break; // from +z
+            case 1: projected[i] = glm::vec3(1.0f - p.x, p.y, p.z); break; // from -z
+            case 2: projected[i] = glm::vec3(1.0f - p.z, p.y, 1.0f - p.x); break; // from +x
+            case 3: projected[i] = glm::vec3(p.z, p.y, p.x); break;        // from -x
+            case 4: projected[i] = glm::vec3(p.x, 1.0f - p.z, 1.0f - p.y); break; // from +y
+            default: projected[i] = glm::vec3(p.x, p.z, p.y); break;      // from -y
+            }
+            projected[i].x *= grid - 1;
+            projected[i].y *= grid - 1;
+        }
+
+        std::fill(depth.begin(), depth.end(), 2.0f);
+
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            glm::vec3 a = projected[indices[t]], b = projected[indices[t + 1]], c = projected[indices[t + 2]];
+
+            float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+            if (area <= 0.0f)
+                continue;
+
+            int minX = std::max(0, (int)std::floor(std::min({a.x, b.x, c.x})));
+            int maxX = std::min(grid - 1, (int)std::ceil(std::max({a.x, b.x, c.x})));
+            int minY = std::max(0, (int)std::floor(std::min({a.y, b.y, c.y})));
+            int maxY = std::min(grid - 1, (int)std::ceil(std::max({a.y, b.y, c.y})));
+
+            for (int y = minY; y <= maxY; y++)
+                for (int x = minX; x <= maxX; x++)
+                {
+                    // pixel centers, barycentrics from the edge functions
+                    float px = x + 0.5f, py = y + 0.5f;
+                    float w0 = (c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x);
+                    float w1 = (a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x);
+                    float w2 = (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+                    if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                        continue;
+
+                    float z = (w0 * a.z + w1 * b.z + w2 * c.z) / area;
+                    float &stored = depth[(size_t)y * grid + x];
+                    if (z < stored)
+                    {
+                        stored = z;
+                        shaded++;
+                    }
+                }
+        }
+
+        for (float z : depth)
+            covered += z <= 1.0f;
+    }
+
+    return covered ? (float)shaded / covered : 0.0f;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------
+
+// merges vertices with identical bytes, indices are remapped
+inline void WeldVertices(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+    struct VertexHash
+    {
+        const std::vector<Vertex> *vertices;
+        size_t operator()(unsigned int index) const
+        {
+            // FNV-1a over the vertex bytes
+            const unsigned char *bytes = (const unsigned char *)&(*vertices)[index];
+            size_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(Vertex); i++)
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            return hash;
+        }
+    };
+    struct VertexEqual
+    {
+        const std::vector<Vertex> *vertices;
+        bool operator()(unsigned int a, unsigned int b) const
+        {
+            return memcmp(&(*vertices)[a], &(*vertices)[b], sizeof(Vertex)) == 0;
+        }
+    };
+
+    std::unordered_map<unsigned int, unsigned int, VertexHash, VertexEqual> unique(vertices.size(), VertexHash{&vertices}, VertexEqual{&vertices});
+    std::vector<unsigned int> remap(vertices.size());
+    std::vector<Vertex> welded;
+    welded.reserve(vertices.size());
+
+    for (unsigned int i = 0; i < vertices.size(); i++)
+    {
+        auto inserted = unique.emplace(i, (unsigned int)welded.size());
+        if (inserted.second)
+            welded.push_back(vertices[i]);
+        remap[i] = inserted.first->second;
+    }
+
+    for (unsigned int &index : indices)
+        index = remap[index];
+    vertices.swap(welded);
+}
+
+// triangles that repeat a vertex or have no area
+inline void RemoveDegenerateTriangles(const std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+    size_t kept = 0;
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        unsigned int a = indices[t], b = indices[t + 1], c = indices[t + 2];
+        if (a == b || b == c || a == c)
+            continue;
+
+        glm::vec3 normal = glm::cross(vertices[b].Position - vertices[a].Position, vertices[c].Position - vertices[a].Position);
+        if (glm::dot(normal, normal) == 0.0f)
+            continue;
+
+        indices[kept++] = a;
+        indices[kept++] = b;
+        indices[kept++] = c;
+    }
+    indices.resize(kept);
+}
+
+// Tipsify: fans around one vertex at a time, the next fan center is a recently used vertex that is likely still cached
+inline void OptimizeVertexCache(std::vector<unsigned int> &indices, unsigned int vertexCount, unsigned int cacheSize = MESH_VERTEX_CACHE_SIZE)
+{
+    unsigned int triangleCount = (unsigned int)indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // vertex -> triangles, as offsets into one array
+    std::vector<unsigned int> live(vertexCount, 0), firstTriangle(vertexCount + 1, 0), triangles(indices.size());
+    for (unsigned int index : indices)
+        live[index]++;
+    for (unsigned int v = 0; v < vertexCount; v++)
+        firstTriangle[v + 1] = firstTriangle[v] + live[v];
+    std::vector<unsigned int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (unsigned int i = 0; i < indices.size(); i++)
+        triangles[fill[indices[i]]++] = i / 3;
+
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> deadEnd, candidates, result;
+    result.reserve(indices.size());
+
+    unsigned int time = cacheSize + 1; // everything starts out of the cache
+    unsigned int cursor = 0;           // next vertex to try when the dead end stack runs dry
+
+    auto skipDeadEnd = [&]() -> long long
+    {
+        while (!deadEnd.empty())
+        {
+            unsigned int vertex = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[vertex] > 0)
+                return vertex;
+        }
+        while (cursor < vertexCount)
+        {
+            if (live[cursor] > 0)
+                return cursor;
+            cursor++;
+        }
+        return -1;
+    };
+
+    long long fan = skipDeadEnd();
+    while (fan >= 0)
+    {
+        candidates.clear();
+
+        for (unsigned int i = firstTriangle[fan]; i < firstTriangle[fan + 1]; i++)
+        {
+            unsigned int triangle = triangles[i];
+            if (emitted[triangle])
+                continue;
+
+            for (int corner = 0; corner < 3; corner++)
+            {
+                unsigned int vertex = indices[triangle * 3 + corner];
+                result.push_back(vertex);
+                deadEnd.push_back(vertex);
+                candidates.push_back(vertex);
+                live[vertex]--;
+
+                if (time - cacheTime[vertex] > cacheSize)
+                    cacheTime[vertex] = time++;
+            }
+            emitted[triangle] = true;
+        }
+
+        // the candidate that stays in the cache for its remaining triangles and was loaded longest ago
+        long long next = -1;
+        int best = -1;
+        for (unsigned int vertex : candidates)
+        {
+            if (live[vertex] == 0)
+                continue;
+
+            int priority = 0;
+            if (time - cacheTime[vertex] + 2 * live[vertex] <= cacheSize)
+                priority = (int)(time - cacheTime[vertex]);
+
+            if (priority > best)
+            {
+                best = priority;
+                next = vertex;
+            }
+        }
+
+        fan = next >= 0 ? next : skipDeadEnd();
+    }
+
+    indices.swap(result);
+}
+
+// splits the cache ordered triangles into clusters where the cache allows it, outward facing clusters go first
+// so they fill the depth buffer before whatever they hide (Sander et al. 2007, as in meshoptimizer)
+inline void OptimizeOverdraw(const std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, float threshold = MESH_OVERDRAW_THRESHOLD,
+                             unsigned int cacheSize = MESH_VERTEX_CACHE_SIZE)
+{
+    unsigned int triangleCount = (unsigned int)indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    // FIFO simulation, misses of one triangle
+    std::vector<unsigned int> loadedAt(vertices.size(), 0);
+    unsigned int misses = 0;
+    auto triangleMisses = [&](unsigned int triangle)
+    {
+        unsigned int before = misses;
+        for (int corner = 0; corner < 3; corner++)
+        {
+            unsigned int index = indices[triangle * 3 + corner];
+            if (loadedAt[index] == 0 || misses - (loadedAt[index] - 1) >= cacheSize)
+                loadedAt[index] = ++misses;
+        }
+        return misses - before;
+    };
+    auto flushCache = [&]()
+    {
+        misses += cacheSize; // everything loaded so far falls out
+    };
+
+    // hard boundaries: triangles that miss on all 3 vertices, the cache was flushed there anyway
+    std::vector<unsigned int> hard;
+    for (unsigned int t = 0; t < triangleCount; t++)
+        if (triangleMisses(t) == 3)
+            hard.push_back(t);
+    hard.push_back(triangleCount);
+
+    // soft boundaries inside each: split as soon as the running ACMR is within threshold of the whole hard cluster's
+    std::vector<unsigned int> clusters;
+    for (size_t h = 0; h + 1 < hard.size(); h++)
+    {
+        unsigned int start = hard[h], end = hard[h + 1];
+
+        flushCache();
+        unsigned int clusterMisses = 0;
+        for (unsigned int t = start; t < end; t++)
+            clusterMisses += triangleMisses(t);
+        float limit = threshold * clusterMisses / (end - start);
+
+        flushCache();
+        unsigned int runningMisses = 0, runningTriangles = 0;
+        clusters.push_back(start);
+        for (unsigned int t = start; t < end; t++)
+        {
+            runningMisses += triangleMisses(t);
+            runningTriangles++;
+
+            if (t + 1 < end && (float)runningMisses / runningTriangles <= limit)
+            {
+                clusters.push_back(t + 1);
+                flushCache();
+                runningMisses = runningTriangles = 0;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // cluster sort key: how far its center sits out along its own normal, seen from the mesh's center
+    glm::vec3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+    std::vector<glm::vec3> centers(clusters.size() - 1, glm::vec3(0.0f)), normals(clusters.size() - 1, glm::vec3(0.0f));
+    std::vector<float> areas(clusters.size() - 1, 0.0f);
+
+    for (size_t c = 0; c + 1 < clusters.size(); c++)
+        for (unsigned int t = clusters[c]; t < clusters[c + 1]; t++)
+        {
+            glm::vec3 a = vertices[indices[t * 3]].Position, b = vertices[indices[t * 3 + 1]].Position, d = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 normal = glm::cross(b - a, d - a); // length = 2 x area
+            float area = glm::length(normal);
+
+            centers[c] += (a + b + d) * (area / 3.0f);
+            normals[c] += normal;
+            areas[c] += area;
+        }
+
+    for (size_t c = 0; c < centers.size(); c++)
+    {
+        meshCenter += centers[c];
+        meshArea += areas[c];
+        if (areas[c] > 0.0f)
+            centers[c] /= areas[c];
+    }
+    if (meshArea > 0.0f)
+        meshCenter /= meshArea;
+
+    std::vector<float> keys(centers.size());
+    std::vector<unsigned int> order(centers.size());
+    for (size_t c = 0; c < centers.size(); c++)
+    {
+        float length = glm::length(normals[c]);
+        keys[c] = length > 0.0f ? glm::dot(centers[c] - meshCenter, normals[c] / length) : 0.0f;
+        order[c] = (unsigned int)c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b)
+                     { return keys[a] > keys[b]; });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (unsigned int c : order)
+        result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+    indices.swap(result);
+}
+
+// renumbers vertices in the order the indices first use them, unused vertices are dropped
+inline void OptimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), unused);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+
+    for (unsigned int &index : indices)
+    {
+        if (remap[index] == unused)
+        {
+            remap[index] = (unsigned int)ordered.size();
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices.swap(ordered);
+}
+
+// the whole stage, stats (if given) get the before / after analysis
+inline void OptimizeMesh(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, MeshOptimizeStats *stats = NULL)
+{
+    if (stats)
+    {
+        stats->verticesBefore = (unsigned int)vertices.size();
+        stats->trianglesBefore = (unsigned int)indices.size() / 3;
+        stats->acmrBefore = AnalyzeVertexCache(indices, (unsigned int)vertices.size());
+        stats->overdrawBefore = AnalyzeOverdraw(vertices, indices);
+    }
+
+    WeldVertices(vertices, indices);
+    RemoveDegenerateTriangles(vertices, indices);
+    OptimizeVertexCache(indices, (unsigned int)vertices.size());
+    OptimizeOverdraw(vertices, indices);
+    OptimizeVertexFetch(vertices, indices);
+
+    if (stats)
+    {
+        stats->verticesAfter = (unsigned int)vertices.size();
+        stats->trianglesAfter = (unsigned int)indices.size() / 3;
+        stats->acmrAfter = AnalyzeVertexCache(indices, (unsigned int)vertices.size());
+        stats->overdrawAfter = AnalyzeOverdraw(vertices, indices);
+    }
+}
+
+#endif
@@ -0,0 +1,424 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <glm/glm.hpp>
+
+#include <lib/constants.h>
+#include <lib/mesh.h>
+#include <lib/mesh_optimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// import time LOD chain: quadric error metric edge collapses (Garland & Heckbert 1997), half edge variant
+// a vertex only ever collapses onto a neighbour that exists already, so every LOD indexes the LOD 0 vertices as they are
+// (no new vertices, normals and uvs stay exact) and the whole chain lives in one index allocation
+// vertices sharing a position (uv seams, hard normal edges) only move along their seam and together, open borders only along the border
+#define MESH_LOD_RATIO 0.5f         // triangles of a LOD relative to the one before
+#define MESH_LOD_MIN_TRIANGLES 64   // LODs stop once there are fewer triangles than this
+#define MESH_LOD_MIN_REDUCTION 0.9f // ... or once a LOD keeps more than this of the one before (the error limit got in the way)
+#define MESH_LOD_MAX_ERROR 0.02f    // how far the coarsest LOD may stray from LOD 0, relative to the mesh's extent
+#define MESH_LOD_BORDER_WEIGHT 10.0f // seam / border edge planes against face planes, keeps outlines (and uv islands) in shape
+#define MESH_LOD_FLIP_COS 0.25f     // triangles around a collapse may turn by ~75 degrees at most, no flipped faces
+
+// plane distances squared, summed up with weights (area for faces): error = weighted mean squared distance
+struct Quadric
+{
+    double a2 = 0.0, b2 = 0.0, c2 = 0.0, d2 = 0.0;
+    double ab = 0.0, ac = 0.0, ad = 0.0, bc = 0.0, bd = 0.0, cd = 0.0;
+    double weight = 0.0;
+
+    // plane dot(n, p) + d = 0, n unit length
+    static Quadric FromPlane(glm::dvec3 n, double d, double weight)
+    {
+        Quadric q;
+        q.a2 = n.x * n.x * weight;
+        q.b2 = n.y * n.y * weight;
+        q.c2 = n.z * n.z * weight;
+        q.d2 = d * d * weight;
+        q.ab = n.x * n.y * weight;
+        q.ac = n.x * n.z * weight;
+        q.ad = n.x * d * weight;
+        q.bc = n.y * n.z * weight;
+        q.bd = n.y * d * weight;
+        q.cd = n.z * d * weight;
+        q.weight = weight;
+        return q;
+    }
+
+    Quadric &operator+=(const Quadric &o)
+    {
+        a2 += o.a2, b2 += o.b2, c2 += o.c2, d2 += o.d2;
+        ab += o.ab, ac += o.ac, ad += o.ad, bc += o.bc, bd += o.bd, cd += o.cd;
+        weight += o.weight;
+        return *this;
+    }
+
+    double Error(glm::vec3 p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double e = a2 * x * x + b2 * y * y + c2 * z * z + 2.0 * (ab * x * y + ac * x * z + bc * y * z) +
+                   2.0 * (ad * x + bd * y + cd * z) + d2;
+        return weight > 0.0 ? std::max(e, 0.0) / weight : 0.0;
+    }
+};
+
+// -------------------------------------------------------------------------------------------------------------------------
+
+// collapses edges until indices are down to targetIndexCount or the cheapest collapse left would move the surface more than maxError
+// vertices are only read, indices shrink; returns the largest error it accepted (model units)
+inline float SimplifyMesh(const std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, size_t targetIndexCount, float maxError)
+{
+    enum
+    {
+        KIND_MANIFOLD, // inside a closed surface, goes anywhere
+        KIND_BORDER,   // on an open edge, only along it
+        KIND_SEAM,     // one of two vertices at a position (uv / normal seam), only along the seam, the other one follows
+        KIND_LOCKED    // corners, seams meeting borders, non manifold edges
+    };
+
+    unsigned int vertexCount = (unsigned int)vertices.size();
+    if (vertexCount == 0 || indices.size() <= targetIndexCount)
+        return 0.0f;
+
+    // position groups: group = first vertex at the same position, wedge = the next one at it (a ring)
+    std::vector<unsigned int> group(vertexCount), wedge(vertexCount), groupSize(vertexCount, 0);
+    {
+        struct PositionHash
+        {
+            size_t operator()(const glm::vec3 &p) const
+            {
+                uint32_t bits[3];
+                memcpy(bits, &p, sizeof(bits));
+                return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+            }
+        };
+
+        std::unordered_map<glm::vec3, unsigned int, PositionHash> first(vertexCount);
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            glm::vec3 position = vertices[v].Position + 0.0f; // -0 -> +0, same hash for equal positions
+            unsigned int g = group[v] = first.emplace(position, v).first->second;
+
+            wedge[v] = v;
+            if (g != v)
+            {
+                wedge[v] = wedge[g];
+                wedge[g] = v;
+            }
+            groupSize[g]++;
+        }
+    }
+
+    // vertex -> triangles of the current indices (offsets into one array), rebuilt every pass; edges are looked up through it
+    std::vector<unsigned int> firstTriangle(vertexCount + 1), triangles, fill;
+    std::vector<unsigned char> kind(vertexCount), groupBorder(vertexCount), groupLocked(vertexCount), seam(vertexCount);
+
+    // triangles with the directed edge a -> b
+    auto indexEdge = [&](unsigned int a, unsigned int b)
+    {
+        unsigned int count = 0;
+        for (unsigned int i = firstTriangle[a]; i < firstTriangle[a + 1]; i++)
+        {
+            const unsigned int *corner = &indices[triangles[i] * 3];
+            count += (corner[0] == a && corner[1] == b) || (corner[1] == a && corner[2] == b) || (corner[2] == a && corner[0] == b);
+        }
+        return count;
+    };
+
+    // triangles with a directed edge from any vertex at position group ga to one at gb
+    auto groupEdge = [&](unsigned int ga, unsigned int gb)
+    {
+        unsigned int count = 0, a = ga;
+        do
+        {
+            for (unsigned int i = firstTriangle[a]; i < firstTriangle[a + 1]; i++)
+            {
+                const unsigned int *corner = &indices[triangles[i] * 3];
+                int k = corner[0] == a ? 0 : (corner[1] == a ? 1 : 2);
+                count += group[corner[(k + 1) % 3]] == gb;
+            }
+            a = wedge[a];
+        } while (a != ga);
+        return count;
+    };
+
+    auto buildTopology = [&]()
+    {
+        std::fill(firstTriangle.begin(), firstTriangle.end(), 0);
+        for (unsigned int index : indices)
+            firstTriangle[index + 1]++;
+        for (unsigned int v = 0; v < vertexCount; v++)
+            firstTriangle[v + 1] += firstTriangle[v];
+        triangles.resize(indices.size());
+        fill.assign(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (unsigned int i = 0; i < indices.size(); i++)
+            triangles[fill[indices[i]]++] = i / 3;
+
+        std::fill(groupBorder.begin(), groupBorder.end(), 0);
+        std::fill(groupLocked.begin(), groupLocked.end(), 0);
+        std::fill(seam.begin(), seam.end(), 0);
+        for (size_t t = 0; t < indices.size(); t += 3)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = indices[t + k], b = indices[t + (k + 1) % 3];
+                unsigned int ga = group[a], gb = group[b];
+
+                if (groupEdge(ga, gb) > 1)
+                    groupLocked[ga] = groupLocked[gb] = 1;
+
+                if (!groupEdge(gb, ga))
+                    groupBorder[ga] = groupBorder[gb] = 1;
+                else if (!indexEdge(b, a))
+                    seam[a] = seam[b] = 1;
+            }
+
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            unsigned int g = group[v];
+            if (groupLocked[g] || groupSize[g] > 2)
+                kind[v] = KIND_LOCKED;
+            else if (groupBorder[g])
+                kind[v] = groupSize[g] == 1 ? KIND_BORDER : KIND_LOCKED;
+            else if (groupSize[g] == 2)
+                kind[v] = seam[v] ? KIND_SEAM : KIND_LOCKED;
+            else
+                kind[v] = KIND_MANIFOLD;
+        }
+    };
+
+    buildTopology();
+
+    // quadrics per position group: face planes, + planes through open / seam edges standing on their face
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t t = 0; t < indices.size(); t += 3)
+    {
+        glm::dvec3 p[3] = {vertices[indices[t]].Position, vertices[indices[t + 1]].Position, vertices[indices[t + 2]].Position};
+        glm::dvec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+        double length = glm::length(normal);
+        if (length == 0.0)
+            continue;
+        normal /= length;
+
+        Quadric face = Quadric::FromPlane(normal, -glm::dot(normal, p[0]), length * 0.5);
+        for (int k = 0; k < 3; k++)
+            quadrics[group[indices[t + k]]] += face;
+
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int a = indices[t + k], b = indices[t + (k + 1) % 3];
+            if (indexEdge(b, a))
+                continue;
+
+            glm::dvec3 edge = p[(k + 1) % 3] - p[k];
+            double edgeLength = glm::length(edge);
+            if (edgeLength == 0.0)
+                continue;
+
+            glm::dvec3 side = glm::normalize(glm::cross(edge / edgeLength, normal));
+            Quadric border = Quadric::FromPlane(side, -glm::dot(side, p[k]), edgeLength * edgeLength * MESH_LOD_BORDER_WEIGHT);
+            quadrics[group[a]] += border;
+            quadrics[group[b]] += border;
+        }
+    }
+
+    auto hasIndexEdge = [&](unsigned int a, unsigned int b)
+    {
+        return indexEdge(a, b) || indexEdge(b, a);
+    };
+
+    // the vertex at to's position the seam partner of from goes to, -1 if from can't take its partner along
+    auto seamPartner = [&](unsigned int from, unsigned int to) -> long long
+    {
+        unsigned int partner = wedge[from];
+        for (unsigned int v = wedge[to]; v != to; v = wedge[v])
+            if (hasIndexEdge(partner, v))
+                return v;
+        return -1;
+    };
+
+    auto canCollapse = [&](unsigned int from, unsigned int to)
+    {
+        unsigned int gf = group[from], gt = group[to];
+        switch (kind[from])
+        {
+        case KIND_MANIFOLD:
+            return true;
+        case KIND_BORDER:
+            return (groupEdge(gf, gt) != 0) != (groupEdge(gt, gf) != 0);
+        case KIND_SEAM:
+            return groupEdge(gf, gt) && groupEdge(gt, gf) && (indexEdge(from, to) != 0) != (indexEdge(to, from) != 0) && seamPartner(from, to) >= 0;
+        default:
+            return false;
+        }
+    };
+
+    // would a triangle around from (that survives) turn too far with from moved to to's position
+    auto flips = [&](unsigned int from, unsigned int to)
+    {
+        glm::vec3 target = vertices[to].Position;
+        for (unsigned int i = firstTriangle[from]; i < firstTriangle[from + 1]; i++)
+        {
+            const unsigned int *corner = &indices[triangles[i] * 3];
+            if (corner[0] == to || corner[1] == to || corner[2] == to)
+                continue;
+
+            glm::vec3 p[3], q[3];
+            for (int k = 0; k < 3; k++)
+            {
+                p[k] = vertices[corner[k]].Position;
+                q[k] = corner[k] == from ? target : p[k];
+            }
+
+            glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+            if (glm::dot(before, after) < MESH_LOD_FLIP_COS * glm::length(before) * glm::length(after))
+                return true;
+        }
+        return false;
+    };
+
+    // triangles around from that also use to, the collapse removes them
+    auto sharedTriangles = [&](unsigned int from, unsigned int to)
+    {
+        unsigned int shared = 0;
+        for (unsigned int i = firstTriangle[from]; i < firstTriangle[from + 1]; i++)
+        {
+            const unsigned int *corner = &indices[triangles[i] * 3];
+            shared += corner[0] == to || corner[1] == to || corner[2] == to;
+        }
+        return shared;
+    };
+
+    struct Collapse
+    {
+        unsigned int from, to;
+        double cost;
+    };
+    std::vector<Collapse> candidates;
+    std::vector<unsigned int> remap(vertexCount);
+    std::vector<unsigned char> touched(vertexCount);
+
+    double maxCost = (double)maxError * maxError, acceptedCost = 0.0;
+    size_t targetTriangles = targetIndexCount / 3;
+
+    // passes: cheapest collapses first, a collapse locks everything around it (its flip check stays valid) until the next pass
+    while (indices.size() > targetIndexCount)
+    {
+        candidates.clear();
+        for (size_t t = 0; t < indices.size(); t += 3)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = indices[t + k], b = indices[t + (k + 1) % 3];
+                if (a > b && indexEdge(b, a))
+                    continue; // the other triangle on this edge adds it
+
+                for (int direction = 0; direction < 2; direction++)
+                {
+                    unsigned int from = direction ? b : a, to = direction ? a : b;
+                    if (!canCollapse(from, to))
+                        continue;
+
+                    Quadric merged = quadrics[group[from]];
+                    merged += quadrics[group[to]];
+                    candidates.push_back(Collapse{from, to, merged.Error(vertices[to].Position)});
+                }
+            }
+
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse &a, const Collapse &b)
+                  { return a.cost < b.cost; });
+
+        for (unsigned int v = 0; v < vertexCount; v++)
+            remap[v] = v;
+        std::fill(touched.begin(), touched.end(), 0);
+
+        size_t trianglesLeft = indices.size() / 3;
+        unsigned int collapses = 0;
+
+        for (const Collapse &collapse : candidates)
+        {
+            if (trianglesLeft <= targetTriangles || collapse.cost > maxCost)
+                break;
+
+            unsigned int from = collapse.from, to = collapse.to;
+            if (touched[group[from]] || touched[group[to]])
+                continue;
+
+            long long partnerTo = kind[from] == KIND_SEAM ? seamPartner(from, to) : -1;
+            unsigned int partner = wedge[from];
+            if (flips(from, to) || (partnerTo >= 0 && flips(partner, (unsigned int)partnerTo)))
+                continue;
+
+            remap[from] = to;
+            trianglesLeft -= sharedTriangles(from, to);
+            if (partnerTo >= 0)
+            {
+                remap[partner] = (unsigned int)partnerTo;
+                trianglesLeft -= sharedTriangles(partner, (unsigned int)partnerTo);
+            }
+
+            quadrics[group[to]] += quadrics[group[from]];
+            acceptedCost = std::max(acceptedCost, collapse.cost);
+            collapses++;
+
+            // the one ring (of both wedges) stays put for the rest of the pass
+            for (unsigned int moved : {from, partner})
+                for (unsigned int i = firstTriangle[moved]; i < firstTriangle[moved + 1]; i++)
+                    for (int k = 0; k < 3; k++)
+                        touched[group[indices[triangles[i] * 3 + k]]] = 1;
+        }
+
+        if (collapses == 0)
+            break;
+
+        for (unsigned int &index : indices)
+            index = remap[index];
+        RemoveDegenerateTriangles(vertices, indices);
+
+        buildTopology();
+    }
+
+    return (float)std::sqrt(acceptedCost);
+}
+
+// appends LODs to indices (LOD 0, as they come in), each about MESH_LOD_RATIO of the one before and cache optimized,
+// lods gets every LOD's range and error; up to MESH_MAX_LODS, fewer when the mesh is small or won't simplify within MESH_LOD_MAX_ERROR
+inline void GenerateLods(const std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, std::vector<MeshLod> &lods)
+{
+    lods.assign(1, MeshLod{0, (unsigned int)indices.size(), 0.0f});
+    if (vertices.empty())
+        return;
+
+    glm::vec3 boundsMin = vertices[0].Position, boundsMax = vertices[0].Position;
+    for (const Vertex &vertex : vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex.Position);
+        boundsMax = glm::max(boundsMax, vertex.Position);
+    }
+    float maxError = MESH_LOD_MAX_ERROR * glm::length(boundsMax - boundsMin);
+
+    // each LOD simplifies the one before, errors add up
+    std::vector<unsigned int> level(indices), next;
+    float error = 0.0f;
+
+    while (lods.size() < MESH_MAX_LODS && level.size() / 3 * MESH_LOD_RATIO >= MESH_LOD_MIN_TRIANGLES)
+    {
+        next = level;
+        float stepError = SimplifyMesh(vertices, next, (size_t)(level.size() / 3 * MESH_LOD_RATIO) * 3, maxError - error);
+        if (next.size() > level.size() * MESH_LOD_MIN_REDUCTION)
+            break;
+
+        error += stepError;
+        OptimizeVertexCache(next, (unsigned int)vertices.size());
+
+        lods.push_back(MeshLod{(unsigned int)indices.size(), (unsigned int)next.size(), error});
+        indices.insert(indices.end(), next.begin(), next.end());
+        level.swap(next);
+    }
+}
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// meshlets: small runs of a LOD's triangles with their own bounds, culled on the CPU before the draw
+// built by scanning the indices in order (they are cache optimized already, so a run stays local), a meshlet is a range of them
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// plain data, the model cache stores it as it is
+struct Meshlet
+{
+    unsigned int firstIndex, indexCount; // like MeshLod, from the mesh's first index
+    glm::vec3 center;                    // bounding sphere, model space
+    float radius;
+    glm::vec3 coneAxis;                  // every triangle normal lies within the cone's angle around the axis
+    float coneCos, coneSin;              // cos / sin of that angle, coneCos <= 0: the normals spread too far to cull anything
+
+    // every triangle faces away from camera (model space), for any point inside the bounding sphere
+    // the normal closest to the view direction is angle(view, axis) + cone angle away from it, that has to stay below 90 degrees with margin
+    bool BackFacing(glm::vec3 camera) const
+    {
+        if (coneCos <= 0.0f)
+            return false;
+
+        glm::vec3 view = center - camera;
+        float distance = glm::length(view);
+        if (distance <= radius)
+            return false;
+
+        float viewCos = glm::dot(view, coneAxis) / distance;
+        float viewSin = std::sqrt(std::max(1.0f - viewCos * viewCos, 0.0f));
+        return viewCos * coneCos - viewSin * coneSin > radius / distance;
+    }
+};
+
+// -------------------------------------------------------------------------------------------------------------------------
+
+// bounds + normal cone of the triangles indices[first, first + count)
+template <typename V>
+inline Meshlet MakeMeshlet(const std::vector<V> &vertices, const std::vector<unsigned int> &indices, unsigned int first, unsigned int count)
+{
+    Meshlet meshlet;
+    meshlet.firstIndex = first;
+    meshlet.indexCount = count;
+
+    glm::vec3 boundsMin = vertices[indices[first]].Position, boundsMax = boundsMin;
+    for (unsigned int i = first; i < first + count; i++)
+    {
+        boundsMin = glm::min(boundsMin, vertices[indices[i]].Position);
+        boundsMax = glm::max(boundsMax, vertices[indices[i]].Position);
+    }
+    meshlet.center = (boundsMin + boundsMax) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (unsigned int i = first; i < first + count; i++)
+        meshlet.radius = std::max(meshlet.radius, glm::length(vertices[indices[i]].Position - meshlet.center));
+
+    // axis: average of the unit normals, angle: the one furthest from it
+    std::vector<glm::vec3> normals;
+    normals.reserve(count / 3);
+    glm::vec3 axis(0.0f);
+    for (unsigned int t = first; t < first + count; t += 3)
+    {
+        glm::vec3 a = vertices[indices[t]].Position, b = vertices[indices[t + 1]].Position, c = vertices[indices[t + 2]].Position;
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        if (length == 0.0f)
+            continue;
+
+        normals.push_back(normal / length);
+        axis += normals.back();
+    }
+
+    float axisLength = glm::length(axis);
+    meshlet.coneAxis = axisLength > 0.0f ? axis / axisLength : glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCos = axisLength > 0.0f ? 1.0f : 0.0f;
+    for (const glm::vec3 &normal : normals)
+        meshlet.coneCos = std::min(meshlet.coneCos, glm::dot(normal, meshlet.coneAxis));
+    meshlet.coneSin = std::sqrt(std::max(1.0f - meshlet.coneCos * meshlet.coneCos, 0.0f));
+
+    return meshlet;
+}
+
+// splits the triangles indices[first, first + count) into meshlets of at most MESHLET_MAX_VERTICES / MESHLET_MAX_TRIANGLES, appended to meshlets
+template <typename V>
+inline void BuildMeshlets(const std::vector<V> &vertices, const std::vector<unsigned int> &indices, unsigned int first, unsigned int count,
+                          std::vector<Meshlet> &meshlets)
+{
+    std::vector<unsigned int> seen(vertices.size(), ~0u); // meshlet number that last used the vertex
+    unsigned int current = 0, start = first, uniqueVertices = 0;
+
+    for (unsigned int t = first; t + 2 < first + count; t += 3)
+    {
+        unsigned int fresh = 0;
+        for (int k = 0; k < 3; k++)
+            fresh += seen[indices[t + k]] != current;
+
+        if (uniqueVertices + fresh > MESHLET_MAX_VERTICES || (t - start) / 3 >= MESHLET_MAX_TRIANGLES)
+        {
+            meshlets.push_back(MakeMeshlet(vertices, indices, start, t - start));
+            current++;
+            start = t;
+            uniqueVertices = 0;
+        }
+
+        for (int k = 0; k < 3; k++)
+            if (seen[indices[t + k]] != current)
+            {
+                seen[indices[t + k]] = current;
+                uniqueVertices++;
+            }
+    }
+
+    if (start < first + count)
+        meshlets.push_back(MakeMeshlet(vertices, indices, start, first + count - start));
+}
+
+#endif
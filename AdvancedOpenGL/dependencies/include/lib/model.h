@@ -4,22 +4,48 @@
 #include <glad/glad.h>
 
 #include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
 #include <lib/constants.h>
-#include <lib/stb_image.h>
+#include <lib/alloc_stats.h>
+#include <lib/frame_data.h>
+#include <lib/frustum.h>
+#include <lib/culling.h>
+#include <lib/instancing.h>
+#include <lib/occlusion.h>
+#include <lib/texture_cache.h>
 #include <lib/shader_s.h>
+#include <lib/shader_permutations.h>
 #include <lib/mesh.h>
+#include <lib/mesh_optimizer.h>
+#include <lib/mesh_simplify.h>
+#include <lib/meshlet.h>
+#include <lib/model_cache.h>
 #include <lib/outline.h>
+#include <lib/render_queue.h>
+#include <lib/transform.h>
+#include <lib/thread_pool.h>
 
+#include <cfloat>
+#include <chrono>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 using namespace std;
 
+// LOD + meshlet state of every mesh of a model at one place (MeshDrawState), a model drawn at several places
+// hands one of these per place to Draw / Submit so each place keeps its own LOD history
+struct ModelPlacement
+{
+    vector<MeshDrawState> meshes; // filled on first use
+};
+
 class Model
 {
 public:
@@ -32,17 +58,180 @@ public:
         loadModel(path);
     }
 
+    // meshes are move-only, so is the model
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+
+    // frees every mesh's buffers and releases its textures (other models may still share them), call it before the context goes away
+    void del()
+    {
+        for (Mesh &mesh : meshes)
+            mesh.del();
+
+        for (Texture &texture : textures_loaded)
+            Textures().Release(texture.id);
+        textures_loaded.clear();
+    }
+
     void Draw(Shader *shader)
     {
+        vector<MeshDrawState> &states = statesOf(NULL);
         for (unsigned int i = 0; i < meshes.size(); i++)
         {
             if (useOutline)
-                meshes[i].DrawWithOutline(shader, outline);
+                meshes[i].DrawWithOutline(shader, outline, states[i].visible);
             else
-                meshes[i].Draw(shader);
+                meshes[i].Draw(shader, states[i].visible);
+        }
+    }
+
+    // picks the cheapest variant per mesh: its own maps (if allowed) + the scene's light set
+    // neighbouring meshes with the same variant and textures go out as one multi draw from the mesh heap
+    // with frame, every mesh also picks its LOD for that camera and culls its meshlets (without, meshes keep what they had)
+    // and with occlusion (already rasterized for this frame), meshes behind its occluders are skipped too
+    // placement: this place's LOD / meshlet state, the model's own one without
+    void Draw(ShaderPermutations *variants, unsigned int allowedFeatures, Transform transform, const FrameData *frame = NULL,
+              const OcclusionBuffer *occlusion = NULL, ModelPlacement *placement = NULL)
+    {
+        static const UniformHandle modelHandle = Shader::Uniform("model");
+        static const UniformHandle normalMatHandle = Shader::Uniform("normalMat");
+
+        glm::mat4 modelMat = transform.GetModelMat();
+        glm::mat3 normalMat = transform.GetNormalMat();
+
+        vector<MeshDrawState> &states = statesOf(placement);
+        cullMeshes(modelMat, frame, occlusion, states);
+
+        Shader *bound = NULL;
+        int batchStart = -1; // first mesh of the batch, its textures are the bound ones
+        batch.clear();
+
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (!isDrawn(i, frame, states))
+                continue;
+
+            const vector<GeometryRange> &visible = states[i].visible;
+
+            Shader *shader = variants->Get(MatchFeatures(meshes[i].Features(), allowedFeatures));
+
+            if (!useOutline && shader == bound && batchStart >= 0 && meshes[i].CanBatchWith(meshes[batchStart]))
+            {
+                batch.insert(batch.end(), visible.begin(), visible.end());
+                continue;
+            }
+
+            flushBatch();
+            batchStart = -1;
+
+            if (shader != bound)
+            {
+                shader->use();
+                shader->set(modelHandle, modelMat);
+                shader->set(normalMatHandle, normalMat);
+                bound = shader;
+            }
+
+            if (useOutline)
+            {
+                // stencil state per mesh, no batching; the outline variant has to match the mesh's vertex format
+                Outline meshOutline = outline;
+                meshOutline.outlineShader = variants->Get(MatchFeatures(meshes[i].Features(), FEATURE_OUTLINE));
+                meshes[i].DrawWithOutline(shader, meshOutline, visible);
+            }
+            else
+            {
+                meshes[i].BindTextures(shader);
+                meshes[i].BindQuantization(shader);
+                batch.insert(batch.end(), visible.begin(), visible.end());
+                batchStart = i;
+            }
+        }
+
+        flushBatch();
+    }
+
+    // same culling, LOD and variant choice as Draw(), but every visible mesh (+ its outline) goes into queue as its own item
+    // the queue orders them by program and texture set, not by mesh order; frame is needed for the view depth
+    // the items point at placement's ranges (the model's own without), it has to outlive the queue's Execute()
+    void Submit(RenderQueue &queue, ShaderPermutations *variants, unsigned int allowedFeatures, Transform transform, const FrameData &frame,
+                const OcclusionBuffer *occlusion = NULL, ModelPlacement *placement = NULL)
+    {
+        glm::mat4 modelMat = transform.GetModelMat();
+        glm::mat3 normalMat = transform.GetNormalMat();
+
+        Transform outlineTransform = transform;
+        outlineTransform.scale += outline.outlineThickness;
+        glm::mat4 outlineMat = outlineTransform.GetModelMat();
+        glm::mat3 outlineNormalMat = outlineTransform.GetNormalMat();
+
+        vector<MeshDrawState> &states = statesOf(placement);
+        cullMeshes(modelMat, &frame, occlusion, states);
+
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (!isDrawn(i, &frame, states))
+                continue;
+
+            RenderItem item;
+            item.shader = variants->Get(MatchFeatures(meshes[i].Features(), allowedFeatures));
+            item.mesh = &meshes[i];
+            item.ranges = &states[i].visible;
+            item.model = modelMat;
+            item.normalMat = normalMat;
+            item.depth = -(frame.view * modelMat * glm::vec4((meshes[i].boundsMin + meshes[i].boundsMax) * 0.5f, 1.0f)).z;
+            queue.Submit(item);
+
+            if (useOutline)
+            {
+                item.pass = RENDER_PASS_OUTLINE;
+                item.shader = variants->Get(MatchFeatures(meshes[i].Features(), FEATURE_OUTLINE));
+                item.model = outlineMat;
+                item.normalMat = outlineNormalMat;
+                item.color = outline.outlineColor;
+                queue.Submit(item);
+            }
+        }
+    }
+
+    // the model once per instance: one instanced draw per mesh instead of one draw per mesh and instance
+    // same variant choice as Draw() + FEATURE_INSTANCED, no culling and no outline (the instances' bounds are up to the caller)
+    // every instance at lod: LOD 0 unless the caller picks one for the whole group (no per placement LOD, instances share one draw)
+    void DrawInstanced(ShaderPermutations *variants, unsigned int allowedFeatures, const InstanceBuffer &instances, unsigned int lod = 0)
+    {
+        if (instances.Count() == 0)
+            return;
+
+        Shader *bound = NULL;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            Shader *shader = variants->Get(MatchFeatures(meshes[i].Features(), allowedFeatures | FEATURE_INSTANCED));
+            if (shader != bound)
+            {
+                shader->use();
+                bound = shader;
+            }
+
+            meshes[i].DrawInstanced(shader, instances, lod);
         }
     }
 
+    // starts compiling every variant Draw() is going to ask for (outlines included, they can be switched on any time)
+    void PrepareVariants(ShaderPermutations *variants, unsigned int allowedFeatures)
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            variants->Prepare(MatchFeatures(meshes[i].Features(), allowedFeatures));
+            variants->Prepare(MatchFeatures(meshes[i].Features(), FEATURE_OUTLINE));
+        }
+    }
+
+    // this model's occluder triangles into buffer, placed by transform
+    void AddOccluders(OcclusionBuffer &buffer, Transform transform)
+    {
+        buffer.AddOccluder(occluderPositions, occluderIndices, transform.GetModelMat());
+    }
+
     // if second approach just have (bool, Outline)
     void IsOutlineEnabled(bool isEnabled, Outline outlineProperties)
     {
@@ -55,12 +244,152 @@ public:
 private:
     bool useOutline = false;
     Outline outline;
+    vector<GeometryRange> batch; // Draw scratch
+    BoundingBoxes meshBounds;    // every mesh's model space AABB, in mesh order
+    vector<unsigned char> meshVisible;
+    ModelPlacement placement; // what Draw / Submit use when the caller has no placement of its own
+    vector<glm::vec3> occluderPositions; // every mesh's occluder LOD, model space
+    vector<unsigned int> occluderIndices;
+
+    // placement's mesh states (the model's own one for NULL), set up the first time
+    vector<MeshDrawState> &statesOf(ModelPlacement *placement)
+    {
+        if (!placement)
+            placement = &this->placement;
+
+        if (placement->meshes.size() != meshes.size())
+        {
+            placement->meshes.clear();
+            for (const Mesh &mesh : meshes)
+                placement->meshes.push_back(mesh.InitialState());
+        }
+        return placement->meshes;
+    }
+
+    // with frame: frustum (+ occlusion) culls the meshes, the visible ones pick their LOD and cull their meshlets, all in model space
+    // without, meshes keep what they had
+    void cullMeshes(const glm::mat4 &modelMat, const FrameData *frame, const OcclusionBuffer *occlusion, vector<MeshDrawState> &states)
+    {
+        if (!frame)
+            return;
+
+        Frustum frustum = Frustum::FromMatrix(frame->projection * frame->view * modelMat);
+        glm::vec3 camera = glm::vec3(glm::inverse(modelMat) * glm::vec4(glm::vec3(frame->cameraPos), 1.0f));
+        CullBoxes(frustum, meshBounds, meshVisible);
+        if (occlusion)
+            occlusion->Cull(meshBounds, modelMat, meshVisible);
+
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (!meshVisible[i])
+                continue;
+
+            meshes[i].SelectLod(states[i], pixelsPerUnit(meshes[i], modelMat, *frame));
+            meshes[i].CullMeshlets(states[i], frustum, camera);
+        }
+    }
+
+    // after cullMeshes(): mesh i has something left to draw
+    bool isDrawn(unsigned int i, const FrameData *frame, const vector<MeshDrawState> &states) const
+    {
+        return (!frame || meshVisible[i]) && !states[i].visible.empty();
+    }
+
+    void buildBounds()
+    {
+        meshBounds.Clear();
+        for (const Mesh &mesh : meshes)
+            meshBounds.Push(mesh.boundsMin, mesh.boundsMax);
+        meshBounds.Pad();
+    }
+
+    // the mesh's coarsest LOD within OCCLUSION_LOD_ERROR of its surface, with only the vertices it uses; position(i) = vertex i's position
+    template <typename P>
+    void addOccluder(const Mesh &mesh, const unsigned int *indices, P position)
+    {
+        float maxError = OCCLUSION_LOD_ERROR * glm::length(mesh.boundsMax - mesh.boundsMin);
+        const MeshLod *lod = &mesh.lods[0];
+        for (const MeshLod &candidate : mesh.lods)
+            if (candidate.error <= maxError)
+                lod = &candidate;
+
+        unordered_map<unsigned int, unsigned int> remap;
+        for (unsigned int i = lod->firstIndex; i < lod->firstIndex + lod->indexCount; i++)
+        {
+            auto inserted = remap.emplace(indices[i], (unsigned int)occluderPositions.size());
+            if (inserted.second)
+                occluderPositions.push_back(position(indices[i]));
+            occluderIndices.push_back(inserted.first->second);
+        }
+    }
+
+    // screen pixels one model unit covers at the mesh's point closest to the camera (bounding sphere), what LOD errors get measured in
+    static float pixelsPerUnit(const Mesh &mesh, const glm::mat4 &modelMat, const FrameData &frame)
+    {
+        float scale = std::max(glm::length(glm::vec3(modelMat[0])), std::max(glm::length(glm::vec3(modelMat[1])), glm::length(glm::vec3(modelMat[2]))));
+        glm::vec3 center = glm::vec3(modelMat * glm::vec4((mesh.boundsMin + mesh.boundsMax) * 0.5f, 1.0f));
+        float radius = glm::length(mesh.boundsMax - mesh.boundsMin) * 0.5f * scale;
+        float distance = std::max(glm::length(center - glm::vec3(frame.cameraPos)) - radius, frame.clipPlanes.x);
+
+        // projection[1][1] = 1 / tan(fovy / 2): at distance d the viewport's height spans 2 d / projection[1][1] units
+        return scale * frame.viewport.y * 0.5f * frame.projection[1][1] / distance;
+    }
 
+    void flushBatch()
+    {
+        if (batch.empty())
+            return;
+
+        MeshHeap().Bind();
+        MeshHeap().MultiDraw(batch.data(), (int)batch.size());
+        batch.clear();
+
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // what a worker prepares for one mesh, GL only comes in afterwards
+    struct PendingMesh
+    {
+        vector<Vertex> vertices;
+        vector<unsigned int> indices;
+        vector<int> textures; // into the pending textures
+        vector<MeshLod> lods;
+        vector<Meshlet> meshlets;
+        MeshOptimizeStats stats;
+    };
+
+    // a texture file some mesh uses, listed once
+    struct PendingTexture
+    {
+        string path; // as the material has it, relative to directory
+        string type;
+    };
+
+    static float msSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // warm start: the binary cache (model_cache.h), cold start: assimp, which then writes the cache
+    // either way CPU work runs on the worker pool: mesh conversion here, image decode in the texture streamer
+    // textures show their placeholder until the streamer has uploaded them
     void loadModel(string const &path)
     {
+        auto start = std::chrono::steady_clock::now();
+        directory = path.substr(0, path.find_last_of('/'));
+
+        float importMs = 0.0f;
+        if (loadCache(path, importMs))
+        {
+            buildBounds();
+            cout << "loaded " << path << " from cache in " << msSince(start) << " ms (assimp import: " << importMs << " ms)" << endl;
+            return;
+        }
+
         Assimp::Importer importer;
 
-        const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+        const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenBoundingBoxes);
 
         if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
         {
@@ -68,168 +397,309 @@ private:
             return;
         }
 
-        directory = path.substr(0, path.find_last_of('/'));
+        float readMs = msSince(start);
+        auto convertStart = std::chrono::steady_clock::now();
+
+        // 1. this thread: mesh order (node walk) and every texture they use, once each
+        vector<aiMesh *> order;
+        collectMeshes(scene->mRootNode, scene, order);
+
+        vector<PendingMesh> pendingMeshes(order.size());
+        vector<PendingTexture> pendingTextures;
+        unordered_map<string, int> textureLookup;
+        vector<vector<int>> materialTextures(scene->mNumMaterials);
+        vector<bool> materialDone(scene->mNumMaterials, false);
+
+        for (unsigned int i = 0; i < order.size(); i++)
+        {
+            unsigned int materialIndex = order[i]->mMaterialIndex;
+            if (!materialDone[materialIndex])
+            {
+                aiMaterial *material = scene->mMaterials[materialIndex];
+
+                // 1. albedo maps
+                loadMaterialTextures(material, aiTextureType_DIFFUSE, "albedo", materialTextures[materialIndex], pendingTextures, textureLookup); // ! rename to ur convention
+
+                // 2. specular maps
+                loadMaterialTextures(material, aiTextureType_SPECULAR, "specular", materialTextures[materialIndex], pendingTextures, textureLookup); // ! rename to ur convention
+
+                // 3. normal maps
+                loadMaterialTextures(material, aiTextureType_HEIGHT, "normal", materialTextures[materialIndex], pendingTextures, textureLookup); // ! rename to ur convention
+
+                // // 4. height maps
+                // loadMaterialTextures(material, aiTextureType_AMBIENT, "height", materialTextures[materialIndex], pendingTextures, textureLookup); // ! rename to ur convention
+
+                materialDone[materialIndex] = true;
+            }
+            pendingMeshes[i].textures = materialTextures[materialIndex];
+        }
+
+        // 2. workers: textures go to the streamer first (decoded in the background, they take longest), then every mesh gets converted
+        vector<Texture> textures = requestTextures(pendingTextures);
+
+        AllocStats before = AllocStats::Now();
+        WorkerPool().ParallelFor((int)order.size(), [&](int job)
+                                 { processMesh(order[job], pendingMeshes[job]); });
+
+        float convertMs = msSince(convertStart);
+
+        MeshOptimizeStats total;
+        for (unsigned int i = 0; i < pendingMeshes.size(); i++)
+        {
+            const MeshOptimizeStats &stats = pendingMeshes[i].stats;
+            stats.Print("  mesh " + to_string(i) + " (" + order[i]->mName.C_Str() + ")");
+
+            // triangle weighted averages
+            total.verticesBefore += stats.verticesBefore;
+            total.verticesAfter += stats.verticesAfter;
+            total.trianglesBefore += stats.trianglesBefore;
+            total.trianglesAfter += stats.trianglesAfter;
+            total.acmrBefore += stats.acmrBefore * stats.trianglesBefore;
+            total.acmrAfter += stats.acmrAfter * stats.trianglesAfter;
+            total.overdrawBefore += stats.overdrawBefore * stats.trianglesBefore;
+            total.overdrawAfter += stats.overdrawAfter * stats.trianglesAfter;
+        }
+        total.acmrBefore /= std::max(total.trianglesBefore, 1u);
+        total.overdrawBefore /= std::max(total.trianglesBefore, 1u);
+        total.acmrAfter /= std::max(total.trianglesAfter, 1u);
+        total.overdrawAfter /= std::max(total.trianglesAfter, 1u);
+        total.Print("optimized " + to_string(pendingMeshes.size()) + " meshes");
+
+        // triangles per LOD over the whole model, meshes with a shorter chain count their last LOD further down
+        unsigned int lodTriangles[MESH_MAX_LODS] = {};
+        float lodError[MESH_MAX_LODS] = {};
+        for (const PendingMesh &pending : pendingMeshes)
+            for (unsigned int l = 0; l < MESH_MAX_LODS; l++)
+            {
+                const MeshLod &lod = pending.lods[std::min(l, (unsigned int)pending.lods.size() - 1)];
+                lodTriangles[l] += lod.indexCount / 3;
+                lodError[l] = std::max(lodError[l], lod.error);
+            }
+        cout << "lods:";
+        for (unsigned int l = 0; l < MESH_MAX_LODS; l++)
+            cout << (l ? " ->" : "") << " " << lodTriangles[l] << " (" << lodTriangles[l] * 100 / std::max(lodTriangles[0], 1u) << "%, error " << lodError[l] << ")";
+        cout << " triangles" << endl;
+
+        size_t meshletCount = 0;
+        for (const PendingMesh &pending : pendingMeshes)
+            meshletCount += pending.meshlets.size();
+        cout << "meshlets: " << meshletCount << " (up to " << MESHLET_MAX_VERTICES << " vertices / " << MESHLET_MAX_TRIANGLES << " triangles each, all LODs)" << endl;
+        auto uploadStart = std::chrono::steady_clock::now();
+
+        // 3. this thread: mesh heap ranges only
+        // one quantization box around the whole model (the meshes' aiProcess_GenBoundingBoxes boxes), meshes that share it still batch into one multi draw
+        glm::vec3 modelMin(FLT_MAX), modelMax(-FLT_MAX);
+        for (const aiMesh *mesh : order)
+        {
+            modelMin = glm::min(modelMin, glm::vec3(mesh->mAABB.mMin.x, mesh->mAABB.mMin.y, mesh->mAABB.mMin.z));
+            modelMax = glm::max(modelMax, glm::vec3(mesh->mAABB.mMax.x, mesh->mAABB.mMax.y, mesh->mAABB.mMax.z));
+        }
+        VertexQuantization quantization = VertexQuantization::FromBounds(modelMin, modelMax);
+
+        meshes.reserve(pendingMeshes.size());
+        for (PendingMesh &pending : pendingMeshes)
+        {
+            vector<Texture> meshTextures;
+            meshTextures.reserve(pending.textures.size());
+            for (int texture : pending.textures)
+                meshTextures.push_back(textures[texture]);
+
+            meshes.emplace_back(std::move(pending.vertices), std::move(pending.indices), std::move(meshTextures), &quantization, std::move(pending.lods),
+                                std::move(pending.meshlets));
+
+            const Mesh &mesh = meshes.back();
+            addOccluder(mesh, mesh.indices.data(), [&](unsigned int v)
+                        { return mesh.vertices[v].Position; });
+        }
+
+        buildBounds();
 
-        processNode(scene->mRootNode, scene);
+        (AllocStats::Now() - before).Print(("imported " + to_string(meshes.size()) + " meshes").c_str(), meshes.size());
+
+        importMs = msSince(start);
+        cout << "loaded " << path << " with assimp in " << importMs << " ms (read " << readMs << " ms | convert " << convertMs
+             << " ms on " << WorkerPool().Size() + 1 << " threads | upload " << msSince(uploadStart) << " ms)";
+        if (!WriteModelCache(path, meshes, importMs))
+            cout << ", could not write " << ModelCachePath(path);
+        cout << endl;
     }
 
-    void processNode(aiNode *node, const aiScene *scene)
+    // meshes straight from the mapped blobs into the mesh heap, no parsing; textures stream in like on a cold start
+    bool loadCache(string const &path, float &importMs)
     {
-        for (unsigned int i = 0; i < node->mNumMeshes; i++)
+        MappedFile file;
+        ModelCacheView cache;
+        if (!OpenModelCache(path, file, cache))
+            return false;
+
+        importMs = cache.header->importMs;
+
+        // cache texture entries are per mesh, decode each file once
+        vector<PendingTexture> pendingTextures;
+        unordered_map<string, int> textureLookup;
+        vector<int> textureRefs(cache.header->textureCount);
+        for (unsigned int t = 0; t < cache.header->textureCount; t++)
         {
-            aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            const CachedTexture &texture = cache.textures[t];
+            string texturePath(texture.path, strnlen(texture.path, sizeof(texture.path)));
+            string type(texture.type, strnlen(texture.type, sizeof(texture.type)));
+            textureRefs[t] = pendingTexture(pendingTextures, textureLookup, texturePath, type);
         }
 
-        // then do the same for each of its children
-        for (unsigned int i = 0; i < node->mNumChildren; i++)
+        vector<Texture> textures = requestTextures(pendingTextures);
+
+        meshes.reserve(cache.header->meshCount);
+        for (unsigned int i = 0; i < cache.header->meshCount; i++)
         {
-            processNode(node->mChildren[i], scene);
+            const CachedMesh &cached = cache.meshes[i];
+
+            vector<Texture> meshTextures;
+            meshTextures.reserve(cached.textureCount);
+            for (unsigned int t = 0; t < cached.textureCount; t++)
+                meshTextures.push_back(textures[textureRefs[cached.firstTexture + t]]);
+
+            vector<MeshLod> lods(std::min(cached.lodCount, (uint32_t)MESH_MAX_LODS));
+            for (unsigned int l = 0; l < lods.size(); l++)
+                lods[l] = MeshLod{cached.lodFirstIndex[l], cached.lodIndexCount[l], cached.lodError[l], cached.lodFirstMeshlet[l], cached.lodMeshletCount[l]};
+            vector<Meshlet> meshlets(cache.meshlets + cached.meshletOffset, cache.meshlets + cached.meshletOffset + cached.meshletCount);
+
+            meshes.emplace_back(cache.vertices + cached.vertexOffset, cached.vertexCount, cache.indices + cached.indexOffset, cached.indexCount,
+                                std::move(meshTextures), glm::make_vec3(cached.boundsMin), glm::make_vec3(cached.boundsMax), quantization(cached),
+                                std::move(lods), std::move(meshlets));
+
+            const PackedVertex *vertices = cache.vertices + cached.vertexOffset;
+            const VertexQuantization &meshQuantization = meshes.back().quantization;
+            addOccluder(meshes.back(), cache.indices + cached.indexOffset, [&](unsigned int v)
+                        { return UnpackPosition(vertices[v], meshQuantization); });
         }
+
+        return true;
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static VertexQuantization quantization(const CachedMesh &cached)
     {
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        VertexQuantization quantization;
+        quantization.offset = glm::make_vec3(cached.quantizationOffset);
+        quantization.scale = glm::make_vec3(cached.quantizationScale);
+        return quantization;
+    }
+
+    // every mesh in node order, the order they are drawn in
+    void collectMeshes(aiNode *node, const aiScene *scene, vector<aiMesh *> &order)
+    {
+        for (unsigned int i = 0; i < node->mNumMeshes; i++)
+            order.push_back(scene->mMeshes[node->mMeshes[i]]);
 
+        // then do the same for each of its children
+        for (unsigned int i = 0; i < node->mNumChildren; i++)
+            collectMeshes(node->mChildren[i], scene, order);
+    }
+
+    // fills pre-sized buffers straight from the aiMesh, optimizes them (mesh_optimizer.h), appends the LODs (mesh_simplify.h)
+    // and splits every LOD into meshlets (meshlet.h)
+    // runs on a worker (no GL, no shared state)
+    static void processMesh(const aiMesh *mesh, PendingMesh &pending)
+    {
+        vector<Vertex> &vertices = pending.vertices;
+        vector<unsigned int> &indices = pending.indices;
+
+        vertices.resize(mesh->mNumVertices);
         for (unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
+            Vertex &vertex = vertices[i];
 
             // process vertex positions, normals and texture coordinates
-            glm::vec3 vector;
-
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
+            vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
 
             if (mesh->HasNormals())
-            {
-                vector.x = mesh->mNormals[i].x;
-                vector.y = mesh->mNormals[i].y;
-                vector.z = mesh->mNormals[i].z;
-                vertex.Normal = vector;
-            }
+                vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+            else
+                vertex.Normal = glm::vec3(0.0f);
 
             if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
-            {
-                glm::vec2 vec;
-                vec.x = mesh->mTextureCoords[0][i].x;
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexCoords = vec;
-            }
+                vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
             else
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-            vertices.push_back(vertex);
         }
 
-        // process indices
+        // process indices, triangulated so 3 per face (points / lines keep fewer)
+        indices.reserve(mesh->mNumFaces * 3);
         for (unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
-            aiFace face = mesh->mFaces[i];
-            for (unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
+            const aiFace &face = mesh->mFaces[i]; // ! by value it would copy (allocate) the face's index array
+            indices.insert(indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
         }
 
-        // process material
-        if (mesh->mMaterialIndex >= 0) // * can remove this check
-        {
-            aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
-
-            // 1. albedo maps
-            vector<Texture> albedoMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "albedo"); // ! rename to ur convention
-            textures.insert(textures.end(), albedoMaps.begin(), albedoMaps.end());
+        allocCounters.bytesCopied.fetch_add(vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int), std::memory_order_relaxed);
 
-            // 2. specular maps
-            vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "specular"); // ! rename to ur convention
-            textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-
-            // 3. normal maps
-            std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "normal"); // ! rename to ur convention
-            textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        // points / lines can't be reordered or simplified as triangles
+        if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+        {
+            OptimizeMesh(vertices, indices, &pending.stats);
+            GenerateLods(vertices, indices, pending.lods);
 
-            // // 4. height maps
-            // std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "height"); // ! rename to ur convention
-            // textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+            for (MeshLod &lod : pending.lods)
+            {
+                lod.firstMeshlet = (unsigned int)pending.meshlets.size();
+                BuildMeshlets(vertices, indices, lod.firstIndex, lod.indexCount, pending.meshlets);
+                lod.meshletCount = (unsigned int)pending.meshlets.size() - lod.firstMeshlet;
+            }
         }
-
-        return Mesh(vertices, indices, textures);
+        else
+            pending.lods.assign(1, MeshLod{0, (unsigned int)indices.size(), 0.0f});
     }
 
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // appends the material's textures of this type to refs
+    void loadMaterialTextures(aiMaterial *mat, aiTextureType type, const string &typeName, vector<int> &refs,
+                              vector<PendingTexture> &pendingTextures, unordered_map<string, int> &textureLookup)
     {
-        vector<Texture> textures;
         for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
 
-            bool skip = false;
-            for (unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true;
-                    break;
-                }
-            }
-
-            if (!skip)
-            {
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), directory); // ! compare with imgToTexID
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);
-            }
+            refs.push_back(pendingTexture(pendingTextures, textureLookup, str.C_Str(), typeName));
         }
-        return textures;
     }
 
-    unsigned int TextureFromFile(const char *path, const string &directory) //, bool gamma)
+    // index of the texture file in pending, added if new: every file is only acquired once per model
+    static int pendingTexture(vector<PendingTexture> &pending, unordered_map<string, int> &lookup, const string &path, const string &typeName)
     {
-        string filename = string(path);
-        filename = directory + '/' + filename;
+        auto found = lookup.find(path);
+        if (found != lookup.end())
+            return found->second;
+
+        PendingTexture texture;
+        texture.path = path;
+        texture.type = typeName;
+        pending.push_back(texture);
+        return lookup[path] = (int)pending.size() - 1;
+    }
 
-        unsigned int textureID;
-        glGenTextures(1, &textureID);
+    // a texture id per file from the shared cache (streamed in if nobody has it yet), in the same order, also recorded in textures_loaded
+    // flipped like every texture main loads (stbi_set_flip_vertically_on_load(true) before the model)
+    // block compressed by what the material uses them for: albedo BC1 / BC3, specular BC4, normal BC5
+    vector<Texture> requestTextures(const vector<PendingTexture> &pending)
+    {
+        vector<Texture> textures;
+        textures.reserve(pending.size());
 
-        int width, height, nrComponents;
-        unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-        if (data)
+        for (const PendingTexture &file : pending)
         {
-            GLenum format = GL_RED; // + This is defaulted to GL_RED to avoid warning.
-            if (nrComponents == 1)
-                format = GL_RED;
-            else if (nrComponents == 3)
-                format = GL_RGB;
-            else if (nrComponents == 4)
-                format = GL_RGBA;
-
-            glBindTexture(GL_TEXTURE_2D, textureID);
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
+            bool normal = file.type == "normal";
+            TextureCompression compression = normal ? COMPRESS_NORMAL : (file.type == "specular" ? COMPRESS_GRAY : COMPRESS_COLOR);
 
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            Texture texture;
+            texture.id = Textures().Acquire(directory + '/' + file.path, GL_REPEAT, true,
+                                            normal ? PLACEHOLDER_NORMAL : PLACEHOLDER_GRAY, compression);
+            texture.type = file.type;
+            texture.path = file.path;
 
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Texture failed to load at path: " << path << std::endl;
-            stbi_image_free(data);
+            textures.push_back(texture);
+            textures_loaded.push_back(texture);
         }
 
-        return textureID;
+        return textures;
     }
 };
 
@@ -0,0 +1,335 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <lib/mesh.h>
+#include <lib/mapped_file.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// binary copy of an imported model in cache/models (media/backpack/backpack.obj -> media_backpack_backpack.obj.cache)
+// layout: header | meshes | textures | vertex blob | index blob | meshlet blob
+// the vertex blob is exactly what the mesh heap gets (PackedVertex, already quantized), the index blob keeps 32 bit indices
+// (every LOD's back to back) and the heap narrows them to 16 bit for meshes that fit, like after an import
+// rebuilt whenever the source file, its material library (.obj mtllib), the version, the PackedVertex layout or MESH_MAX_LODS changes
+// every mesh entry is checked against the blobs before anything gets read through it, a corrupt cache is treated like a stale one
+#define MODEL_CACHE_VERSION 6
+#define MODEL_CACHE_MAGIC 0x4D474F4C // "LOGM"
+
+struct ModelCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexStride; // sizeof(PackedVertex) when written
+    uint32_t maxLods;      // MESH_MAX_LODS when written
+    uint32_t meshCount;
+    uint32_t textureCount;
+    float importMs; // what the assimp import took, reported next to the cached load
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    char materialLibrary[240]; // relative to the model's directory, empty if the source has none
+    uint64_t materialSize;
+    int64_t materialTime;
+    uint64_t vertexBlobOffset, vertexCount;
+    uint64_t indexBlobOffset, indexCount;
+    uint64_t meshletBlobOffset, meshletCount;
+};
+
+struct CachedMesh
+{
+    uint32_t vertexOffset, vertexCount; // into the vertex blob, in vertices
+    uint32_t indexOffset, indexCount;   // into the index blob, relative to the mesh's first vertex, all LODs
+    uint32_t lodCount;
+    uint32_t lodFirstIndex[MESH_MAX_LODS], lodIndexCount[MESH_MAX_LODS]; // from indexOffset
+    float lodError[MESH_MAX_LODS];
+    uint32_t lodFirstMeshlet[MESH_MAX_LODS], lodMeshletCount[MESH_MAX_LODS]; // from meshletOffset
+    uint32_t meshletOffset, meshletCount; // into the meshlet blob
+    float boundsMin[3], boundsMax[3];
+    float quantizationOffset[3], quantizationScale[3]; // the box the vertices were packed in
+    uint32_t firstTexture, textureCount;
+};
+
+struct CachedTexture
+{
+    char type[16]; // albedo / specular / normal
+    char path[240]; // relative to the model's directory, as the material has it; a model with a longer one isn't cached
+};
+
+// -------------------------------------------------------------------------------------------------------------------------
+
+// pointers into a mapped cache file, only valid while the MappedFile is open
+struct ModelCacheView
+{
+    const ModelCacheHeader *header;
+    const CachedMesh *meshes;
+    const CachedTexture *textures;
+    const PackedVertex *vertices;
+    const unsigned int *indices;
+    const Meshlet *meshlets;
+};
+
+#define MODEL_CACHE_DIRECTORY "cache/models"
+
+inline string ModelCachePath(const string &sourcePath)
+{
+    string name = sourcePath;
+    for (char &c : name)
+        if (c == '/' || c == '\\')
+            c = '_';
+
+    return string(MODEL_CACHE_DIRECTORY) + "/" + name + ".cache";
+}
+
+// size + modification time of the source, the cache is stale when either changed
+inline bool SourceStamp(const string &sourcePath, uint64_t &size, int64_t &time)
+{
+    std::error_code error;
+    size = (uint64_t)std::filesystem::file_size(sourcePath, error);
+    if (error)
+        return false;
+
+    time = (int64_t)std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count();
+    return !error;
+}
+
+// the first material library an .obj names (mtllib), "" for other formats or none; reads the whole file, only for writing the cache
+inline string MaterialLibrary(const string &sourcePath)
+{
+    if (sourcePath.size() < 4 || sourcePath.compare(sourcePath.size() - 4, 4, ".obj") != 0)
+        return "";
+
+    std::ifstream in(sourcePath);
+    string line;
+    while (std::getline(in, line))
+    {
+        if (line.compare(0, 7, "mtllib ") != 0)
+            continue;
+
+        size_t first = line.find_first_not_of(" \t", 7), last = line.find_last_not_of(" \t\r");
+        return first == string::npos ? "" : line.substr(first, last - first + 1);
+    }
+    return "";
+}
+
+inline string ModelDirectory(const string &sourcePath)
+{
+    size_t slash = sourcePath.find_last_of("/\\");
+    return slash == string::npos ? "." : sourcePath.substr(0, slash);
+}
+
+// every range a mesh entry points at lies inside the blobs, and so does every index; what loadCache relies on
+inline bool ValidCachedMesh(const ModelCacheView &view, const CachedMesh &mesh)
+{
+    const ModelCacheHeader &header = *view.header;
+    if ((uint64_t)mesh.vertexOffset + mesh.vertexCount > header.vertexCount || (uint64_t)mesh.indexOffset + mesh.indexCount > header.indexCount ||
+        (uint64_t)mesh.meshletOffset + mesh.meshletCount > header.meshletCount ||
+        (uint64_t)mesh.firstTexture + mesh.textureCount > header.textureCount)
+        return false;
+
+    if (mesh.lodCount == 0 || mesh.lodCount > MESH_MAX_LODS)
+        return false;
+
+    for (unsigned int l = 0; l < mesh.lodCount; l++)
+        if ((uint64_t)mesh.lodFirstIndex[l] + mesh.lodIndexCount[l] > mesh.indexCount ||
+            (uint64_t)mesh.lodFirstMeshlet[l] + mesh.lodMeshletCount[l] > mesh.meshletCount)
+            return false;
+
+    for (unsigned int m = 0; m < mesh.meshletCount; m++)
+    {
+        const Meshlet &meshlet = view.meshlets[mesh.meshletOffset + m];
+        if ((uint64_t)meshlet.firstIndex + meshlet.indexCount > mesh.indexCount)
+            return false;
+    }
+
+    const unsigned int *indices = view.indices + mesh.indexOffset;
+    for (unsigned int i = 0; i < mesh.indexCount; i++)
+        if (indices[i] >= mesh.vertexCount)
+            return false;
+
+    return true;
+}
+
+// maps the cache and checks it belongs to this source and build, false means import with assimp instead
+inline bool OpenModelCache(const string &sourcePath, MappedFile &file, ModelCacheView &view)
+{
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (!SourceStamp(sourcePath, sourceSize, sourceTime) || !file.Open(ModelCachePath(sourcePath)))
+        return false;
+
+    if (file.Size() < sizeof(ModelCacheHeader))
+        return false;
+
+    const ModelCacheHeader *header = (const ModelCacheHeader *)file.Data();
+    if (header->magic != MODEL_CACHE_MAGIC || header->version != MODEL_CACHE_VERSION || header->vertexStride != sizeof(PackedVertex) || header->maxLods != MESH_MAX_LODS ||
+        header->sourceSize != sourceSize || header->sourceTime != sourceTime)
+        return false;
+
+    // a truncated file (crash while writing ...) must not be read past its end
+    // (blobs are 16 byte aligned; counts compared by division, a garbage count must not wrap the multiplication around)
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t stride)
+    {
+        return offset % 16 == 0 && offset <= file.Size() && count <= (file.Size() - offset) / stride;
+    };
+    uint64_t tablesEnd = sizeof(ModelCacheHeader) + header->meshCount * sizeof(CachedMesh) + header->textureCount * sizeof(CachedTexture);
+    if (tablesEnd > file.Size() ||
+        !fits(header->vertexBlobOffset, header->vertexCount, sizeof(PackedVertex)) ||
+        !fits(header->indexBlobOffset, header->indexCount, sizeof(unsigned int)) ||
+        !fits(header->meshletBlobOffset, header->meshletCount, sizeof(Meshlet)))
+        return false;
+
+    view.header = header;
+    view.meshes = (const CachedMesh *)(file.Data() + sizeof(ModelCacheHeader));
+    view.textures = (const CachedTexture *)(view.meshes + header->meshCount);
+    view.vertices = (const PackedVertex *)(file.Data() + header->vertexBlobOffset);
+    view.indices = (const unsigned int *)(file.Data() + header->indexBlobOffset);
+    view.meshlets = (const Meshlet *)(file.Data() + header->meshletBlobOffset);
+
+    // + material library, edited texture paths / materials have to show up too
+    if (!memchr(header->materialLibrary, 0, sizeof(header->materialLibrary)))
+        return false;
+    if (header->materialLibrary[0])
+    {
+        uint64_t materialSize;
+        int64_t materialTime;
+        if (!SourceStamp(ModelDirectory(sourcePath) + "/" + header->materialLibrary, materialSize, materialTime) ||
+            header->materialSize != materialSize || header->materialTime != materialTime)
+            return false;
+    }
+
+    for (unsigned int i = 0; i < header->meshCount; i++)
+        if (!ValidCachedMesh(view, view.meshes[i]))
+            return false;
+
+    return true;
+}
+
+// writes meshes (which still have their CPU buffers, packed again in their box) to the cache, into a temporary file first so a half written cache never gets mapped
+inline bool WriteModelCache(const string &sourcePath, const vector<Mesh> &meshes, float importMs)
+{
+    ModelCacheHeader header = {};
+    header.magic = MODEL_CACHE_MAGIC;
+    header.version = MODEL_CACHE_VERSION;
+    header.vertexStride = sizeof(PackedVertex);
+    header.maxLods = MESH_MAX_LODS;
+    header.meshCount = (uint32_t)meshes.size();
+    header.importMs = importMs;
+    if (!SourceStamp(sourcePath, header.sourceSize, header.sourceTime))
+        return false;
+
+    string materialLibrary = MaterialLibrary(sourcePath);
+    if (materialLibrary.size() >= sizeof(header.materialLibrary))
+        return false;
+    if (!materialLibrary.empty())
+    {
+        if (!SourceStamp(ModelDirectory(sourcePath) + "/" + materialLibrary, header.materialSize, header.materialTime))
+            return false;
+        memcpy(header.materialLibrary, materialLibrary.c_str(), materialLibrary.size());
+    }
+
+    vector<CachedMesh> cachedMeshes(meshes.size(), CachedMesh{});
+    vector<CachedTexture> cachedTextures;
+
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        const Mesh &mesh = meshes[i];
+        CachedMesh &cached = cachedMeshes[i];
+
+        cached.vertexOffset = (uint32_t)header.vertexCount;
+        cached.vertexCount = (uint32_t)mesh.vertices.size();
+        cached.indexOffset = (uint32_t)header.indexCount;
+        cached.indexCount = (uint32_t)mesh.indices.size();
+        memcpy(cached.boundsMin, &mesh.boundsMin[0], sizeof(cached.boundsMin));
+        memcpy(cached.boundsMax, &mesh.boundsMax[0], sizeof(cached.boundsMax));
+        memcpy(cached.quantizationOffset, &mesh.quantization.offset[0], sizeof(cached.quantizationOffset));
+        memcpy(cached.quantizationScale, &mesh.quantization.scale[0], sizeof(cached.quantizationScale));
+
+        cached.lodCount = (uint32_t)std::min(mesh.lods.size(), (size_t)MESH_MAX_LODS);
+        for (unsigned int l = 0; l < cached.lodCount; l++)
+        {
+            cached.lodFirstIndex[l] = mesh.lods[l].firstIndex;
+            cached.lodIndexCount[l] = mesh.lods[l].indexCount;
+            cached.lodError[l] = mesh.lods[l].error;
+            cached.lodFirstMeshlet[l] = mesh.lods[l].firstMeshlet;
+            cached.lodMeshletCount[l] = mesh.lods[l].meshletCount;
+        }
+        cached.meshletOffset = (uint32_t)header.meshletCount;
+        cached.meshletCount = (uint32_t)mesh.meshlets.size();
+
+        cached.firstTexture = (uint32_t)cachedTextures.size();
+        cached.textureCount = (uint32_t)mesh.textures.size();
+        for (const Texture &texture : mesh.textures)
+        {
+            // a cut off path would load the wrong file (or none) next time, better no cache at all
+            CachedTexture entry = {};
+            if (texture.type.size() >= sizeof(entry.type) || texture.path.size() >= sizeof(entry.path))
+                return false;
+            memcpy(entry.type, texture.type.c_str(), texture.type.size());
+            memcpy(entry.path, texture.path.c_str(), texture.path.size());
+            cachedTextures.push_back(entry);
+        }
+
+        header.vertexCount += cached.vertexCount;
+        header.indexCount += cached.indexCount;
+        header.meshletCount += cached.meshletCount;
+    }
+
+    header.textureCount = (uint32_t)cachedTextures.size();
+
+    // blobs 16 byte aligned, the mapping itself starts page aligned
+    uint64_t tablesEnd = sizeof(ModelCacheHeader) + cachedMeshes.size() * sizeof(CachedMesh) + cachedTextures.size() * sizeof(CachedTexture);
+    header.vertexBlobOffset = (tablesEnd + 15) & ~(uint64_t)15;
+    header.indexBlobOffset = (header.vertexBlobOffset + header.vertexCount * sizeof(PackedVertex) + 15) & ~(uint64_t)15;
+    header.meshletBlobOffset = (header.indexBlobOffset + header.indexCount * sizeof(unsigned int) + 15) & ~(uint64_t)15;
+
+    string cachePath = ModelCachePath(sourcePath);
+    string tempPath = cachePath + ".tmp";
+
+    std::error_code error;
+    std::filesystem::create_directories(MODEL_CACHE_DIRECTORY, error);
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        static const char padding[16] = {};
+
+        out.write((const char *)&header, sizeof(header));
+        out.write((const char *)cachedMeshes.data(), cachedMeshes.size() * sizeof(CachedMesh));
+        out.write((const char *)cachedTextures.data(), cachedTextures.size() * sizeof(CachedTexture));
+        out.write(padding, header.vertexBlobOffset - tablesEnd);
+
+        uint64_t written = header.vertexBlobOffset;
+        vector<PackedVertex> packed;
+        for (const Mesh &mesh : meshes)
+        {
+            packed.resize(mesh.vertices.size());
+            PackVertices(mesh.vertices.data(), (unsigned int)mesh.vertices.size(), mesh.quantization, packed.data());
+
+            out.write((const char *)packed.data(), packed.size() * sizeof(PackedVertex));
+            written += packed.size() * sizeof(PackedVertex);
+        }
+        out.write(padding, header.indexBlobOffset - written);
+
+        for (const Mesh &mesh : meshes)
+            out.write((const char *)mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+        out.write(padding, header.meshletBlobOffset - header.indexBlobOffset - header.indexCount * sizeof(unsigned int));
+
+        for (const Mesh &mesh : meshes)
+            out.write((const char *)mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+
+        if (!out)
+            return false;
+    }
+
+    std::filesystem::rename(tempPath, cachePath, error);
+    return !error;
+}
+
+#endif
@@ -0,0 +1,342 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <glm/glm.hpp>
+
+#include <lib/constants.h>
+#include <lib/culling.h>
+#include <lib/stats.h>
+#include <lib/thread_pool.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE
+#include <emmintrin.h>
+#endif
+
+const int OCCLUSION_TILES_X = OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH;
+const int OCCLUSION_TILES_Y = OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT;
+const int OCCLUSION_TILE_PIXELS = OCCLUSION_TILE_WIDTH * OCCLUSION_TILE_HEIGHT;
+
+// software occlusion culling: occluders are rasterized into a small CPU depth buffer, boxes behind it get skipped before they are drawn
+// pure CPU (no GL), so it runs and can be checked without a GPU
+// depth = clip z / w mapped to [0, 1] like the GL depth buffer, 1 = nothing there; tile major, one tile's pixels are contiguous
+// and every tile also keeps its farthest depth, so most box tests never look at single pixels
+//
+// per frame: Begin(view projection) -> AddOccluder / AddCube ... -> Rasterize() -> Cull / IsVisible
+class OcclusionBuffer
+{
+public:
+    OcclusionBuffer()
+        : depth(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 1.0f), tileMax(OCCLUSION_TILES_X * OCCLUSION_TILES_Y, 1.0f)
+    {
+    }
+
+    void Begin(const glm::mat4 &viewProjection)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        this->viewProjection = viewProjection;
+        triangles.clear();
+        std::fill(depth.begin(), depth.end(), 1.0f);
+        std::fill(tileMax.begin(), tileMax.end(), 1.0f);
+
+        frameStats.occlusionMs += msSince(start);
+    }
+
+    // triangles of positions placed by model, both sides count (open meshes occlude too); they are only set up here, Rasterize draws them
+    void AddOccluder(const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &indices, const glm::mat4 &model)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        // every vertex projected once, only triangles that cross the near plane need clipping
+        glm::mat4 m = viewProjection * model;
+        clip.resize(positions.size());
+        screen.resize(positions.size());
+        for (unsigned int i = 0; i < positions.size(); i++)
+        {
+            clip[i] = m * glm::vec4(positions[i], 1.0f);
+            if (clip[i].z >= -clip[i].w)
+                screen[i] = toScreen(clip[i]);
+        }
+
+        for (unsigned int t = 0; t + 2 < indices.size(); t += 3)
+        {
+            const glm::vec4 &a = clip[indices[t]], &b = clip[indices[t + 1]], &c = clip[indices[t + 2]];
+            if (a.z >= -a.w && b.z >= -b.w && c.z >= -c.w)
+                setupTriangle(screen[indices[t]], screen[indices[t + 1]], screen[indices[t + 2]]);
+            else
+                clipTriangle(a, b, c);
+        }
+
+        frameStats.occlusionMs += msSince(start);
+    }
+
+    // the unit cube (-0.5 .. 0.5) the scene draws its cubes with
+    void AddCube(const glm::mat4 &model)
+    {
+        static const std::vector<glm::vec3> corners = {{-0.5f, -0.5f, -0.5f}, {0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, -0.5f}, {-0.5f, 0.5f, -0.5f},
+                                                       {-0.5f, -0.5f, 0.5f}, {0.5f, -0.5f, 0.5f}, {0.5f, 0.5f, 0.5f}, {-0.5f, 0.5f, 0.5f}};
+        static const std::vector<unsigned int> faces = {0, 1, 2, 0, 2, 3, 4, 6, 5, 4, 7, 6, 0, 4, 5, 0, 5, 1,
+                                                        3, 2, 6, 3, 6, 7, 0, 3, 7, 0, 7, 4, 1, 5, 6, 1, 6, 2};
+        AddOccluder(corners, faces, model);
+    }
+
+    // every tile row is one job on the worker pool, each goes through all triangles and keeps the ones that touch it
+    void Rasterize()
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        WorkerPool().ParallelFor(OCCLUSION_TILES_Y, [this](int tileRow)
+                                 { rasterizeRow(tileRow); });
+
+        frameStats.occluderTriangles += (unsigned int)triangles.size();
+        frameStats.occlusionMs += msSince(start);
+    }
+
+    // false: the box (model space, placed by model) is completely behind what has been rasterized, or off screen
+    bool IsVisible(glm::vec3 boundsMin, glm::vec3 boundsMax, const glm::mat4 &model) const
+    {
+        glm::mat4 m = viewProjection * model;
+
+        // screen rectangle and nearest depth of the corners, the box can't be in front of its nearest corner
+        float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, nearest = 1.0f;
+        for (int c = 0; c < 8; c++)
+        {
+            glm::vec3 corner(c & 1 ? boundsMax.x : boundsMin.x, c & 2 ? boundsMax.y : boundsMin.y, c & 4 ? boundsMax.z : boundsMin.z);
+            glm::vec4 p = m * glm::vec4(corner, 1.0f);
+
+            // reaches past the near plane, the camera may be inside it
+            if (p.z < -p.w || p.w <= 0.0f)
+                return true;
+
+            glm::vec3 screen = toScreen(p);
+            minX = std::min(minX, screen.x), maxX = std::max(maxX, screen.x);
+            minY = std::min(minY, screen.y), maxY = std::max(maxY, screen.y);
+            nearest = std::min(nearest, screen.z);
+        }
+
+        int x0 = std::max(pixelFloor(minX), 0), x1 = std::min(pixelFloor(maxX), OCCLUSION_WIDTH - 1);
+        int y0 = std::max(pixelFloor(minY), 0), y1 = std::min(pixelFloor(maxY), OCCLUSION_HEIGHT - 1);
+        if (x0 > x1 || y0 > y1)
+            return false;
+
+        for (int ty = y0 / OCCLUSION_TILE_HEIGHT; ty <= y1 / OCCLUSION_TILE_HEIGHT; ty++)
+            for (int tx = x0 / OCCLUSION_TILE_WIDTH; tx <= x1 / OCCLUSION_TILE_WIDTH; tx++)
+            {
+                // everything in the tile is nearer than the box
+                if (tileMax[ty * OCCLUSION_TILES_X + tx] < nearest)
+                    continue;
+
+                const float *tile = &depth[(ty * OCCLUSION_TILES_X + tx) * OCCLUSION_TILE_PIXELS];
+                int px0 = std::max(x0 - tx * OCCLUSION_TILE_WIDTH, 0), px1 = std::min(x1 - tx * OCCLUSION_TILE_WIDTH, OCCLUSION_TILE_WIDTH - 1);
+                int py0 = std::max(y0 - ty * OCCLUSION_TILE_HEIGHT, 0), py1 = std::min(y1 - ty * OCCLUSION_TILE_HEIGHT, OCCLUSION_TILE_HEIGHT - 1);
+                for (int py = py0; py <= py1; py++)
+                    for (int px = px0; px <= px1; px++)
+                        if (tile[py * OCCLUSION_TILE_WIDTH + px] >= nearest)
+                            return true;
+            }
+
+        return false;
+    }
+
+    // clears visible[i] for every box (model space, placed by model) that is hidden; boxes already at 0 (frustum culled) aren't tested
+    // returns how many are left
+    unsigned int Cull(const BoundingBoxes &boxes, const glm::mat4 &model, std::vector<unsigned char> &visible) const
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        unsigned int drawn = 0;
+        for (unsigned int i = 0; i < boxes.Count(); i++)
+        {
+            if (!visible[i])
+                continue;
+
+            frameStats.occlusionTested++;
+            visible[i] = IsVisible(glm::vec3(boxes.minX[i], boxes.minY[i], boxes.minZ[i]), glm::vec3(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i]), model);
+            frameStats.occlusionCulled += !visible[i];
+            drawn += visible[i];
+        }
+
+        frameStats.occlusionMs += msSince(start);
+        return drawn;
+    }
+
+    // depth at pixel (x, y), y up like gl_FragCoord
+    float Depth(int x, int y) const
+    {
+        int tile = (y / OCCLUSION_TILE_HEIGHT) * OCCLUSION_TILES_X + x / OCCLUSION_TILE_WIDTH;
+        return depth[tile * OCCLUSION_TILE_PIXELS + (y % OCCLUSION_TILE_HEIGHT) * OCCLUSION_TILE_WIDTH + x % OCCLUSION_TILE_WIDTH];
+    }
+
+private:
+    // pixel space triangle, set up once for every tile row it touches
+    // edge functions e = A x + B y + C, all >= 0 inside; depth = dzdx x + dzdy y + zC
+    struct ScreenTriangle
+    {
+        float A[3], B[3], C[3];
+        float dzdx, dzdy, zC;
+        int x0, x1, y0, y1; // pixel bounds, on screen
+    };
+
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    std::vector<float> depth;
+    std::vector<float> tileMax;
+    std::vector<ScreenTriangle> triangles;
+    std::vector<glm::vec4> clip; // AddOccluder scratch
+    std::vector<glm::vec3> screen;
+
+    static float msSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // floor, clamped to a pixel range around the screen first (no int overflow for far off vertices, and no libm call)
+    static int pixelFloor(float value)
+    {
+        value = std::min(std::max(value, -2.0f), (float)OCCLUSION_WIDTH + 1.0f);
+        int truncated = (int)value;
+        return truncated - (truncated > value);
+    }
+
+    static glm::vec3 toScreen(const glm::vec4 &p)
+    {
+        glm::vec3 ndc = glm::vec3(p) / p.w;
+        return glm::vec3((ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH, (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT, ndc.z * 0.5f + 0.5f);
+    }
+
+    // a triangle through the near plane: clipped against it (z >= -w, up to one extra triangle) unless it is off to one side anyway
+    void clipTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c)
+    {
+        const glm::vec4 in[3] = {a, b, c};
+
+        for (int axis = 0; axis < 2; axis++)
+            if ((a[axis] > a.w && b[axis] > b.w && c[axis] > c.w) || (a[axis] < -a.w && b[axis] < -b.w && c[axis] < -c.w))
+                return;
+
+        glm::vec4 polygon[4];
+        int count = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            const glm::vec4 &p = in[i], &q = in[(i + 1) % 3];
+            float dp = p.z + p.w, dq = q.z + q.w;
+
+            if (dp >= 0.0f)
+                polygon[count++] = p;
+            if ((dp >= 0.0f) != (dq >= 0.0f))
+                polygon[count++] = p + (q - p) * (dp / (dp - dq));
+        }
+
+        for (int i = 1; i + 1 < count; i++)
+            setupTriangle(toScreen(polygon[0]), toScreen(polygon[i]), toScreen(polygon[i + 1]));
+    }
+
+    // pixel bounds, edge functions and depth plane; off screen / beyond the far plane / between pixel centers: dropped
+    void setupTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2)
+    {
+        if (v0.z > 1.0f && v1.z > 1.0f && v2.z > 1.0f)
+            return;
+
+        // pixels whose centers can be inside (a center exactly on the bounds may get left out, occluders only ever shrink by that)
+        ScreenTriangle triangle;
+        triangle.x0 = std::max(pixelFloor(std::min(v0.x, std::min(v1.x, v2.x)) - 0.5f) + 1, 0);
+        triangle.x1 = std::min(pixelFloor(std::max(v0.x, std::max(v1.x, v2.x)) - 0.5f), OCCLUSION_WIDTH - 1);
+        triangle.y0 = std::max(pixelFloor(std::min(v0.y, std::min(v1.y, v2.y)) - 0.5f) + 1, 0);
+        triangle.y1 = std::min(pixelFloor(std::max(v0.y, std::max(v1.y, v2.y)) - 0.5f), OCCLUSION_HEIGHT - 1);
+        if (triangle.x0 > triangle.x1 || triangle.y0 > triangle.y1)
+            return;
+
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+        if (std::abs(area) < 1e-6f)
+            return;
+
+        // both sides: clockwise ones get turned around
+        if (area < 0.0f)
+        {
+            std::swap(v1, v2);
+            area = -area;
+        }
+
+        const glm::vec3 *edgeFrom[3] = {&v0, &v1, &v2}, *edgeTo[3] = {&v1, &v2, &v0};
+        for (int e = 0; e < 3; e++)
+        {
+            triangle.A[e] = -(edgeTo[e]->y - edgeFrom[e]->y);
+            triangle.B[e] = edgeTo[e]->x - edgeFrom[e]->x;
+            triangle.C[e] = -triangle.A[e] * edgeFrom[e]->x - triangle.B[e] * edgeFrom[e]->y;
+        }
+        float invArea = 1.0f / area;
+        triangle.dzdx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) * invArea;
+        triangle.dzdy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) * invArea;
+        triangle.zC = v0.z - triangle.dzdx * v0.x - triangle.dzdy * v0.y;
+
+        triangles.push_back(triangle);
+    }
+
+    // every triangle into one tile row, pixel centers inside (edges included) keep the nearer depth; then the row's tile maxima
+    void rasterizeRow(int tileRow)
+    {
+        int rowY0 = tileRow * OCCLUSION_TILE_HEIGHT, rowY1 = rowY0 + OCCLUSION_TILE_HEIGHT - 1;
+
+        for (const ScreenTriangle &triangle : triangles)
+        {
+            int y0 = std::max(triangle.y0, rowY0), y1 = std::min(triangle.y1, rowY1);
+            if (y0 > y1)
+                continue;
+
+            const float *A = triangle.A, *B = triangle.B, *C = triangle.C;
+
+            for (int y = y0; y <= y1; y++)
+            {
+                float py = y + 0.5f;
+                float *tileLine = &depth[(tileRow * OCCLUSION_TILES_X) * OCCLUSION_TILE_PIXELS + (y - rowY0) * OCCLUSION_TILE_WIDTH];
+
+#ifdef OCCLUSION_SSE
+                // 4 pixels at a time, the groups never straddle a tile (OCCLUSION_TILE_WIDTH is a multiple of 4)
+                __m128 e0Row = _mm_set1_ps(B[0] * py + C[0]), e1Row = _mm_set1_ps(B[1] * py + C[1]), e2Row = _mm_set1_ps(B[2] * py + C[2]);
+                __m128 zRow = _mm_set1_ps(triangle.dzdy * py + triangle.zC);
+                __m128 a0 = _mm_set1_ps(A[0]), a1 = _mm_set1_ps(A[1]), a2 = _mm_set1_ps(A[2]), dz = _mm_set1_ps(triangle.dzdx);
+                __m128 zero = _mm_setzero_ps();
+
+                for (int x = triangle.x0 & ~3; x <= triangle.x1; x += 4)
+                {
+                    __m128 px = _mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+                    __m128 inside = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), e0Row), zero),
+                                               _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), e1Row), zero));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), e2Row), zero));
+                    if (_mm_movemask_ps(inside) == 0)
+                        continue;
+
+                    float *pixels = tileLine + (x / OCCLUSION_TILE_WIDTH) * OCCLUSION_TILE_PIXELS + x % OCCLUSION_TILE_WIDTH;
+                    __m128 current = _mm_loadu_ps(pixels);
+                    __m128 z = _mm_min_ps(current, _mm_add_ps(_mm_mul_ps(dz, px), zRow));
+                    _mm_storeu_ps(pixels, _mm_or_ps(_mm_and_ps(inside, z), _mm_andnot_ps(inside, current)));
+                }
+#else
+                for (int x = triangle.x0; x <= triangle.x1; x++)
+                {
+                    float px = x + 0.5f;
+                    if (A[0] * px + B[0] * py + C[0] < 0.0f || A[1] * px + B[1] * py + C[1] < 0.0f || A[2] * px + B[2] * py + C[2] < 0.0f)
+                        continue;
+
+                    float &pixel = tileLine[(x / OCCLUSION_TILE_WIDTH) * OCCLUSION_TILE_PIXELS + x % OCCLUSION_TILE_WIDTH];
+                    pixel = std::min(pixel, triangle.dzdx * px + triangle.dzdy * py + triangle.zC);
+                }
+#endif
+            }
+        }
+
+        for (int tx = 0; tx < OCCLUSION_TILES_X; tx++)
+        {
+            int tile = tileRow * OCCLUSION_TILES_X + tx;
+            const float *pixels = &depth[tile * OCCLUSION_TILE_PIXELS];
+            tileMax[tile] = *std::max_element(pixels, pixels + OCCLUSION_TILE_PIXELS);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,307 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <lib/constants.h>
+#include <lib/shader_s.h>
+#include <lib/mesh.h>
+#include <lib/stats.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// passes run in this order, each one sets its own state
+enum RenderPass : unsigned int
+{
+    RENDER_PASS_OPAQUE = 0,      // front to back (early z), writes stencil 1 where it draws
+    RENDER_PASS_OUTLINE = 1,     // no depth test, only where the opaque pass left stencil 0
+    RENDER_PASS_TRANSPARENT = 2, // back to front, blended, no depth writes
+};
+
+// one draw: a mesh heap draw (mesh + ranges set) or vertexCount vertices from vao
+struct RenderItem
+{
+    RenderPass pass = RENDER_PASS_OPAQUE;
+    Shader *shader = NULL;
+    Mesh *mesh = NULL;
+    const std::vector<GeometryRange> *ranges = NULL; // with mesh: what its placement has left (MeshDrawState::visible)
+    unsigned int vao = 0;
+    int vertexCount = 0;
+    glm::mat4 model = glm::mat4(1.0f);
+    glm::mat3 normalMat = glm::mat3(1.0f);
+    glm::vec3 color = glm::vec3(1.0f); // outlineColor, outline pass only
+    float depth = 0.0f;                // view space distance, what opaque / transparent get ordered by
+};
+
+// collects a frame's draws, sorts them by a 64 bit key and draws them with as few state changes as it can
+//
+//  opaque, outline  | pass 2 | program 12 | material 16 | vao 10 | depth 24 |   state first, then front to back
+//  transparent      | pass 2 | ~depth 24  | program 12 | material 16 | vao 10 |   strictly back to front
+//
+// program / material / vao are small ids handed out per frame (first come first served), a proxy of the uber shader counts as its
+// own program since its presets differ; neighbouring mesh draws with the same program, material and model matrix merge into one multi draw
+// ------------------------------------------------------------------------
+class RenderQueue
+{
+public:
+    // start of a frame, forgets every item
+    void Clear()
+    {
+        items.clear();
+        keys.clear();
+        programIds.clear();
+        vaoIds.clear();
+    }
+
+    void Submit(const RenderItem &item)
+    {
+        uint64_t program = id(programIds, (const void *)item.shader) & 0xFFF;
+        uint64_t material = materialOf(item) & 0xFFFF;
+        uint64_t vao = id(vaoIds, item.mesh ? 0u : item.vao) & 0x3FF;
+        uint64_t depth = (uint64_t)(glm::clamp(item.depth / (float)FAR_CLIP, 0.0f, 1.0f) * 0xFFFFFF);
+        uint64_t pass = (uint64_t)item.pass;
+
+        uint64_t key;
+        if (item.pass == RENDER_PASS_TRANSPARENT)
+            key = pass << 62 | (0xFFFFFF - depth) << 38 | program << 26 | material << 10 | vao;
+        else
+            key = pass << 62 | program << 50 | material << 34 | vao << 24 | depth;
+
+        keys.push_back(SortEntry{key, (unsigned int)items.size()});
+        items.push_back(item);
+    }
+
+    unsigned int Count() const
+    {
+        return (unsigned int)items.size();
+    }
+
+    // sorts and draws everything submitted since Clear(), into whatever framebuffer is bound
+    // program / texture switches get counted as drawn and as submission order would have had them
+    void Execute()
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        countUnsorted();
+        radixSort();
+        frameStats.renderQueueSortMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        Shader *bound = NULL;
+        unsigned int boundMaterial = 0;
+        int currentPass = -1;
+
+        for (unsigned int k = 0; k < keys.size(); k++)
+        {
+            RenderItem &item = items[keys[k].index];
+
+            if ((int)item.pass != currentPass)
+            {
+                flushBatch();
+                currentPass = item.pass;
+                passState(item.pass);
+            }
+
+            bool programChanged = item.shader != bound;
+            bool materialChanged = item.mesh && materialOf(item) != boundMaterial;
+
+            if (!batch.empty() && (programChanged || materialChanged || !(item.mesh && canMerge(item))))
+                flushBatch();
+
+            if (programChanged)
+            {
+                item.shader->use();
+                bound = item.shader;
+                frameStats.programSwitches++;
+            }
+
+            if (item.mesh)
+            {
+                // sampler uniforms belong to the program, they go out again after a program switch even if the textures are the same
+                if ((materialChanged || programChanged) && item.pass != RENDER_PASS_OUTLINE)
+                    item.mesh->BindTextures(item.shader);
+                frameStats.textureSwitches += materialChanged;
+                boundMaterial = materialOf(item);
+
+                if (batch.empty())
+                {
+                    setTransform(item);
+                    item.mesh->BindQuantization(item.shader);
+                    batchItem = &item;
+                }
+
+                const std::vector<GeometryRange> &visible = *item.ranges;
+                batch.insert(batch.end(), visible.begin(), visible.end());
+            }
+            else
+            {
+                setTransform(item);
+                glBindVertexArray(item.vao);
+                glDrawArrays(GL_TRIANGLES, 0, item.vertexCount);
+                frameStats.drawCalls++;
+            }
+        }
+        flushBatch();
+
+        passState(-1);
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    struct SortEntry
+    {
+        uint64_t key;
+        unsigned int index; // into items
+    };
+
+    std::vector<RenderItem> items;
+    std::vector<SortEntry> keys, scratch;
+    std::unordered_map<const void *, unsigned int> programIds;
+    std::unordered_map<unsigned int, unsigned int> vaoIds;
+    std::vector<GeometryRange> batch; // mesh ranges waiting for one multi draw
+    const RenderItem *batchItem = NULL;
+
+    // texture set the item binds, outlines don't sample any
+    static unsigned int materialOf(const RenderItem &item)
+    {
+        return item.mesh && item.pass != RENDER_PASS_OUTLINE ? item.mesh->MaterialId() : 0;
+    }
+
+    template <typename K>
+    static unsigned int id(std::unordered_map<K, unsigned int> &ids, K value)
+    {
+        return ids.emplace(value, (unsigned int)ids.size()).first->second;
+    }
+
+    // LSD radix sort, 8 bits per pass; a pass where every key has the same digit changes nothing and is skipped
+    void radixSort()
+    {
+        scratch.resize(keys.size());
+        for (int shift = 0; shift < 64; shift += 8)
+        {
+            unsigned int counts[256] = {0};
+            for (const SortEntry &entry : keys)
+                counts[(entry.key >> shift) & 0xFF]++;
+
+            if (counts[(keys.empty() ? 0 : keys[0].key >> shift) & 0xFF] == keys.size())
+                continue;
+
+            unsigned int offset = 0;
+            for (unsigned int &count : counts)
+            {
+                unsigned int c = count;
+                count = offset;
+                offset += c;
+            }
+
+            for (const SortEntry &entry : keys)
+                scratch[counts[(entry.key >> shift) & 0xFF]++] = entry;
+            keys.swap(scratch);
+        }
+    }
+
+    // same program, textures, quantization and placement as the batch: its ranges can join the multi draw
+    bool canMerge(const RenderItem &item) const
+    {
+        return batchItem && batchItem->mesh && batchItem->pass == item.pass && batchItem->model == item.model &&
+               batchItem->mesh->quantization == item.mesh->quantization;
+    }
+
+    void flushBatch()
+    {
+        if (batch.empty())
+            return;
+
+        MeshHeap().Bind();
+        MeshHeap().MultiDraw(batch.data(), (int)batch.size());
+        batch.clear();
+        batchItem = NULL;
+    }
+
+    static void setTransform(const RenderItem &item)
+    {
+        static const UniformHandle modelHandle = Shader::Uniform("model");
+        static const UniformHandle normalMatHandle = Shader::Uniform("normalMat");
+        static const UniformHandle outlineColorHandle = Shader::Uniform("outlineColor");
+
+        item.shader->set(modelHandle, item.model);
+        item.shader->set(normalMatHandle, item.normalMat);
+        if (item.pass == RENDER_PASS_OUTLINE)
+            item.shader->set(outlineColorHandle, item.color);
+    }
+
+    // state of a pass, -1 = back to the defaults everything else expects
+    static void passState(int pass)
+    {
+        if (pass == RENDER_PASS_OPAQUE)
+        {
+            glEnable(GL_STENCIL_TEST);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+            glStencilFunc(GL_ALWAYS, 1, 0xFF);
+            glStencilMask(0xFF);
+        }
+        else if (pass == RENDER_PASS_OUTLINE)
+        {
+            glEnable(GL_STENCIL_TEST);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+            glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
+            glStencilMask(0x00);
+        }
+        else
+        {
+            glDisable(GL_STENCIL_TEST);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+            glStencilFunc(GL_ALWAYS, 0, 0xFF);
+            glStencilMask(0xFF);
+        }
+
+        if (pass == RENDER_PASS_OUTLINE)
+        {
+            glDisable(GL_DEPTH_TEST);
+            glDisable(GL_CULL_FACE);
+        }
+        else
+        {
+            glEnable(GL_DEPTH_TEST);
+            glEnable(GL_CULL_FACE);
+        }
+
+        if (pass == RENDER_PASS_TRANSPARENT)
+        {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask(GL_FALSE);
+        }
+        else
+        {
+            glDisable(GL_BLEND);
+            glDepthMask(GL_TRUE);
+        }
+    }
+
+    // the switches drawing in submission order would cost, the A/B number for the sort
+    void countUnsorted() const
+    {
+        const Shader *shader = NULL;
+        unsigned int material = 0;
+        for (const RenderItem &item : items)
+        {
+            frameStats.programSwitchesUnsorted += item.shader != shader;
+            shader = item.shader;
+
+            if (item.mesh && materialOf(item) != material)
+            {
+                frameStats.textureSwitchesUnsorted++;
+                material = materialOf(item);
+            }
+        }
+    }
+};
+
+#endif
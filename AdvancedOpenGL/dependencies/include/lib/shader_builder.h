@@ -0,0 +1,141 @@
+#ifndef SHADER_BUILDER_H
+#define SHADER_BUILDER_H
+
+#include <lib/shader_s.h>
+
+#include <string>
+#include <vector>
+
+// collects defines, includes and source fragments, then compiles + links exactly once in build()
+// ------------------------------------------------------------------------
+//  Shader lit = ShaderBuilder("lit.vs", "lit.fs")
+//                   .define(1, "NR_POINT", 4)
+//                   .include(1, "common.glsl")
+//                   .build();
+class ShaderBuilder
+{
+public:
+    // fragmentPath may be NULL for a transform feedback only program, geometryPath is optional
+    ShaderBuilder(const char *vertexPath, const char *fragmentPath, const char *geometryPath = NULL)
+    {
+        stages[0].path = vertexPath;
+        stages[1].path = fragmentPath;
+        stages[2].path = geometryPath;
+    }
+
+    /// @param whichShader 0 for vertex shader, 1 for fragment shader, 2 for geometry shader
+    ShaderBuilder &directive(int whichShader, const std::string &directive)
+    {
+        stage(whichShader).header += directive + '\n';
+        return *this;
+    }
+
+    ShaderBuilder &define(int whichShader, const std::string &name)
+    {
+        return directive(whichShader, "#define " + name);
+    }
+    ShaderBuilder &define(int whichShader, const std::string &name, const std::string &value)
+    {
+        return directive(whichShader, "#define " + name + " " + value);
+    }
+    ShaderBuilder &define(int whichShader, const std::string &name, int value)
+    {
+        return define(whichShader, name, std::to_string(value));
+    }
+    ShaderBuilder &define(int whichShader, const std::string &name, double value)
+    {
+        return define(whichShader, name, std::to_string(value));
+    }
+
+    // file contents go after the defines, before the shader body
+    ShaderBuilder &include(int whichShader, const char *path)
+    {
+        stage(whichShader).includes += Shader::ReadSource(path) + '\n';
+        return *this;
+    }
+
+    // source appended after the shader body
+    ShaderBuilder &append(int whichShader, const std::string &source)
+    {
+        stage(whichShader).footer += source + '\n';
+        return *this;
+    }
+
+    // outputs of the last stage before the rasterizer that transform feedback captures, interleaved in this order
+    ShaderBuilder &feedback(std::vector<std::string> varyings)
+    {
+        feedbackVaryings = std::move(varyings);
+        return *this;
+    }
+
+    Shader build()
+    {
+        std::string vertexCode = stages[0].assemble();
+        std::string fragmentCode = stages[1].assemble();
+        std::string geometryCode = stages[2].assemble();
+        std::vector<std::string> varyings = std::move(feedbackVaryings);
+        clear();
+
+        return Shader::FromSource(std::move(vertexCode), std::move(fragmentCode), std::move(geometryCode), std::move(varyings));
+    }
+
+    // returns before the driver is done, see Shader::isReady() (vertex + fragment only)
+    Shader buildAsync()
+    {
+        std::string vertexCode = stages[0].assemble();
+        std::string fragmentCode = stages[1].assemble();
+        clear();
+
+        return Shader::FromSourceAsync(std::move(vertexCode), std::move(fragmentCode));
+    }
+
+private:
+    // the builder is usually a temporary, but drop the pieces early anyway
+    void clear()
+    {
+        stages[0] = Stage{stages[0].path};
+        stages[1] = Stage{stages[1].path};
+        stages[2] = Stage{stages[2].path};
+        feedbackVaryings.clear();
+    }
+
+    struct Stage
+    {
+        const char *path;
+        std::string header;
+        std::string includes;
+        std::string footer;
+
+        std::string assemble() const
+        {
+            if (!path)
+                return "";
+
+            std::string body = Shader::ReadSource(path);
+
+            // #version has to stay the first line
+            size_t versionEnd = body.find('\n') + 1;
+
+            std::string code;
+            code.reserve(body.size() + header.size() + includes.size() + footer.size() + 16);
+            code.append(body, 0, versionEnd);
+            code += header;
+            code += includes;
+            code += "#line 2\n"; // keep compiler error line numbers matching the file
+            code.append(body, versionEnd, std::string::npos);
+            code += '\n';
+            code += footer;
+            return code;
+        }
+    };
+
+    Stage stages[3];
+    std::vector<std::string> feedbackVaryings;
+
+    Stage &stage(int whichShader)
+    {
+        return stages[whichShader == 2 ? 2 : whichShader != 0];
+    }
+};
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <glad/glad.h>
+
+#include <lib/gl_extensions.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// on-disk cache of linked programs (glGetProgramBinary output)
+// files are keyed by a hash of the final sources + the driver strings, a rejected binary is deleted and recompiled
+class ProgramCache
+{
+public:
+    inline static std::string directory = "cache/shaders";
+
+    // startup bookkeeping, printed by main
+    inline static unsigned int hits = 0;
+    inline static unsigned int misses = 0;
+
+    static uint64_t Key(const std::string &vertexCode, const std::string &fragmentCode)
+    {
+        uint64_t hash = FNV_OFFSET;
+        hash = fnv1a(hash, vertexCode.data(), vertexCode.size());
+        hash = fnv1a(hash, "\0", 1); // so moving text between the two stages changes the key
+        hash = fnv1a(hash, fragmentCode.data(), fragmentCode.size());
+
+        // binaries are only valid for the exact driver that produced them
+        const GLenum driverStrings[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+        for (GLenum name : driverStrings)
+        {
+            const char *str = (const char *)glGetString(name);
+            if (str)
+                hash = fnv1a(hash, str, std::strlen(str));
+        }
+        return hash;
+    }
+
+    // returns true if program is now linked from the cached binary
+    static bool Load(unsigned int program, uint64_t key)
+    {
+        if (!glExt.programBinary)
+            return false;
+
+        std::ifstream file(path(key), std::ios::binary);
+        if (!file)
+        {
+            misses++;
+            return false;
+        }
+
+        Header header;
+        file.read((char *)&header, sizeof(header));
+        std::vector<char> binary(file ? header.length : 0);
+        file.read(binary.data(), binary.size());
+
+        if (!file || header.magic != MAGIC || header.version != VERSION || header.key != key)
+        {
+            misses++;
+            return false;
+        }
+
+        glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+
+        int success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) // driver update, different GPU, ...
+        {
+            std::cout << "ProgramCache: binary rejected, recompiling " << path(key) << std::endl;
+            file.close();
+            std::filesystem::remove(path(key));
+            misses++;
+            return false;
+        }
+
+        hits++;
+        return true;
+    }
+
+    // program must be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+    static void Store(unsigned int program, uint64_t key)
+    {
+        if (!glExt.programBinary)
+            return;
+
+        int length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+
+        Header header;
+        header.key = key;
+        std::vector<char> binary(length);
+        glGetProgramBinary(program, length, &length, &header.format, binary.data());
+        header.length = (uint32_t)length;
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+
+        std::ofstream file(path(key), std::ios::binary | std::ios::trunc);
+        file.write((const char *)&header, sizeof(header));
+        file.write(binary.data(), length);
+        if (!file)
+            std::cout << "ProgramCache: could not write " << path(key) << std::endl;
+    }
+
+private:
+    static constexpr uint32_t MAGIC = 0x4E494250; // "PBIN"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+    static constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+    struct Header
+    {
+        uint32_t magic = MAGIC;
+        uint32_t version = VERSION;
+        uint64_t key = 0;
+        GLenum format = 0;
+        uint32_t length = 0;
+    };
+
+    static uint64_t fnv1a(uint64_t hash, const char *data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= (unsigned char)data[i];
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+
+    static std::string path(uint64_t key)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return directory + "/" + name;
+    }
+};
+
+#endif
@@ -0,0 +1,238 @@
+#ifndef SHADER_PERMUTATIONS_H
+#define SHADER_PERMUTATIONS_H
+
+#include <lib/shader_s.h>
+#include <lib/shader_builder.h>
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// feature bits of a shader variant, every set bit turns into a #define in the fragment shader (QUANTIZED / INSTANCED / UBER in the vertex shader)
+enum ShaderFeature : unsigned int
+{
+    FEATURE_TEXTURED = 1 << 0,   // TEXTURED, samples albedo + specular maps instead of basicMaterial
+    FEATURE_NORMAL_MAP = 1 << 1, // NORMAL_MAP, samples the normal map (only together with FEATURE_TEXTURED)
+    FEATURE_OUTLINE = 1 << 2,    // OUTLINE, flat outlineColor, no lighting at all
+    FEATURE_UBER = 1 << 9,       // UBER, every feature as a runtime switch, the fallback while variants compile
+    FEATURE_CLUSTERED = 1 << 10, // CLUSTERED, point + spot lights from the cluster lists (clusters.h), their buckets are ignored
+    FEATURE_QUANTIZED = 1 << 11, // QUANTIZED, vertices are PackedVertex (vertex_packing.h), a property of the mesh, not the scene
+    FEATURE_INSTANCED = 1 << 12, // INSTANCED, model + normal matrix per instance from attributes (instancing.h) instead of uniforms
+
+    FEATURE_MATERIAL_MASK = FEATURE_TEXTURED | FEATURE_NORMAL_MAP,
+
+    // light counts are stored as 2 bit bucket indices, see LIGHT_BUCKETS
+    FEATURE_POINT_SHIFT = 3,
+    FEATURE_DIR_SHIFT = 5,
+    FEATURE_SPOT_SHIFT = 7,
+};
+
+// loop bound the shader gets compiled with for each bucket, the last one is everything LightData can hold
+const int LIGHT_BUCKETS[4] = {0, 1, 4, MAX_POINT_LIGHTS};
+
+inline unsigned int LightBucket(int count)
+{
+    unsigned int bucket = 0;
+    while (bucket < 3 && LIGHT_BUCKETS[bucket] < count)
+        bucket++;
+    return bucket;
+}
+
+// bits describing the active light set, round up to the nearest bucket
+inline unsigned int LightFeatures(int pointLights, int dirLights, int spotLights)
+{
+    return LightBucket(pointLights) << FEATURE_POINT_SHIFT |
+           LightBucket(dirLights) << FEATURE_DIR_SHIFT |
+           LightBucket(spotLights) << FEATURE_SPOT_SHIFT;
+}
+
+// variant for a material: keep what the material has out of what the scene allows
+// the vertex format always comes from the mesh, whatever the scene allows
+inline unsigned int MatchFeatures(unsigned int materialFeatures, unsigned int allowed)
+{
+    unsigned int material = allowed & materialFeatures & FEATURE_MATERIAL_MASK;
+    if (!(material & FEATURE_TEXTURED))
+        material = 0;
+    return (allowed & ~(FEATURE_MATERIAL_MASK | FEATURE_QUANTIZED)) | material | (materialFeatures & FEATURE_QUANTIZED);
+}
+
+// compiles specialized variants of one vertex / fragment pair on demand and caches them by feature bits
+// variants compile in the background, until one is linked Get() hands out the uber shader instead
+class ShaderPermutations
+{
+public:
+    // runs once for every freshly compiled variant (static uniforms: lights, materials ...)
+    std::function<void(Shader &)> onCompile;
+
+    ShaderPermutations(const char *vertexPath, const char *fragmentPath) : vertexPath(vertexPath), fragmentPath(fragmentPath)
+    {
+    }
+
+    // defines shared by all variants
+    /// @param whichShader 0 for vertex shader, 1 for fragment shader
+    template <typename T>
+    ShaderPermutations &define(int whichShader, const std::string &name, T value)
+    {
+        defines.push_back({whichShader, name + " " + toString(value)});
+        return *this;
+    }
+
+    // shared source, goes into every variant after the defines (see ShaderBuilder::include)
+    ShaderPermutations &include(int whichShader, const std::string &path)
+    {
+        includes.push_back({whichShader, path});
+        return *this;
+    }
+
+    // starts compiling a variant without waiting for it
+    void Prepare(unsigned int features)
+    {
+        submitted(features);
+    }
+
+    // the variant if it is linked, otherwise a stand-in using the uber shader (switches applied on use())
+    Shader *Get(unsigned int features)
+    {
+        Variant &variant = submitted(features);
+        if (variant.ready)
+            return &variant.shader;
+
+        return fallback(features);
+    }
+
+    // call once per frame, before per-frame uniforms go out: picks up variants the driver finished
+    void Poll()
+    {
+        for (auto &variant : variants)
+        {
+            if (!variant.second.ready && variant.second.shader.isReady())
+                promote(variant.second);
+        }
+    }
+
+    // for uniforms every linked variant needs (camera, ...)
+    void ForEach(const std::function<void(Shader &)> &fn)
+    {
+        for (auto &variant : variants)
+        {
+            if (variant.second.ready)
+                fn(variant.second.shader);
+        }
+    }
+
+    unsigned int Count() const
+    {
+        return (unsigned int)variants.size();
+    }
+
+    void del()
+    {
+        for (auto &variant : variants)
+            variant.second.shader.del();
+        variants.clear();
+        fallbacks.clear();
+    }
+
+private:
+    struct Variant
+    {
+        Shader shader;
+        bool ready; // linked and onCompile has run
+    };
+
+    const char *vertexPath;
+    const char *fragmentPath;
+    std::vector<std::pair<int, std::string>> defines;
+    std::vector<std::pair<int, std::string>> includes;
+    std::unordered_map<unsigned int, Variant> variants; // node based, pointers stay valid
+    std::unordered_map<unsigned int, Shader> fallbacks; // uber proxies, they don't own their program
+
+    Variant &submitted(unsigned int features)
+    {
+        auto it = variants.find(features);
+        if (it != variants.end())
+            return it->second;
+
+        ShaderBuilder builder(vertexPath, fragmentPath);
+        for (auto &define : defines)
+            builder.define(define.first, define.second);
+        for (auto &include : includes)
+            builder.include(include.first, include.second.c_str());
+
+        unsigned int compiled = features;
+        if (features & FEATURE_UBER)
+        {
+            // every switch at runtime, loops run to the LightData counts
+            builder.define(0, "UBER");
+            builder.define(1, "UBER");
+            compiled = 3u << FEATURE_POINT_SHIFT | 3u << FEATURE_DIR_SHIFT | 3u << FEATURE_SPOT_SHIFT;
+        }
+        if (compiled & FEATURE_TEXTURED)
+            builder.define(1, "TEXTURED");
+        if (compiled & FEATURE_NORMAL_MAP)
+            builder.define(1, "NORMAL_MAP");
+        if (compiled & FEATURE_OUTLINE)
+            builder.define(1, "OUTLINE");
+        if (compiled & FEATURE_CLUSTERED)
+            builder.define(1, "CLUSTERED");
+        if (compiled & FEATURE_QUANTIZED)
+            builder.define(0, "QUANTIZED");
+        if (compiled & FEATURE_INSTANCED)
+            builder.define(0, "INSTANCED");
+        builder.define(1, "NR_POINT", LIGHT_BUCKETS[(compiled >> FEATURE_POINT_SHIFT) & 3]);
+        builder.define(1, "NR_DIR", LIGHT_BUCKETS[(compiled >> FEATURE_DIR_SHIFT) & 3]);
+        builder.define(1, "NR_SPOT", LIGHT_BUCKETS[(compiled >> FEATURE_SPOT_SHIFT) & 3]);
+
+        return variants.emplace(features, Variant{builder.buildAsync(), false}).first->second;
+    }
+
+    void promote(Variant &variant)
+    {
+        variant.ready = true;
+        if (onCompile)
+        {
+            variant.shader.use();
+            onCompile(variant.shader);
+        }
+    }
+
+    // one Shader per requested feature set, all sharing the uber program with different presets
+    Shader *fallback(unsigned int features)
+    {
+        static const UniformHandle useTexturesHandle = Shader::Uniform("useTextures");
+        static const UniformHandle useNormalMapHandle = Shader::Uniform("useNormalMap");
+        static const UniformHandle useOutlineHandle = Shader::Uniform("useOutline");
+        static const UniformHandle useClustersHandle = Shader::Uniform("useClusters");
+        static const UniformHandle useQuantizedHandle = Shader::Uniform("useQuantized");
+        static const UniformHandle useInstancedHandle = Shader::Uniform("useInstanced");
+
+        frameStats.uberLookups++;
+
+        auto it = fallbacks.find(features);
+        if (it != fallbacks.end())
+            return &it->second;
+
+        Variant &uber = submitted(FEATURE_UBER);
+        if (!uber.ready) // nothing to fall back to, wait for it
+            promote(uber);
+
+        Shader proxy = uber.shader;
+        proxy.presets = {{useTexturesHandle, (features & FEATURE_TEXTURED) != 0},
+                         {useNormalMapHandle, (features & FEATURE_NORMAL_MAP) != 0},
+                         {useOutlineHandle, (features & FEATURE_OUTLINE) != 0},
+                         {useClustersHandle, (features & FEATURE_CLUSTERED) != 0},
+                         {useQuantizedHandle, (features & FEATURE_QUANTIZED) != 0},
+                         {useInstancedHandle, (features & FEATURE_INSTANCED) != 0}};
+
+        return &fallbacks.emplace(features, proxy).first->second;
+    }
+
+    static std::string toString(const std::string &value) { return value; }
+    static std::string toString(const char *value) { return value; }
+    template <typename T>
+    static std::string toString(T value) { return std::to_string(value); }
+};
+
+#endif
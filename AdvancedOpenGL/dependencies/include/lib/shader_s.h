@@ -4,10 +4,20 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <lib/constants.h>
+#include <lib/stats.h>
+#include <lib/gl_extensions.h>
+#include <lib/shader_cache.h>
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <unordered_map>
+
+// index into the process-wide uniform name table, see Shader::Uniform()
+typedef unsigned int UniformHandle;
 
 class Shader
 {
@@ -18,116 +28,329 @@ public:
     Shader(const char *vertexPath, const char *fragmentPath)
     {
         // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
+        vShaderCode = ReadSource(vertexPath);
+        fShaderCode = ReadSource(fragmentPath);
+
+        // 2. compile shaders
+        ID = compileAndLink(vShaderCode.c_str(), fShaderCode.c_str());
+    }
+
+    // compiles already preprocessed sources, see ShaderBuilder
+    // ------------------------------------------------------------------------
+    // geometry stage and transform feedback are optional, with feedbackVaryings captured interleaved (fragmentCode may be empty then)
+    static Shader FromSource(std::string vertexCode, std::string fragmentCode, std::string geometryCode = "",
+                             std::vector<std::string> feedbackVaryings = {})
+    {
+        Shader shader;
+        shader.vShaderCode = std::move(vertexCode);
+        shader.fShaderCode = std::move(fragmentCode);
+        shader.gShaderCode = std::move(geometryCode);
+        shader.feedbackVaryings = std::move(feedbackVaryings);
+        shader.ID = shader.compileAndLink(shader.vShaderCode.c_str(), shader.fShaderCode.c_str());
+        return shader;
+    }
+
+    // same, but only hands the sources to the driver and returns right away
+    // link errors are checked once isReady() reports completion, or on the first use()
+    // ------------------------------------------------------------------------
+    static Shader FromSourceAsync(std::string vertexCode, std::string fragmentCode)
+    {
+        Shader shader;
+        shader.vShaderCode = std::move(vertexCode);
+        shader.fShaderCode = std::move(fragmentCode);
+        shader.submit(shader.vShaderCode.c_str(), shader.fShaderCode.c_str());
+        return shader;
+    }
+
+    // never blocks when the driver has KHR_parallel_shader_compile, otherwise finishes the link right here
+    // ------------------------------------------------------------------------
+    bool isReady()
+    {
+        if (!pending)
+            return true;
+
+        if (glExt.parallelShaderCompile)
+        {
+            int done = 0;
+            glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+            if (!done)
+                return false;
+        }
+
+        finish();
+        return true;
+    }
+
+    // ------------------------------------------------------------------------
+    static std::string ReadSource(const char *path)
+    {
+        std::ifstream shaderFile;
         // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
         try
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            shaderFile.open(path);
+            std::stringstream shaderStream;
+            shaderStream << shaderFile.rdbuf();
+            shaderFile.close();
+            return shaderStream.str();
         }
         catch (std::ifstream::failure &e)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << " " << e.what() << std::endl;
         }
-
-        vShaderCode = unconstchar(vertexCode.c_str());
-        fShaderCode = unconstchar(fragmentCode.c_str());
-        // 2. compile shaders
-
-        ID = compileAndLink(vShaderCode, fShaderCode);
+        return "";
     }
 
     // insert directives
     // ------------------------------------------------------------------------
 
+    // ! relinks the whole program on every call, prefer ShaderBuilder when setting up several directives
     /// @param whichShader 0 for vertex shader, 1 for fragment shader
     void insertDirective(int whichShader, std::string directive)
     {
-        if (!whichShader) // vertex shader
-        {
-            std::string s = std::string(vShaderCode);
-
-            std::string version = s.substr(0, s.find('\n')) + '\n';
-            std::string rest = s.substr(s.find('\n'));
-            std::string vertexCode = version + directive + '\n' + rest;
-            vShaderCode = unconstchar(vertexCode.c_str());
-        }
-        else // fragment shader
-        {
-            std::string s = std::string(fShaderCode);
+        std::string &code = !whichShader ? vShaderCode : fShaderCode;
 
-            std::string version = s.substr(0, s.find('\n')) + '\n';
-            std::string rest = s.substr(s.find('\n'));
-            std::string fragmentCode = version + directive + '\n' + rest;
-            fShaderCode = unconstchar(fragmentCode.c_str());
-        }
+        size_t versionEnd = code.find('\n') + 1;
+        code.insert(versionEnd, directive + '\n');
 
-        ID = compileAndLink(vShaderCode, fShaderCode);
+        del(); // the old program is replaced, not leaked
+        ID = compileAndLink(vShaderCode.c_str(), fShaderCode.c_str());
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use()
     {
+        if (pending) // blocks until the driver is done
+            finish();
         glUseProgram(ID);
+
+        for (auto &preset : presets)
+            glUniform1i(location(preset.first), preset.second);
     }
+
+    // int uniforms re-applied on every use(), lets several Shader objects share one program with different switches
+    std::vector<std::pair<UniformHandle, int>> presets;
     // ------------------------------------------------------------------------
     void del()
     {
+        if (pending)
+        {
+            glDeleteShader(pendingVertex);
+            glDeleteShader(pendingFragment);
+            glDeleteShader(pendingGeometry);
+            pending = false;
+        }
         glDeleteProgram(ID);
     }
 
-    // utility uniform functions
+    // handle based uniform functions (hot path, one array lookup per call)
+    // ------------------------------------------------------------------------
+
+    // interns a uniform name, the handle is valid for every Shader (resolve once, e.g. into a static)
+    static UniformHandle Uniform(const std::string &name)
+    {
+        auto it = handleTable.find(name);
+        if (it != handleTable.end())
+            return it->second;
+
+        UniformHandle handle = (UniformHandle)handleNames.size();
+        handleNames.push_back(name);
+        handleTable[name] = handle;
+        return handle;
+    }
+    // ------------------------------------------------------------------------
+    void set(UniformHandle handle, bool value) const
+    {
+        glUniform1i(location(handle), (int)value);
+    }
+    void set(UniformHandle handle, int value) const
+    {
+        glUniform1i(location(handle), value);
+    }
+    void set(UniformHandle handle, float value) const
+    {
+        glUniform1f(location(handle), value);
+    }
+    void set(UniformHandle handle, const glm::vec3 &value) const
+    {
+        glUniform3fv(location(handle), 1, &value[0]);
+    }
+    void set(UniformHandle handle, const glm::vec4 &value) const
+    {
+        glUniform4fv(location(handle), 1, &value[0]);
+    }
+    void set(UniformHandle handle, const glm::mat3 &value) const
+    {
+        glUniformMatrix3fv(location(handle), 1, GL_FALSE, &value[0][0]);
+    }
+    void set(UniformHandle handle, const glm::mat4 &value) const
+    {
+        glUniformMatrix4fv(location(handle), 1, GL_FALSE, &value[0][0]);
+    }
+
+    // utility uniform functions (name based, every call hashes the name)
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(location(name), (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(location(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(location(name), value);
     }
     void setVec3(const std::string &name, float *value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, value);
+        glUniform3fv(location(name), 1, value);
     }
     void setMat4(const std::string &name, float *value) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, value);
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, value);
     }
     void setMat3(const std::string &name, float *value) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, value);
+        glUniformMatrix3fv(location(name), 1, GL_FALSE, value);
     }
     // void setMat4(const std::string &name, const glm::mat4 &mat) const
     // {
     //     glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
     // }
 
+    // number of programs built so far (compiled + linked, or loaded from the binary cache)
+    inline static unsigned int buildCount = 0;
+
 private:
-    char *vShaderCode;
-    char *fShaderCode;
+    std::string vShaderCode;
+    std::string fShaderCode;
+    std::string gShaderCode;                   // optional
+    std::vector<std::string> feedbackVaryings; // set before linking, they can't change afterwards
+
+    // set between submit() and finish()
+    bool pending = false;
+    unsigned int pendingVertex = 0, pendingFragment = 0, pendingGeometry = 0;
+    uint64_t pendingCacheKey = 0;
+
+    Shader() : ID(0) {}
+
+    // name -> location of every active uniform, filled once after linking
+    std::unordered_map<std::string, int> uniformTable;
+    // handle -> location, grows lazily when a handle is used for the first time on this program
+    mutable std::vector<int> handleLocations;
+
+    inline static std::unordered_map<std::string, UniformHandle> handleTable;
+    inline static std::vector<std::string> handleNames;
+
+    int location(const std::string &name) const
+    {
+        frameStats.uniformNameLookups++;
+
+        auto it = uniformTable.find(name);
+        return it != uniformTable.end() ? it->second : -1; // -1 is silently ignored by glUniform*, same as an inactive uniform
+    }
+
+    int location(UniformHandle handle) const
+    {
+        if (handle >= handleLocations.size())
+            resolveHandles();
+        return handleLocations[handle];
+    }
+
+    void resolveHandles() const
+    {
+        size_t resolved = handleLocations.size();
+        handleLocations.resize(handleNames.size());
+        for (size_t i = resolved; i < handleNames.size(); i++)
+        {
+            auto it = uniformTable.find(handleNames[i]);
+            handleLocations[i] = it != uniformTable.end() ? it->second : -1;
+        }
+    }
+
+    // uniform blocks shared between programs live at fixed binding points (GLSL 330 has no layout(binding))
+    // ------------------------------------------------------------------------
+    void bindUniformBlocks()
+    {
+        const std::pair<const char *, unsigned int> blocks[] = {
+            {"FrameData", FRAME_DATA_BINDING},
+            {"LightData", LIGHT_DATA_BINDING},
+        };
+
+        for (auto &block : blocks)
+        {
+            unsigned int index = glGetUniformBlockIndex(ID, block.first);
+            if (index != GL_INVALID_INDEX)
+                glUniformBlockBinding(ID, index, block.second);
+        }
+    }
+
+    // same for textures bound once per frame for every program (cluster lists ...), their units are fixed too
+    // ! has to happen at link time, a sampler left on unit 0 next to a sampler2D fails every draw
+    // ------------------------------------------------------------------------
+    void bindSharedSamplers()
+    {
+        const std::pair<const char *, int> samplers[] = {
+            {"clusterGrid", CLUSTER_GRID_UNIT},
+            {"clusterLights", CLUSTER_INDEX_UNIT},
+        };
+
+        int previous;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+        glUseProgram(ID);
+
+        for (auto &sampler : samplers)
+        {
+            auto it = uniformTable.find(sampler.first);
+            if (it != uniformTable.end())
+                glUniform1i(it->second, sampler.second);
+        }
+
+        glUseProgram(previous);
+    }
+
+    // enumerates the active uniforms once, this is the only place glGetUniformLocation gets called
+    // ------------------------------------------------------------------------
+    void buildUniformTable()
+    {
+        uniformTable.clear();
+        handleLocations.clear();
+
+        int count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::vector<char> nameBuffer(maxLength + 1);
+        for (int i = 0; i < count; i++)
+        {
+            int length = 0, size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+
+            std::string name(nameBuffer.data(), length);
+            int loc = glGetUniformLocation(ID, name.c_str());
+            if (loc < 0) // uniform block member
+                continue;
+
+            uniformTable[name] = loc;
+
+            // arrays of basic types are reported once as "name[0]", register every element
+            if (size > 1 && name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = name.substr(0, name.size() - 3);
+                uniformTable[base] = loc;
+                for (int j = 1; j < size; j++)
+                {
+                    std::string element = base + "[" + std::to_string(j) + "]";
+                    uniformTable[element] = glGetUniformLocation(ID, element.c_str());
+                }
+            }
+        }
+    }
 
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
@@ -160,52 +383,107 @@ private:
 
     int compileAndLink(const char *vShaderCode, const char *fShaderCode)
     {
-        unsigned int vertex, fragment;
+        submit(vShaderCode, fShaderCode);
+        if (pending)
+            finish();
+        return ID;
+    }
+
+    // starts compiling + linking without asking for any status, so the driver is free to do it in the background
+    void submit(const char *vShaderCode, const char *fShaderCode)
+    {
+        buildCount++;
+
+        // try the binary cache first, a hit skips compiling entirely
+        uint64_t cacheKey = 0;
+        if (glExt.programBinary)
+        {
+            // the optional parts go with the fragment stage, a program that has them never shares a key with one that doesn't
+            std::string linkExtras = gShaderCode;
+            for (const std::string &varying : feedbackVaryings)
+                linkExtras += "\n// feedback " + varying;
+            cacheKey = ProgramCache::Key(vShaderCode, linkExtras.empty() ? std::string(fShaderCode) : fShaderCode + linkExtras);
+
+            ID = glCreateProgram();
+            if (ProgramCache::Load(ID, cacheKey))
+            {
+                buildUniformTable();
+                bindUniformBlocks();
+                bindSharedSamplers();
+                return;
+            }
+            glDeleteProgram(ID);
+        }
+
+        unsigned int vertex, fragment = 0, geometry = 0;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vShaderCode, NULL);
         glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
+        // fragment Shader (none: transform feedback only)
+        if (*fShaderCode)
+        {
+            fragment = glCreateShader(GL_FRAGMENT_SHADER);
+            glShaderSource(fragment, 1, &fShaderCode, NULL);
+            glCompileShader(fragment);
+        }
+        // geometry shader
+        if (!gShaderCode.empty())
+        {
+            const char *gCode = gShaderCode.c_str();
+            geometry = glCreateShader(GL_GEOMETRY_SHADER);
+            glShaderSource(geometry, 1, &gCode, NULL);
+            glCompileShader(geometry);
+        }
         // shader Program
         ID = glCreateProgram();
         glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
+        if (fragment)
+            glAttachShader(ID, fragment);
+        if (geometry)
+            glAttachShader(ID, geometry);
+        if (!feedbackVaryings.empty())
+        {
+            std::vector<const char *> names;
+            for (const std::string &varying : feedbackVaryings)
+                names.push_back(varying.c_str());
+            glTransformFeedbackVaryings(ID, (GLsizei)names.size(), names.data(), GL_INTERLEAVED_ATTRIBS);
+        }
+        if (glExt.programBinary)
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
 
-        return ID;
+        pending = true;
+        pendingVertex = vertex;
+        pendingFragment = fragment;
+        pendingGeometry = geometry;
+        pendingCacheKey = cacheKey;
     }
 
-    // ! really sus function to convert from const char* to char*
-    char *unconstchar(const char *s)
+    // the status queries in here block until the driver is done with the program
+    void finish()
     {
-        if (!s)
-            return NULL;
-        int i;
-        char *res = NULL;
-        res = (char *)malloc(strlen(s) + 1);
-        if (!res)
-        {
-            fprintf(stderr, "Memory Allocation Failed! Exiting...\n");
-            exit(EXIT_FAILURE);
-        }
-        else
-        {
-            for (i = 0; s[i] != '\0'; i++)
-            {
-                res[i] = s[i];
-            }
-            res[i] = '\0';
-            return res;
-        }
+        pending = false;
+
+        checkCompileErrors(pendingVertex, "VERTEX");
+        if (pendingFragment)
+            checkCompileErrors(pendingFragment, "FRAGMENT");
+        if (pendingGeometry)
+            checkCompileErrors(pendingGeometry, "GEOMETRY");
+        checkCompileErrors(ID, "PROGRAM");
+        // delete the shaders as they're linked into our program now and no longer necessary
+        glDeleteShader(pendingVertex);
+        glDeleteShader(pendingFragment);
+        glDeleteShader(pendingGeometry);
+
+        int linked;
+        glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+        if (linked && glExt.programBinary)
+            ProgramCache::Store(ID, pendingCacheKey);
+
+        buildUniformTable();
+        bindUniformBlocks();
+        bindSharedSamplers();
     }
 };
 #endif
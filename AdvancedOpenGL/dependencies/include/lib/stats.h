@@ -0,0 +1,66 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <iostream>
+
+// per-frame counters, reset by main after every frame
+struct FrameStats
+{
+    unsigned int uniformNameLookups = 0; // name based uniform sets left (each one hashes a string instead of using a handle)
+    unsigned int uberLookups = 0;        // Get() calls answered with the uber shader while the variant was compiling (lookups, not draws)
+    unsigned int lightUploads = 0;       // glBufferSubData calls into the LightData block
+    unsigned int lightBytesUploaded = 0;
+    unsigned int clusterLightRefs = 0;   // light indices written into the cluster lists
+    float clusterMs = 0.0f;              // CPU time of the cluster assignment + upload
+    unsigned int lightVolumes = 0;       // deferred light volumes drawn
+    float gpuMs = 0.0f;                  // GPU time of the frame (gpu_timer.h), a few frames late
+    unsigned int multiDraws = 0;         // glMultiDrawElementsBaseVertex calls (geometry_heap.h), each replacing several draws
+    unsigned int drawCalls = 0;          // draws out of the mesh heap + instanced draws (instancing.h), a multi draw counts once
+    unsigned int instancesDrawn = 0;     // placements drawn by instanced draws, each one would be a draw call of its own otherwise
+    unsigned int programSwitches = 0;    // glUseProgram / texture set changes of the render queue (render_queue.h), as drawn (sorted)
+    unsigned int textureSwitches = 0;
+    unsigned int programSwitchesUnsorted = 0; // the same in submission order, what drawing without the sort would cost
+    unsigned int textureSwitchesUnsorted = 0;
+    float renderQueueSortMs = 0.0f;      // CPU time of the key sort
+    unsigned int triangles = 0;          // triangles drawn from the mesh heap, mesh LODs bring it down with distance
+    unsigned int objectsDrawn = 0;       // meshes / cubes / light gizmos inside the view frustum (culling.h), only counted where culling runs
+    unsigned int objectsCulled = 0;
+    unsigned int occluderTriangles = 0;  // rasterized into the CPU depth buffer (occlusion.h)
+    unsigned int occlusionTested = 0;    // boxes tested against it, the frustum culled ones aren't
+    unsigned int occlusionCulled = 0;
+    float occlusionMs = 0.0f;            // CPU time of the whole occlusion pass, rasterization + tests
+    unsigned int gpuInstancesDrawn = 0;  // instances left by the GPU culling pass (gpu_culling.h), counted by a query
+    unsigned int gpuInstancesCulled = 0;
+    unsigned int meshletsDrawn = 0;      // meshlets that passed the CPU frustum + cone test (mesh.h CullMeshlets)
+    unsigned int meshletsCulled = 0;
+    unsigned int textureBytesStreamed = 0; // texture_streamer.h uploads, capped by TEXTURE_UPLOAD_BUDGET
+    unsigned int textureStalls = 0;      // streamer frames that stopped early, every upload buffer still in use by the GPU
+
+    void Reset()
+    {
+        *this = FrameStats();
+    }
+
+    void Print()
+    {
+        std::cout << "uniform name lookups: " << uniformNameLookups
+                  << " | uber fallback lookups: " << uberLookups
+                  << " | light uploads: " << lightUploads << " (" << lightBytesUploaded << " bytes)"
+                  << " | cluster refs: " << clusterLightRefs << " (" << clusterMs << " ms)"
+                  << " | light volumes: " << lightVolumes
+                  << " | gpu: " << gpuMs << " ms"
+                  << " | draw calls: " << drawCalls << " (" << multiDraws << " multi, " << instancesDrawn << " instances)"
+                  << " | program switches: " << programSwitches << " (" << programSwitchesUnsorted << " unsorted)"
+                  << " | texture switches: " << textureSwitches << " (" << textureSwitchesUnsorted << " unsorted, sort " << renderQueueSortMs << " ms)"
+                  << " | triangles: " << triangles
+                  << " | objects culled: " << objectsCulled << " / " << objectsDrawn + objectsCulled
+                  << " | occlusion culled: " << occlusionCulled << " / " << occlusionTested << " (" << occluderTriangles << " occluder tris, " << occlusionMs << " ms)"
+                  << " | gpu instances culled: " << gpuInstancesCulled << " / " << gpuInstancesDrawn + gpuInstancesCulled
+                  << " | meshlets culled: " << meshletsCulled << " / " << meshletsDrawn + meshletsCulled
+                  << " | textures streamed: " << textureBytesStreamed / 1024 << " KB (" << textureStalls << " stalls)" << std::endl;
+    }
+};
+
+inline FrameStats frameStats;
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <lib/constants.h>
+#include <lib/mapped_file.h>
+#include <lib/texture_streamer.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// every texture of the process, shared: Acquire() the same file twice (any spelling of its path, or a copy of it) and get the same GL texture
+// textures are looked up by canonical path first, then by a hash of the file's bytes
+// Release() drops a reference; unreferenced textures stay cached (cheap to reacquire) until they go over TEXTURE_CACHE_BUDGET, oldest first
+class TextureCache
+{
+public:
+    unsigned int Acquire(const std::string &path, GLint wrapMode = GL_REPEAT, bool flip = true, glm::u8vec4 placeholder = PLACEHOLDER_GRAY,
+                         TextureCompression compression = COMPRESS_NONE)
+    {
+        // wrap mode lives in the texture object, flipping and compression change the pixels, all part of the key
+        std::string settings = "|" + std::to_string(wrapMode) + (flip ? "|flip" : "") + "|" + std::to_string(compression);
+
+        std::error_code error;
+        std::string pathKey = std::filesystem::weakly_canonical(path, error).string();
+        if (error)
+            pathKey = path;
+        pathKey += settings;
+
+        auto byPathFound = byPath.find(pathKey);
+        if (byPathFound != byPath.end())
+        {
+            pathHits++;
+            return use(byPathFound->second);
+        }
+
+        // same bytes under another name (copied next to another model ...)
+        uint64_t contentKey = 0;
+        bool hashed = contentHash(path, contentKey);
+        if (hashed)
+        {
+            contentKey ^= std::hash<std::string>()(settings);
+
+            auto byContentFound = byContent.find(contentKey);
+            if (byContentFound != byContent.end())
+            {
+                contentHits++;
+                byPath[pathKey] = byContentFound->second;
+                entries[byContentFound->second].pathKeys.push_back(pathKey);
+                return use(byContentFound->second);
+            }
+        }
+
+        misses++;
+        unsigned int texture = Streamer().Request(path, wrapMode, flip, placeholder, compression);
+
+        Entry &entry = entries[texture];
+        entry.pathKeys.push_back(pathKey);
+        entry.hashed = hashed;
+        entry.contentKey = contentKey;
+        entry.refs = 1;
+
+        byPath[pathKey] = texture;
+        if (hashed)
+            byContent[contentKey] = texture;
+
+        return texture;
+    }
+
+    // one reference less, the texture stays cached until the budget needs its memory
+    void Release(unsigned int texture)
+    {
+        auto found = entries.find(texture);
+        if (found == entries.end() || found->second.refs == 0)
+            return;
+
+        Entry &entry = found->second;
+        if (--entry.refs == 0)
+        {
+            entry.unused = unused.insert(unused.end(), texture);
+            trim(TEXTURE_CACHE_BUDGET);
+        }
+    }
+
+    // deletes every unreferenced texture
+    void Purge()
+    {
+        trim(0);
+    }
+
+    unsigned int References(unsigned int texture) const
+    {
+        auto found = entries.find(texture);
+        return found != entries.end() ? found->second.refs : 0;
+    }
+
+    void Print() const
+    {
+        size_t bytes = 0;
+        for (auto &entry : entries)
+            bytes += Streamer().Bytes(entry.first);
+
+        std::cout << "texture cache: " << entries.size() << " textures (" << unused.size() << " unused), " << bytes / 1024 << " KB resident"
+                  << " | path hits: " << pathHits << " | content hits: " << contentHits
+                  << " | misses: " << misses << " | evictions: " << evictions << std::endl;
+    }
+
+    // deletes everything, referenced or not
+    void del()
+    {
+        for (auto &entry : entries)
+        {
+            Streamer().Cancel(entry.first);
+            glDeleteTextures(1, &entry.first);
+        }
+
+        entries.clear();
+        byPath.clear();
+        byContent.clear();
+        unused.clear();
+    }
+
+private:
+    struct Entry
+    {
+        unsigned int refs = 0;
+        std::vector<std::string> pathKeys; // every path it was acquired under
+        bool hashed = false;
+        uint64_t contentKey = 0;
+        std::list<unsigned int>::iterator unused; // position in unused, only while refs == 0
+    };
+
+    std::unordered_map<unsigned int, Entry> entries; // by texture id
+    std::unordered_map<std::string, unsigned int> byPath;
+    std::unordered_map<uint64_t, unsigned int> byContent;
+    std::list<unsigned int> unused; // refs == 0, least recently released first
+
+    unsigned int pathHits = 0, contentHits = 0, misses = 0, evictions = 0;
+
+    unsigned int use(unsigned int texture)
+    {
+        Entry &entry = entries[texture];
+        if (entry.refs++ == 0)
+            unused.erase(entry.unused);
+        return texture;
+    }
+
+    // evicts the oldest unused textures until the unused ones fit into budget bytes
+    void trim(size_t budget)
+    {
+        size_t unusedBytes = 0;
+        for (unsigned int texture : unused)
+            unusedBytes += Streamer().Bytes(texture);
+
+        while (!unused.empty() && (unusedBytes > budget || budget == 0))
+        {
+            unsigned int texture = unused.front();
+            unused.pop_front();
+            unusedBytes -= std::min(unusedBytes, Streamer().Bytes(texture));
+
+            Entry &entry = entries[texture];
+            for (const std::string &key : entry.pathKeys)
+                byPath.erase(key);
+            if (entry.hashed)
+                byContent.erase(entry.contentKey);
+
+            Streamer().Cancel(texture);
+            glDeleteTextures(1, &texture);
+            entries.erase(texture);
+            evictions++;
+        }
+    }
+
+    // FNV-1a over 8 byte words of the mapped file, false if it can't be read
+    static bool contentHash(const std::string &path, uint64_t &hash)
+    {
+        MappedFile file;
+        if (!file.Open(path))
+            return false;
+
+        const uint64_t prime = 1099511628211ull;
+        hash = 14695981039346656037ull ^ file.Size();
+
+        size_t words = file.Size() / 8;
+        const char *data = file.Data();
+        for (size_t i = 0; i < words; i++)
+        {
+            uint64_t word;
+            memcpy(&word, data + i * 8, 8);
+            hash = (hash ^ word) * prime;
+        }
+        for (size_t i = words * 8; i < file.Size(); i++)
+            hash = (hash ^ (unsigned char)data[i]) * prime;
+
+        return true;
+    }
+};
+
+// the one cache, created on first use (needs the context)
+inline TextureCache &Textures()
+{
+    static TextureCache cache;
+    return cache;
+}
+
+#endif
@@ -0,0 +1,254 @@
+#ifndef TEXTURE_COMPRESS_H
+#define TEXTURE_COMPRESS_H
+
+#include <glad/glad.h>
+
+#include <lib/gl_extensions.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// block compression encoders for the texture streamer, 4x4 texel blocks
+// BC1 (S3TC DXT1): color, 8 bytes / block      BC3 (DXT5): color + alpha, 16 bytes
+// BC4 (RGTC1): one channel, 8 bytes            BC5 (RGTC2): two channels (normal map xy), 16 bytes
+// quality is a single pass fit (principal axis for color, min / max for channels), good enough for material maps
+
+// what a texture is used for decides its format
+enum TextureCompression
+{
+    COMPRESS_NONE,
+    COMPRESS_COLOR,  // albedo: BC1, BC3 if the image has alpha (RGBA or gray + alpha)
+    COMPRESS_GRAY,   // specular / masks: BC4, the red channel
+    COMPRESS_NORMAL, // tangent space normals: BC5, x and y (the shader rebuilds z)
+};
+
+// compressed format for an image with components channels, 0 if it stays uncompressed
+// BC1 / BC3 need EXT_texture_compression_s3tc, RGTC is core
+inline GLenum CompressedFormat(TextureCompression compression, int components)
+{
+    switch (compression)
+    {
+    case COMPRESS_COLOR:
+        if (!glExt.textureCompressionS3TC)
+            return 0;
+        return components == 4 || components == 2 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case COMPRESS_GRAY:
+        return GL_COMPRESSED_RED_RGTC1;
+    case COMPRESS_NORMAL:
+        return components >= 2 ? GL_COMPRESSED_RG_RGTC2 : 0;
+    default:
+        return 0;
+    }
+}
+
+inline int CompressedBlockBytes(GLenum format)
+{
+    return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RED_RGTC1 ? 8 : 16;
+}
+
+inline size_t CompressedLevelBytes(GLenum format, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * CompressedBlockBytes(format);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------
+
+inline uint16_t packRGB565(const float color[3])
+{
+    int r = std::clamp((int)std::lround(color[0] * 31.0f / 255.0f), 0, 31);
+    int g = std::clamp((int)std::lround(color[1] * 63.0f / 255.0f), 0, 63);
+    int b = std::clamp((int)std::lround(color[2] * 31.0f / 255.0f), 0, 31);
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+inline void unpackRGB565(uint16_t packed, float color[3])
+{
+    color[0] = (float)((packed >> 11) & 31) * 255.0f / 31.0f;
+    color[1] = (float)((packed >> 5) & 63) * 255.0f / 63.0f;
+    color[2] = (float)(packed & 31) * 255.0f / 31.0f;
+}
+
+// BC1 color block from 16 RGB texels: endpoints at the extremes along the principal axis, 4 color mode
+inline void EncodeBC1Block(const uint8_t texels[16][4], uint8_t out[8])
+{
+    float mean[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += texels[i][c] / 16.0f;
+
+    float covariance[6] = {0, 0, 0, 0, 0, 0}; // rr rg rb gg gb bb
+    for (int i = 0; i < 16; i++)
+    {
+        float d[3] = {texels[i][0] - mean[0], texels[i][1] - mean[1], texels[i][2] - mean[2]};
+        covariance[0] += d[0] * d[0];
+        covariance[1] += d[0] * d[1];
+        covariance[2] += d[0] * d[2];
+        covariance[3] += d[1] * d[1];
+        covariance[4] += d[1] * d[2];
+        covariance[5] += d[2] * d[2];
+    }
+
+    // principal axis by power iteration
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 4; iteration++)
+    {
+        float next[3] = {covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+                         covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+                         covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]};
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+
+    float lowest = 1e9f, highest = -1e9f;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = (texels[i][0] - mean[0]) * axis[0] + (texels[i][1] - mean[1]) * axis[1] + (texels[i][2] - mean[2]) * axis[2];
+        lowest = std::min(lowest, t);
+        highest = std::max(highest, t);
+    }
+
+    float maxColor[3], minColor[3];
+    for (int c = 0; c < 3; c++)
+    {
+        maxColor[c] = mean[c] + axis[c] * highest;
+        minColor[c] = mean[c] + axis[c] * lowest;
+    }
+
+    uint16_t color0 = packRGB565(maxColor), color1 = packRGB565(minColor);
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    uint32_t indices = 0;
+    if (color0 != color1) // equal endpoints would switch to 3 color mode, index 0 everywhere is right for a flat block anyway
+    {
+        float palette[4][3];
+        unpackRGB565(color0, palette[0]);
+        unpackRGB565(color1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            float bestDistance = 1e30f;
+            for (int p = 0; p < 4; p++)
+            {
+                float d0 = texels[i][0] - palette[p][0], d1 = texels[i][1] - palette[p][1], d2 = texels[i][2] - palette[p][2];
+                float distance = d0 * d0 + d1 * d1 + d2 * d2;
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+    }
+
+    out[0] = color0 & 0xFF;
+    out[1] = color0 >> 8;
+    out[2] = color1 & 0xFF;
+    out[3] = color1 >> 8;
+    memcpy(out + 4, &indices, 4); // little endian, like the format
+}
+
+// BC4 block from 16 values (also BC3 alpha and each BC5 channel): min / max endpoints, 8 value mode
+inline void EncodeBC4Block(const uint8_t values[16], uint8_t out[8])
+{
+    uint8_t highest = *std::max_element(values, values + 16);
+    uint8_t lowest = *std::min_element(values, values + 16);
+
+    out[0] = highest;
+    out[1] = lowest;
+
+    uint64_t indices = 0;
+    if (highest != lowest)
+    {
+        // palette order: 0 = highest, 1 = lowest, 2..7 = steps from highest to lowest
+        static const int order[8] = {0, 2, 3, 4, 5, 6, 7, 1};
+        float range = (float)(highest - lowest);
+
+        for (int i = 0; i < 16; i++)
+        {
+            int step = (int)std::lround((highest - values[i]) * 7.0f / range); // 0 = highest ... 7 = lowest
+            indices |= (uint64_t)order[step] << (3 * i);
+        }
+    }
+
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (uint8_t)(indices >> (8 * i));
+}
+
+// one mip level, rows of blocks; edge blocks repeat the last row / column
+inline std::vector<uint8_t> CompressLevel(const uint8_t *pixels, int width, int height, int components, GLenum format)
+{
+    int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+    int blockBytes = CompressedBlockBytes(format);
+    std::vector<uint8_t> out((size_t)blocksWide * blocksHigh * blockBytes);
+
+    uint8_t texels[16][4];
+    uint8_t channel[16];
+
+    // two channels are gray + alpha for color, x + y for normals
+    bool grayAlpha = components == 2 && (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+
+    for (int by = 0; by < blocksHigh; by++)
+        for (int bx = 0; bx < blocksWide; bx++)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                int x = std::min(bx * 4 + (i & 3), width - 1);
+                int y = std::min(by * 4 + (i >> 2), height - 1);
+                const uint8_t *texel = pixels + ((size_t)y * width + x) * components;
+
+                // gray images fill every channel, missing alpha is opaque
+                for (int c = 0; c < 4; c++)
+                    texels[i][c] = c < components ? texel[c] : (c == 3 ? 255 : texel[0]);
+                if (grayAlpha)
+                {
+                    texels[i][1] = texel[0];
+                    texels[i][3] = texel[1];
+                }
+            }
+
+            uint8_t *block = out.data() + ((size_t)by * blocksWide + bx) * blockBytes;
+            switch (format)
+            {
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+                EncodeBC1Block(texels, block);
+                break;
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+                for (int i = 0; i < 16; i++)
+                    channel[i] = texels[i][3];
+                EncodeBC4Block(channel, block);
+                EncodeBC1Block(texels, block + 8);
+                break;
+            case GL_COMPRESSED_RED_RGTC1:
+                for (int i = 0; i < 16; i++)
+                    channel[i] = texels[i][0];
+                EncodeBC4Block(channel, block);
+                break;
+            case GL_COMPRESSED_RG_RGTC2:
+                for (int c = 0; c < 2; c++)
+                {
+                    for (int i = 0; i < 16; i++)
+                        channel[i] = texels[i][c];
+                    EncodeBC4Block(channel, block + 8 * c);
+                }
+                break;
+            }
+        }
+
+    return out;
+}
+
+#endif
@@ -0,0 +1,535 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <lib/constants.h>
+#include <lib/ktx.h>
+#include <lib/mapped_file.h>
+#include <lib/stats.h>
+#include <lib/stb_image.h>
+#include <lib/texture_compress.h>
+#include <lib/thread_pool.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+#define PLACEHOLDER_GRAY glm::u8vec4(128, 128, 128, 255)
+#define PLACEHOLDER_NORMAL glm::u8vec4(128, 128, 255, 255) // flat tangent space normal
+
+// compressed textures are kept in cache/textures as KTX, rebuilt when the source is newer or the encoder changes
+#define TEXTURE_CACHE_DIRECTORY "cache/textures"
+#define TEXTURE_COMPRESS_VERSION 1
+
+// textures that load in the background: Request() hands out a usable texture id right away (1x1 placeholder),
+// a worker decodes the file and builds the mip chain, Update() uploads it through a ring of pixel unpack buffers
+// uploads go coarsest mip first and GL_TEXTURE_BASE_LEVEL follows, so textures sharpen instead of popping in
+// at most TEXTURE_UPLOAD_BUDGET bytes per Update(), a big file spreads over several frames instead of stalling one
+// with a compression other than COMPRESS_NONE the worker encodes every level once (BC1 / BC3 / BC4 / BC5, see texture_compress.h)
+// and later runs read the KTX from the cache instead of decoding the image
+class TextureStreamer
+{
+public:
+    TextureStreamer(size_t budgetBytes = TEXTURE_UPLOAD_BUDGET) : budgetBytes(budgetBytes)
+    {
+        glGenBuffers(TEXTURE_STREAM_SLOTS, pbos);
+        for (int i = 0; i < TEXTURE_STREAM_SLOTS; i++)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[i]);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, TEXTURE_STREAM_SLOT_BYTES, NULL, GL_STREAM_DRAW);
+            fences[i] = 0;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    // texture id for path, a placeholder until the file arrives; GL thread only
+    unsigned int Request(const std::string &path, GLint wrapMode = GL_REPEAT, bool flip = true, glm::u8vec4 placeholder = PLACEHOLDER_GRAY,
+                         TextureCompression compression = COMPRESS_NONE)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+
+        GLint previous;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+        glBindTexture(GL_TEXTURE_2D, texture);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &placeholder[0]);
+
+        glBindTexture(GL_TEXTURE_2D, previous);
+
+        std::shared_ptr<Job> job = std::make_shared<Job>();
+        job->texture = texture;
+        job->path = path;
+        job->flip = flip;
+        job->compression = compression;
+        pending++;
+
+        {
+            std::lock_guard<std::mutex> lock(readyMutex);
+            requested[texture] = job;
+        }
+
+        WorkerPool().Submit([this, job]
+                            {
+                                decode(*job);
+
+                                std::lock_guard<std::mutex> lock(readyMutex);
+                                ready.push_back(job); });
+
+        return texture;
+    }
+
+    // once a frame on the GL thread, before drawing
+    void Update()
+    {
+        {
+            std::lock_guard<std::mutex> lock(readyMutex);
+            while (!ready.empty())
+            {
+                std::shared_ptr<Job> job = ready.front();
+                ready.pop_front();
+
+                if (job->cancelled)
+                    continue;
+
+                if (job->levels.empty())
+                {
+                    requested.erase(job->texture);
+                    std::cout << "Texture failed to load at path: " << job->path << std::endl;
+                    pending--;
+                    continue;
+                }
+                requested.erase(job->texture);
+                uploading.push_back(job);
+            }
+        }
+
+        if (uploading.empty())
+            return;
+
+        GLint previousTexture, previousAlignment;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // RGB rows aren't 4 byte aligned
+
+        size_t budget = budgetBytes;
+        while (budget > 0 && !uploading.empty())
+        {
+            Job &job = *uploading.front();
+            glBindTexture(GL_TEXTURE_2D, job.texture);
+
+            if (!job.allocated)
+                allocate(job);
+
+            if (job.level < 0)
+            {
+                finish(job);
+                uploading.pop_front();
+                continue;
+            }
+
+            // a band of rows of the current level (rows of 4x4 blocks when compressed), as much as the slot and the budget allow
+            // a frame's first band gets at least one row even if that is over budget, so everything keeps moving
+            Level &level = job.levels[job.level];
+            size_t allowed = std::min<size_t>(TEXTURE_STREAM_SLOT_BYTES, budget);
+            if (allowed < level.rowBytes && budget < budgetBytes)
+                break;
+
+            int rows = std::min(level.rows - job.row, (int)std::max<size_t>(1, allowed / level.rowBytes));
+            size_t bytes = level.rowBytes * rows;
+
+            int slot = acquireSlot();
+            if (slot < 0)
+            {
+                frameStats.textureStalls++; // every slot still in flight, the GPU is behind: try again next frame
+                break;
+            }
+
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[slot]);
+            // fenced, so the GPU is done with this slot and no implicit sync is needed
+            void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            memcpy(mapped, level.data + level.rowBytes * job.row, bytes);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+            if (job.compressedFormat)
+            {
+                int y = job.row * 4;
+                glCompressedTexSubImage2D(GL_TEXTURE_2D, job.level, 0, y, level.width, std::min(rows * 4, level.height - y), job.compressedFormat, (GLsizei)bytes, (void *)0);
+            }
+            else
+                glTexSubImage2D(GL_TEXTURE_2D, job.level, 0, job.row, level.width, rows, job.format, GL_UNSIGNED_BYTE, (void *)0);
+            fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+            frameStats.textureBytesStreamed += (unsigned int)bytes;
+            budget -= std::min(budget, bytes);
+
+            job.row += rows;
+            if (job.row == level.rows)
+            {
+                // level complete, sample from it on
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, job.level);
+                job.level--;
+                job.row = 0;
+            }
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+        glBindTexture(GL_TEXTURE_2D, previousTexture);
+    }
+
+    // textures not fully uploaded yet (decoding or streaming)
+    unsigned int Pending() const
+    {
+        return pending;
+    }
+
+    // GPU size of a finished texture (every level, compressed size if it is), 0 while it is still streaming
+    size_t Bytes(unsigned int texture) const
+    {
+        auto found = sizes.find(texture);
+        return found != sizes.end() ? found->second : 0;
+    }
+
+    // stops streaming into texture, call it before deleting a texture that may still be pending
+    void Cancel(unsigned int texture)
+    {
+        sizes.erase(texture);
+
+        for (auto it = uploading.begin(); it != uploading.end(); ++it)
+        {
+            if ((*it)->texture == texture)
+            {
+                uploading.erase(it);
+                pending--;
+                return;
+            }
+        }
+
+        // still decoding (or decoded, not picked up yet): dropped when it reaches Update()
+        // flagged on the job, the texture name itself may get reused before that
+        std::lock_guard<std::mutex> lock(readyMutex);
+        auto found = requested.find(texture);
+        if (found != requested.end())
+        {
+            found->second->cancelled = true;
+            requested.erase(found);
+            pending--;
+        }
+    }
+
+    void del()
+    {
+        for (int i = 0; i < TEXTURE_STREAM_SLOTS; i++)
+        {
+            if (fences[i])
+                glDeleteSync(fences[i]);
+            fences[i] = 0;
+        }
+        glDeleteBuffers(TEXTURE_STREAM_SLOTS, pbos);
+        uploading.clear();
+    }
+
+private:
+    struct Level
+    {
+        int width, height;
+        const unsigned char *data;
+        size_t bytes;
+        int rows;        // upload granularity: pixel rows, block rows when compressed
+        size_t rowBytes;
+    };
+
+    struct Job
+    {
+        unsigned int texture;
+        std::string path;
+        bool flip;
+        TextureCompression compression = COMPRESS_NONE;
+        std::atomic<bool> cancelled{false};
+
+        // filled by the worker, levels stays empty if the file couldn't be decoded
+        int components = 0;
+        GLenum format = GL_RGB;
+        GLenum compressedFormat = 0;       // 0: uncompressed
+        unsigned char *pixels = NULL;      // level 0, from stbi
+        std::vector<unsigned char> mips;   // every smaller level, back to back
+        std::vector<unsigned char> blocks; // every level compressed, back to back
+        MappedFile ktx;                    // or mapped from the cache
+        std::vector<Level> levels;
+
+        // upload progress, GL thread
+        bool allocated = false;
+        int level = 0;
+        int row = 0;
+
+        ~Job()
+        {
+            if (pixels)
+                stbi_image_free(pixels);
+        }
+    };
+
+    size_t budgetBytes;
+    unsigned int pbos[TEXTURE_STREAM_SLOTS];
+    GLsync fences[TEXTURE_STREAM_SLOTS];
+    int nextSlot = 0;
+
+    std::mutex readyMutex;
+    std::deque<std::shared_ptr<Job>> ready; // decoded, waiting for the GL thread
+    std::deque<std::shared_ptr<Job>> uploading;
+    std::unordered_map<unsigned int, std::shared_ptr<Job>> requested; // jobs that haven't reached Update() yet
+    std::unordered_map<unsigned int, size_t> sizes; // finished textures
+    unsigned int pending = 0;
+
+    // worker side: cached KTX if there is a fresh one, otherwise decode + box filtered mip chain (+ compress, write the KTX)
+    static void decode(Job &job)
+    {
+        std::string ktxPath;
+        if (job.compression != COMPRESS_NONE)
+        {
+            ktxPath = compressedPath(job);
+            if (loadCompressed(job, ktxPath))
+                return;
+        }
+
+        stbi_set_flip_vertically_on_load_thread(job.flip);
+
+        int width, height;
+        job.pixels = stbi_load(job.path.c_str(), &width, &height, &job.components, 0);
+        if (!job.pixels)
+            return;
+
+        const GLenum formats[] = {GL_RED, GL_RED, GL_RG, GL_RGB, GL_RGBA};
+        job.format = formats[job.components];
+
+        // sizes first, mips holds every level after 0
+        std::vector<glm::ivec2> sizes = {glm::ivec2(width, height)};
+        size_t mipBytes = 0;
+        while (sizes.back().x > 1 || sizes.back().y > 1)
+        {
+            glm::ivec2 size = glm::max(sizes.back() / 2, glm::ivec2(1));
+            sizes.push_back(size);
+            mipBytes += (size_t)size.x * size.y * job.components;
+        }
+        job.mips.resize(mipBytes);
+
+        size_t levelBytes = (size_t)width * height * job.components;
+        job.levels.push_back({width, height, job.pixels, levelBytes, height, (size_t)width * job.components});
+        unsigned char *next = job.mips.data();
+        for (unsigned int i = 1; i < sizes.size(); i++)
+        {
+            levelBytes = (size_t)sizes[i].x * sizes[i].y * job.components;
+            downsample(job.levels[i - 1], sizes[i].x, sizes[i].y, next, job.components);
+            job.levels.push_back({sizes[i].x, sizes[i].y, next, levelBytes, sizes[i].y, (size_t)sizes[i].x * job.components});
+            next += levelBytes;
+        }
+
+        if (job.compression != COMPRESS_NONE)
+            compress(job, ktxPath);
+    }
+
+    // cache/textures/<hash of path + settings>.ktx
+    static std::string compressedPath(const Job &job)
+    {
+        std::error_code error;
+        std::string key = std::filesystem::weakly_canonical(job.path, error).string();
+        if (error)
+            key = job.path;
+        key += "|" + std::to_string(job.compression) + (job.flip ? "|flip" : "") + "|v" + std::to_string(TEXTURE_COMPRESS_VERSION);
+
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.ktx", (unsigned long long)std::hash<std::string>()(key));
+        return std::string(TEXTURE_CACHE_DIRECTORY) + "/" + name;
+    }
+
+    // levels straight from a KTX written by an earlier run, false if there is none, it's older than the image or the format can't be used here
+    static bool loadCompressed(Job &job, const std::string &ktxPath)
+    {
+        std::error_code error;
+        auto sourceTime = std::filesystem::last_write_time(job.path, error);
+        if (error)
+            return false;
+        auto cacheTime = std::filesystem::last_write_time(ktxPath, error);
+        if (error || cacheTime < sourceTime)
+            return false;
+
+        GLenum internalFormat;
+        std::vector<KTXLevel> ktxLevels;
+        if (!OpenKTX(ktxPath, job.ktx, internalFormat, ktxLevels))
+            return false;
+
+        if (internalFormat != GL_COMPRESSED_RED_RGTC1 && internalFormat != GL_COMPRESSED_RG_RGTC2 && !glExt.textureCompressionS3TC)
+            return false;
+
+        for (const KTXLevel &level : ktxLevels)
+        {
+            if (level.bytes != CompressedLevelBytes(internalFormat, level.width, level.height))
+            {
+                job.levels.clear();
+                job.ktx.Close();
+                return false;
+            }
+            job.levels.push_back(compressedLevel(internalFormat, level.width, level.height, level.data));
+        }
+
+        job.compressedFormat = internalFormat;
+        job.format = ktxBaseFormat(internalFormat);
+        return true;
+    }
+
+    // replaces the decoded levels with compressed ones and saves them for the next run
+    // images the compression can't take (normal map with 1 channel, BC1 without S3TC support ...) stay uncompressed
+    static void compress(Job &job, const std::string &ktxPath)
+    {
+        GLenum format = CompressedFormat(job.compression, job.components);
+        if (!format)
+            return;
+
+        size_t total = 0;
+        for (const Level &level : job.levels)
+            total += CompressedLevelBytes(format, level.width, level.height);
+        job.blocks.resize(total);
+
+        std::vector<Level> levels;
+        std::vector<KTXLevel> ktxLevels;
+        unsigned char *next = job.blocks.data();
+        for (const Level &level : job.levels)
+        {
+            std::vector<uint8_t> encoded = CompressLevel(level.data, level.width, level.height, job.components, format);
+            memcpy(next, encoded.data(), encoded.size());
+
+            levels.push_back(compressedLevel(format, level.width, level.height, next));
+            ktxLevels.push_back({level.width, level.height, next, encoded.size()});
+            next += encoded.size();
+        }
+
+        if (!WriteKTX(ktxPath, format, ktxLevels))
+            std::cout << "Couldn't write compressed texture cache: " << ktxPath << std::endl;
+
+        job.levels = levels;
+        job.compressedFormat = format;
+        job.format = ktxBaseFormat(format);
+
+        stbi_image_free(job.pixels);
+        job.pixels = NULL;
+        job.mips = std::vector<unsigned char>();
+    }
+
+    static Level compressedLevel(GLenum format, int width, int height, const unsigned char *data)
+    {
+        int blockRows = (height + 3) / 4;
+        size_t rowBytes = (size_t)((width + 3) / 4) * CompressedBlockBytes(format);
+        return {width, height, data, rowBytes * blockRows, blockRows, rowBytes};
+    }
+
+    // 2x2 box filter, odd edges reuse the last row / column
+    static void downsample(const Level &source, int width, int height, unsigned char *target, int components)
+    {
+        for (int y = 0; y < height; y++)
+        {
+            int y0 = std::min(y * 2, source.height - 1), y1 = std::min(y * 2 + 1, source.height - 1);
+            for (int x = 0; x < width; x++)
+            {
+                int x0 = std::min(x * 2, source.width - 1), x1 = std::min(x * 2 + 1, source.width - 1);
+                for (int c = 0; c < components; c++)
+                {
+                    int sum = source.data[((size_t)y0 * source.width + x0) * components + c] + source.data[((size_t)y0 * source.width + x1) * components + c] +
+                              source.data[((size_t)y1 * source.width + x0) * components + c] + source.data[((size_t)y1 * source.width + x1) * components + c];
+                    target[((size_t)y * width + x) * components + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+    }
+
+    // real storage for every level; the 1x1 level goes in directly so there is never an undefined level to sample
+    void allocate(Job &job)
+    {
+        // the previous job's last band may have left a slot bound, level data here comes from client memory
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        int last = (int)job.levels.size() - 1;
+        for (int i = 0; i <= last; i++)
+        {
+            const Level &level = job.levels[i];
+            if (job.compressedFormat)
+                glCompressedTexImage2D(GL_TEXTURE_2D, i, job.compressedFormat, level.width, level.height, 0, (GLsizei)level.bytes, i == last ? level.data : NULL);
+            else
+                glTexImage2D(GL_TEXTURE_2D, i, job.format, level.width, level.height, 0, job.format, GL_UNSIGNED_BYTE, i == last ? level.data : NULL);
+        }
+
+        // one channel textures (specular, BC4) read as gray instead of red
+        if (job.format == GL_RED)
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+        }
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, last);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, last);
+
+        job.allocated = true;
+        job.level = last - 1;
+        job.row = 0;
+    }
+
+    void finish(Job &job)
+    {
+        size_t bytes = 0;
+        for (const Level &level : job.levels)
+            bytes += level.bytes;
+        sizes[job.texture] = bytes;
+
+        if (job.pixels)
+            stbi_image_free(job.pixels);
+        job.pixels = NULL;
+        job.mips = std::vector<unsigned char>();
+        job.blocks = std::vector<unsigned char>();
+        job.ktx.Close();
+        job.levels.clear();
+        pending--;
+    }
+
+    // next ring slot the GPU has finished reading from, -1 if it is still busy
+    int acquireSlot()
+    {
+        int slot = nextSlot;
+        if (fences[slot])
+        {
+            if (glClientWaitSync(fences[slot], 0, 0) == GL_TIMEOUT_EXPIRED)
+                return -1;
+
+            glDeleteSync(fences[slot]);
+            fences[slot] = 0;
+        }
+
+        nextSlot = (nextSlot + 1) % TEXTURE_STREAM_SLOTS;
+        return slot;
+    }
+};
+
+// the one streamer, created on first use (needs the context)
+inline TextureStreamer &Streamer()
+{
+    static TextureStreamer streamer;
+    return streamer;
+}
+
+#endif
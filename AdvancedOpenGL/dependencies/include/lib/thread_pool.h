@@ -0,0 +1,152 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads for CPU side work (cluster assignment, loading ...)
+// ! jobs must not touch GL, the context only lives on the main thread
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned int threadCount = DefaultThreadCount())
+    {
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([this]
+                                 { workerLoop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+
+        for (auto &worker : workers)
+            worker.join();
+    }
+
+    // main thread + workers = every core
+    static unsigned int DefaultThreadCount()
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 1;
+    }
+
+    unsigned int Size() const
+    {
+        return (unsigned int)workers.size();
+    }
+
+    void Submit(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+        wake.notify_one();
+    }
+
+    // blocks until every submitted job has finished
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this]
+                  { return jobs.empty() && busy == 0; });
+    }
+
+    // runs fn(i) for every i in [0, count), the calling thread works along and returns once all of them are done
+    void ParallelFor(int count, const std::function<void(int)> &fn)
+    {
+        if (count <= 0)
+            return;
+
+        // shared with the helpers, a helper that starts late only finds no work left
+        struct Batch
+        {
+            std::atomic<int> next{0};
+            std::atomic<int> done{0};
+            std::mutex mutex;
+            std::condition_variable finished;
+        };
+        auto batch = std::make_shared<Batch>();
+
+        auto work = [batch, count, &fn]
+        {
+            for (int i = batch->next++; i < count; i = batch->next++)
+            {
+                fn(i);
+                if (++batch->done == count)
+                {
+                    std::lock_guard<std::mutex> lock(batch->mutex);
+                    batch->finished.notify_all();
+                }
+            }
+        };
+
+        unsigned int helpers = std::min(Size(), (unsigned int)count - 1);
+        for (unsigned int i = 0; i < helpers; i++)
+            Submit(work);
+
+        work();
+
+        std::unique_lock<std::mutex> lock(batch->mutex);
+        batch->finished.wait(lock, [&]
+                             { return batch->done == count; });
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    unsigned int busy = 0;
+    bool stopping = false;
+
+    void workerLoop()
+    {
+        while (true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]
+                          { return stopping || !jobs.empty(); });
+                if (stopping && jobs.empty())
+                    return;
+
+                job = std::move(jobs.front());
+                jobs.pop_front();
+                busy++;
+            }
+
+            job();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                busy--;
+                if (jobs.empty() && busy == 0)
+                    idle.notify_all();
+            }
+        }
+    }
+};
+
+// shared pool, created on first use
+inline ThreadPool &WorkerPool()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <lib/geometry_heap.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// 16 byte GPU vertex (a float Vertex is 32): what the mesh heap actually stores
+// position: snorm16 inside the quantization box (w unused, keeps the attribute 8 byte aligned)
+// normal:   octahedral, snorm16 x 2
+// uv:       half float x 2 (~1/2048 steps in [0.5, 1), enough up to 2K textures, about a texel at 4K)
+// litObject.vs dequantizes with QUANTIZED (FEATURE_QUANTIZED): position = aPos * positionScale + positionOffset
+struct PackedVertex
+{
+    int16_t Position[4];
+    int16_t Normal[2];
+    uint16_t TexCoords[2];
+};
+
+// the box positions are quantized in, position = snorm * scale + offset
+struct VertexQuantization
+{
+    glm::vec3 offset = glm::vec3(0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+
+    static VertexQuantization FromBounds(glm::vec3 boundsMin, glm::vec3 boundsMax)
+    {
+        VertexQuantization quantization;
+        quantization.offset = (boundsMin + boundsMax) * 0.5f;
+        quantization.scale = glm::max((boundsMax - boundsMin) * 0.5f, glm::vec3(1e-6f)); // flat meshes still divide fine
+        return quantization;
+    }
+
+    bool operator==(const VertexQuantization &other) const
+    {
+        return offset == other.offset && scale == other.scale;
+    }
+};
+
+// -------------------------------------------------------------------------------------------------------------------------
+
+inline int16_t packSnorm16(float value)
+{
+    return (int16_t)std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+// unit vector onto the octahedron, lower half folded over the diagonals (same as OctahedronDecode in litObject.vs)
+inline glm::vec2 OctahedronEncode(glm::vec3 n)
+{
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z) + 1e-20f;
+
+    glm::vec2 encoded(n.x, n.y);
+    if (n.z < 0.0f)
+    {
+        encoded.x = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+        encoded.y = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return encoded;
+}
+
+inline glm::vec3 OctahedronDecode(glm::vec2 e)
+{
+    glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+    if (n.z < 0.0f)
+    {
+        n.x = (1.0f - std::abs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f);
+        n.y = (1.0f - std::abs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return glm::normalize(n);
+}
+
+template <typename V>
+inline void PackVertices(const V *vertices, unsigned int count, const VertexQuantization &quantization, PackedVertex *out)
+{
+    for (unsigned int i = 0; i < count; i++)
+    {
+        glm::vec3 position = (vertices[i].Position - quantization.offset) / quantization.scale;
+        glm::vec2 normal = OctahedronEncode(vertices[i].Normal);
+
+        PackedVertex &packed = out[i];
+        packed.Position[0] = packSnorm16(position.x);
+        packed.Position[1] = packSnorm16(position.y);
+        packed.Position[2] = packSnorm16(position.z);
+        packed.Position[3] = 0;
+        packed.Normal[0] = packSnorm16(normal.x);
+        packed.Normal[1] = packSnorm16(normal.y);
+        packed.TexCoords[0] = glm::packHalf1x16(vertices[i].TexCoords.x);
+        packed.TexCoords[1] = glm::packHalf1x16(vertices[i].TexCoords.y);
+    }
+}
+
+// the position back on the CPU, like the vertex shader sees it (snorm decode, then the box)
+inline glm::vec3 UnpackPosition(const PackedVertex &vertex, const VertexQuantization &quantization)
+{
+    glm::vec3 snorm = glm::max(glm::vec3(vertex.Position[0], vertex.Position[1], vertex.Position[2]) / 32767.0f, glm::vec3(-1.0f));
+    return snorm * quantization.scale + quantization.offset;
+}
+
+// same locations as the float layout (0 position, 1 normal, 2 uv), only the types differ
+inline VertexFormat PackedVertexFormat()
+{
+    return VertexFormat{sizeof(PackedVertex),
+                        {{0, 4, GL_SHORT, true, (unsigned int)offsetof(PackedVertex, Position)},
+                         {1, 2, GL_SHORT, true, (unsigned int)offsetof(PackedVertex, Normal)},
+                         {2, 2, GL_HALF_FLOAT, false, (unsigned int)offsetof(PackedVertex, TexCoords)}}};
+}
+
+#endif
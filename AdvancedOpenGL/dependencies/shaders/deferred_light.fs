@@ -0,0 +1,85 @@
+# version 330 core
+
+// deferred lighting pass (deferred.h), one of FULLSCREEN, POINT_VOLUME, SPOT_VOLUME
+// built with frame_data.glsl and lighting.glsl included
+// FULLSCREEN writes ambient + directional lights, the volumes add one light each on top
+// STENCIL_MARK: volume program for the stencil marks, writes nothing
+
+out vec4 FragColor;
+
+flat in int lightIndex;
+
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+uniform mat4 invViewProjection;
+
+// gbuffer.fs
+const vec2 UNLIT_MARKER = vec2(4.0);
+
+// -------------------------------------------------------------------------------------------------------------------------
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec3 OctDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    return normalize(n);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------
+
+void main()
+{
+#ifdef STENCIL_MARK
+    return; // only the depth test of the volume's faces matters
+#endif
+
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 albedoSpec = texelFetch(gAlbedoSpec, pixel, 0);
+    vec2 encodedNormal = texelFetch(gNormal, pixel, 0).rg;
+    float depth = texelFetch(gDepth, pixel, 0).r;
+
+    // outlines are drawn without depth, check them before the background
+    bool unlit = encodedNormal.x > UNLIT_MARKER.x * 0.5;
+#ifdef FULLSCREEN
+    if (unlit)
+    {
+        FragColor = vec4(albedoSpec.rgb, 1.0);
+        return;
+    }
+#else
+    if (unlit)
+        discard;
+#endif
+    if (depth == 1.0)
+        discard; // background keeps the clear color
+
+    // + surface back from the G-buffer
+    vec4 ndc = vec4(gl_FragCoord.xy / viewport.xy * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 world = invViewProjection * ndc;
+
+    surfacePos = world.xyz / world.w;
+    albedo = albedoSpec.rgb;
+    specular = vec3(albedoSpec.a);
+    normal = OctDecode(encodedNormal);
+
+    vec3 result = vec3(0.0);
+
+#if defined(FULLSCREEN)
+    for(int i = 0; i < lightCounts.y; i++)
+        result += DirectionalResult(directionalLights[i]);
+#elif defined(POINT_VOLUME)
+    result = PointResult(pointLights[lightIndex]);
+#elif defined(SPOT_VOLUME)
+    result = SpotResult(spotLights[lightIndex]);
+#endif
+
+    FragColor = vec4(result, 1.0);
+}
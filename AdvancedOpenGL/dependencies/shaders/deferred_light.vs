@@ -0,0 +1,47 @@
+# version 330 core
+
+// deferred lighting pass (deferred.h), one of FULLSCREEN, POINT_VOLUME, SPOT_VOLUME
+// built with frame_data.glsl and lighting.glsl included
+// volumes go out one light per draw, lightOffset (+ gl_InstanceID) is the light index in LightData
+
+layout (location = 0) in vec3 aPos; // unit sphere, or unit cone with the apex at the origin and the base at z = -1
+
+#ifndef VOLUME_SCALE
+    #define VOLUME_SCALE 1.0 // grows the low poly mesh until it contains the real sphere / cone
+#endif
+
+flat out int lightIndex;
+
+uniform int lightOffset;
+
+void main()
+{
+    lightIndex = lightOffset + gl_InstanceID;
+
+#if defined(FULLSCREEN)
+    // one triangle covering the screen, no vertex buffer needed
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+#elif defined(POINT_VOLUME)
+    PointLight light = pointLights[lightIndex];
+    vec3 worldPos = light.position.xyz + aPos * light.position.w * VOLUME_SCALE;
+
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+#elif defined(SPOT_VOLUME)
+    SpotLight light = spotLights[lightIndex];
+
+    vec3 forward = normalize(light.direction.xyz);
+    vec3 up = abs(forward.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    vec3 right = normalize(cross(forward, up));
+    up = cross(right, forward);
+
+    // cone as long as the range, as wide as the outer cutoff
+    float range = light.position.w;
+    float cosOuter = light.cutoffs.y;
+    float radius = range * sqrt(1.0 - cosOuter * cosOuter) / cosOuter;
+
+    vec3 worldPos = light.position.xyz + (right * aPos.x + up * aPos.y) * radius * VOLUME_SCALE - forward * aPos.z * range;
+
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+#endif
+}
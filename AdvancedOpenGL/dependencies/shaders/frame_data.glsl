@@ -0,0 +1,9 @@
+// included by every ShaderBuilder / ShaderPermutations program, see frame_data.h
+layout (std140) uniform FrameData // binding FRAME_DATA_BINDING
+{
+    mat4 view;
+    mat4 projection;
+    vec4 cameraPos;  // xyz = camera position, w = time in seconds
+    vec4 clipPlanes; // x = near, y = far
+    vec4 viewport;   // xy = framebuffer size
+};
@@ -0,0 +1,68 @@
+# version 330 core
+
+// deferred geometry pass (deferred.h), runs on litObject.vs
+// built with frame_data.glsl and material.glsl included
+// variant switches like litObject.fs: TEXTURED, NORMAL_MAP, OUTLINE, UBER
+
+layout (location = 0) out vec4 gAlbedoSpec; // rgb = albedo, a = specular intensity
+layout (location = 1) out vec2 gNormal;     // octahedral world normal
+
+in vec2 TexCoord;
+in vec3 FragPos;
+in vec3 Normal;
+
+#if defined(OUTLINE) || defined(UBER)
+uniform vec3 outlineColor;
+#endif
+
+#ifdef UBER
+uniform bool useOutline;
+#endif
+
+// flat colored pixels (outlines) skip lighting, has to match deferred_light.fs
+const vec2 UNLIT_MARKER = vec2(4.0);
+
+// -------------------------------------------------------------------------------------------------------------------------
+
+float luma (vec3 color)
+{
+    return 0.299*color.r+0.587*color.g+0.114*color.b;
+}
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// unit vector -> [-1, 1]^2, the lower hemisphere folds over the diagonals
+vec2 OctEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signNotZero(n.xy);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------
+
+void main()
+{
+#ifdef OUTLINE
+    gAlbedoSpec = vec4(outlineColor, 0.0);
+    gNormal = UNLIT_MARKER;
+#else
+#ifdef UBER
+    if (useOutline)
+    {
+        gAlbedoSpec = vec4(outlineColor, 0.0);
+        gNormal = UNLIT_MARKER;
+        return;
+    }
+#endif
+
+    vec3 albedo, specular, normal;
+    SampleMaterial(TexCoord, Normal, albedo, specular, normal);
+
+    // * one channel of specular, colored specular maps turn gray
+    gAlbedoSpec = vec4(albedo, luma(specular));
+    gNormal = OctEncode(normalize(normal));
+#endif
+}
@@ -0,0 +1,25 @@
+# version 330 core
+
+// GPU instance culling (gpu_culling.h): passes on the instances gpu_cull.vs found visible, transform feedback captures them
+// (a vertex shader alone can't drop anything, every vertex it runs for gets written)
+
+layout (points) in;
+layout (points, max_vertices = 1) out;
+
+in vec4 vPositionScale[];
+in vec4 vColor[];
+flat in int vVisible[];
+
+out vec4 culledPositionScale;
+out vec4 culledColor;
+
+void main()
+{
+    if (vVisible[0] == 0)
+        return;
+
+    culledPositionScale = vPositionScale[0];
+    culledColor = vColor[0];
+    EmitVertex();
+    EndPrimitive();
+}
@@ -0,0 +1,78 @@
+# version 330 core
+
+// GPU instance culling (gpu_culling.h): every instance is one point, drawn with the rasterizer off
+// tests the instance's bounding sphere against the frustum and last frame's Hi-Z pyramid, gpu_cull.gs keeps the visible ones
+// and transform feedback writes them out
+
+layout (location = 0) in vec4 aPositionScale; // xyz = position, w = uniform scale
+layout (location = 1) in vec4 aColor;
+
+uniform vec4 frustumPlanes[6]; // world space, xyz = inward normal, w = distance
+uniform vec4 meshBounds;       // bounding sphere of the mesh every instance draws, model space (xyz = center, w = radius)
+
+uniform bool useHiZ;
+uniform sampler2D hiZ;
+uniform int hiZLevels;
+uniform mat4 hiZViewProjection; // the frame the pyramid was built from
+
+out vec4 vPositionScale;
+out vec4 vColor;
+flat out int vVisible;
+
+bool insideFrustum(vec3 center, float radius)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        if (dot(frustumPlanes[i].xyz, center) + frustumPlanes[i].w < -radius)
+            return false;
+    }
+    return true;
+}
+
+// the box around the sphere projected with the pyramid's frame: screen rectangle + nearest depth
+// on the level where the rectangle spans at most 2x2 texels, it is hidden if it is behind all 4 of them
+bool visibleInHiZ(vec3 center, float radius)
+{
+    vec2 uvMin = vec2(1.0), uvMax = vec2(0.0);
+    float nearest = 1.0;
+
+    for (int i = 0; i < 8; i++)
+    {
+        vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = hiZViewProjection * vec4(corner, 1.0);
+
+        // reaches past the near plane, the camera may be inside it
+        if (clip.w <= 0.0 || clip.z < -clip.w)
+            return true;
+
+        vec3 ndc = clip.xyz / clip.w;
+        uvMin = min(uvMin, ndc.xy * 0.5 + 0.5);
+        uvMax = max(uvMax, ndc.xy * 0.5 + 0.5);
+        nearest = min(nearest, ndc.z * 0.5 + 0.5);
+    }
+
+    vec2 size = vec2(textureSize(hiZ, 0));
+    vec2 pixelMin = clamp(uvMin, 0.0, 1.0) * size, pixelMax = clamp(uvMax, 0.0, 1.0) * size;
+    vec2 extent = pixelMax - pixelMin;
+    int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, hiZLevels - 1);
+
+    ivec2 levelSize = textureSize(hiZ, level);
+    ivec2 low = min(ivec2(pixelMin) >> level, levelSize - 1);
+    ivec2 high = min(ivec2(pixelMax) >> level, levelSize - 1);
+
+    float farthest = max(max(texelFetch(hiZ, low, level).r, texelFetch(hiZ, ivec2(high.x, low.y), level).r),
+                         max(texelFetch(hiZ, ivec2(low.x, high.y), level).r, texelFetch(hiZ, high, level).r));
+    return nearest <= farthest;
+}
+
+void main()
+{
+    vPositionScale = aPositionScale;
+    vColor = aColor;
+
+    vec3 center = aPositionScale.xyz + meshBounds.xyz * aPositionScale.w;
+    float radius = meshBounds.w * aPositionScale.w;
+
+    bool visible = insideFrustum(center, radius) && (!useHiZ || visibleInHiZ(center, radius));
+    vVisible = visible ? 1 : 0;
+}
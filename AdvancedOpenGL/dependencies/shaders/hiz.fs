@@ -0,0 +1,36 @@
+# version 330 core
+
+// Hi-Z pyramid passes (hiz.h), one of
+//  HIZ_COPY    level 0: the frame's depth buffer as it is
+//  HIZ_REDUCE  level n: farthest depth of level n - 1's 2x2 block, the base level is set to n - 1 so lod 0 is that level
+// odd sizes: the last column / row also takes the leftover texel of the level above, nothing gets dropped
+
+out float depth;
+
+uniform sampler2D depthLevel;
+
+float fetch(ivec2 coord, ivec2 size)
+{
+    return texelFetch(depthLevel, min(coord, size - 1), 0).r;
+}
+
+void main()
+{
+    ivec2 size = textureSize(depthLevel, 0);
+
+#if defined(HIZ_COPY)
+    depth = fetch(ivec2(gl_FragCoord.xy), size);
+#elif defined(HIZ_REDUCE)
+    ivec2 coord = ivec2(gl_FragCoord.xy) * 2;
+    depth = max(max(fetch(coord, size), fetch(coord + ivec2(1, 0), size)), max(fetch(coord + ivec2(0, 1), size), fetch(coord + ivec2(1, 1), size)));
+
+    bool lastColumn = (size.x & 1) != 0 && coord.x == size.x - 3;
+    bool lastRow = (size.y & 1) != 0 && coord.y == size.y - 3;
+    if (lastColumn)
+        depth = max(depth, max(fetch(coord + ivec2(2, 0), size), fetch(coord + ivec2(2, 1), size)));
+    if (lastRow)
+        depth = max(depth, max(fetch(coord + ivec2(0, 2), size), fetch(coord + ivec2(1, 2), size)));
+    if (lastColumn && lastRow)
+        depth = max(depth, fetch(coord + ivec2(2, 2), size));
+#endif
+}
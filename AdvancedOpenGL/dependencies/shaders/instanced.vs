@@ -0,0 +1,16 @@
+# version 330 core
+
+// unlit instanced mesh (gpu_culling.h), one instance per position + scale and color
+// FrameData comes from frame_data.glsl
+
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in vec4 aInstancePositionScale; // xyz = position, w = uniform scale
+layout (location = 4) in vec4 aInstanceColor;
+
+out vec3 instanceColor;
+
+void main()
+{
+    instanceColor = aInstanceColor.rgb;
+    gl_Position = projection * view * vec4(aInstancePositionScale.xyz + aPos * aInstancePositionScale.w, 1.0);
+}
@@ -2,10 +2,19 @@
 layout (location = 0) in vec3 aPos;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// INSTANCED: one gizmo per instance, model from attributes 3 - 6 (instancing.h)
+#ifdef INSTANCED
+layout (location = 3) in mat4 aInstanceModel;
+#endif
+
+// FrameData comes from frame_data.glsl
 
 void main()
 {
+#ifdef INSTANCED
+	gl_Position = projection * view * aInstanceModel * vec4(aPos, 1.0);
+#else
 	gl_Position = projection * view * model * vec4(aPos, 1.0);
+#endif
 }
\ No newline at end of file
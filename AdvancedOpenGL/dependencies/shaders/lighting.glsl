@@ -0,0 +1,147 @@
+// light data and the per light shading, shared by litObject.fs (forward) and deferred_light.fs
+// includers fill the surface globals below, then call the *Result functions
+
+// LightData capacity, has to match constants.h
+#ifndef MAX_POINT_LIGHTS
+    #define MAX_POINT_LIGHTS 256
+#endif
+#ifndef MAX_DIR_LIGHTS
+    #define MAX_DIR_LIGHTS 4
+#endif
+#ifndef MAX_SPOT_LIGHTS
+    #define MAX_SPOT_LIGHTS 32
+#endif
+
+// packed as in lights.h (GPUPointLight, ...)
+struct PointLight{
+    vec4 colorStrength; // rgb = color, a = strength
+    vec4 position;      // w = range
+};
+
+struct DirectionalLight{
+    vec4 colorStrength;
+    vec4 direction;
+};
+
+struct SpotLight{
+    vec4 colorStrength;
+    vec4 position;  // w = range
+    vec4 direction;
+    vec4 cutoffs;   // x = cos(inner cutoff), y = cos(outer cutoff)
+};
+
+layout (std140) uniform LightData // lights.h, binding LIGHT_DATA_BINDING
+{
+    ivec4 lightCounts; // x = point, y = directional, z = spot
+    PointLight pointLights[MAX_POINT_LIGHTS];
+    DirectionalLight directionalLights[MAX_DIR_LIGHTS];
+    SpotLight spotLights[MAX_SPOT_LIGHTS];
+};
+
+const float AMBIENT_STRENGTH = 0.1F; // 0.1F
+const float DIFFUSE_STRENGTH = 0.45F; // 0.45F
+const float SPECULAR_STRENGTH = 0.45F; // 0.45F
+
+const float SPECULAR_POWER = 64.0F;
+
+// surface being shaded, world space
+vec3 albedo;
+vec3 specular;
+vec3 normal;
+vec3 surfacePos;
+
+// -------------------------------------------------------------------------------------------------------------------------
+
+// fades a light out towards its range, past it the light contributes nothing (clusters.h drops it)
+float RangeWindow(vec3 toLight, float range)
+{
+    float x = dot(toLight, toLight) / (range * range);
+    float window = clamp(1.0 - x * x, 0.0, 1.0);
+    return window * window;
+}
+
+vec3 PointResult(PointLight pointLight)
+{
+    vec3 norm = normalize(normal);
+    vec3 lightDir = normalize(pointLight.position.xyz - surfacePos);
+    float invDist = inversesqrt(pow(length(1.0 + pointLight.position.xyz - surfacePos), 2));
+
+    // + AMBIENT
+    vec3 ambientColor = albedo * AMBIENT_STRENGTH;
+
+    // + DIFFUSE
+    float diff = max(dot(lightDir, norm), 0.0);
+    vec3 diffuseColor = diff * albedo * DIFFUSE_STRENGTH * pointLight.colorStrength.a;
+
+    // + SPECULAR
+    vec3 viewDir = normalize(surfacePos - cameraPos.xyz);
+    vec3 reflectDir = reflect(lightDir, norm);
+
+    float spec = max(dot(viewDir, reflectDir), 0.0);
+    spec = pow(spec, SPECULAR_POWER);
+    vec3 specularColor = spec * specular * SPECULAR_STRENGTH * pointLight.colorStrength.a;
+
+    // + TOTAL
+    vec3 result = (ambientColor + diffuseColor + specularColor) * pointLight.colorStrength.rgb * invDist;
+    result *= RangeWindow(pointLight.position.xyz - surfacePos, pointLight.position.w);
+
+    return result;
+}
+
+vec3 DirectionalResult(DirectionalLight directionalLight)
+{
+    vec3 norm = normalize(normal);
+    vec3 lightDir = normalize(-directionalLight.direction.xyz); // vector should point towards light source for calculations
+
+    // + AMBIENT
+    vec3 ambientColor = albedo * AMBIENT_STRENGTH;
+
+    // + DIFFUSE
+    float diff = max(dot(lightDir, norm), 0.0);
+    vec3 diffuseColor = diff * albedo * DIFFUSE_STRENGTH;
+
+    // + SPECULAR
+    vec3 viewDir = normalize(surfacePos - cameraPos.xyz);
+    vec3 reflectDir = reflect(lightDir, norm);
+
+    float spec = max(dot(viewDir, reflectDir), 0.0);
+    spec = pow(spec, SPECULAR_POWER);
+    vec3 specularColor = spec * specular * SPECULAR_STRENGTH;
+
+    // + TOTAL
+    vec3 result = (ambientColor + diffuseColor + specularColor) * directionalLight.colorStrength.rgb * directionalLight.colorStrength.a;
+
+    return result;
+}
+
+vec3 SpotResult(SpotLight spotLight)
+{
+    vec3 norm = normalize(normal);
+    vec3 lightDir = normalize(spotLight.position.xyz - surfacePos); // vector should point towards light source for calculations
+    float invDist = inversesqrt(pow(length(1.0 + spotLight.position.xyz - surfacePos), 2));
+
+    float theta = dot(lightDir, normalize(-spotLight.direction.xyz));
+    float intensity = clamp((theta - spotLight.cutoffs.y)/(spotLight.cutoffs.x - spotLight.cutoffs.y) , 0.0, 1.0);
+
+    // + AMBIENT
+    // * only inside the cone, outside of it the light gets culled per cluster anyway
+    vec3 ambientColor = albedo * AMBIENT_STRENGTH * intensity;
+
+    // + DIFFUSE
+    float diff = max(dot(lightDir, norm), 0.0);
+    vec3 diffuseColor = diff * albedo * DIFFUSE_STRENGTH * intensity * spotLight.colorStrength.a;
+
+    // + SPECULAR
+    vec3 viewDir = normalize(surfacePos - cameraPos.xyz);
+    vec3 reflectDir = reflect(lightDir, norm);
+
+    float spec = max(dot(viewDir, reflectDir), 0.0);
+    spec = pow(spec, SPECULAR_POWER);
+    vec3 specularColor = spec * specular * SPECULAR_STRENGTH * intensity * spotLight.colorStrength.a;
+
+    // + TOTAL
+    vec3 result = (ambientColor + diffuseColor + specularColor) * spotLight.colorStrength.rgb * invDist;
+    result *= RangeWindow(spotLight.position.xyz - surfacePos, spotLight.position.w);
+
+    return result;
+}
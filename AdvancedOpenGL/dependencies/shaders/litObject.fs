@@ -1,12 +1,5 @@
 # version 330 core
 
-#ifndef NEAR_CLIP
-    #define NEAR_CLIP 0.01
-#endif
-#ifndef FAR_CLIP
-    #define FAR_CLIP 100.0
-#endif
-
 #ifndef NR_POINT
     #define NR_POINT 0
 #endif
@@ -17,45 +10,27 @@
     #define NR_SPOT 0
 #endif
 
-#ifndef MAX_MATERIALS
-    #define MAX_MATERIALS 1
+// cluster grid, has to match constants.h
+#ifndef CLUSTER_X
+    #define CLUSTER_X 16
+#endif
+#ifndef CLUSTER_Y
+    #define CLUSTER_Y 9
+#endif
+#ifndef CLUSTER_Z
+    #define CLUSTER_Z 24
 #endif
 
-#define E 2.718281828459045
+// built with frame_data.glsl, material.glsl and lighting.glsl included (see main.cpp)
 
-// -------------------------------------------------------------------------------------------------------------------------
+// variant switches (see shader_permutations.h): TEXTURED, NORMAL_MAP, OUTLINE, CLUSTERED
+// NR_POINT / NR_DIR / NR_SPOT only cap the loops, the actual light counts come from LightData
+// CLUSTERED ignores NR_POINT / NR_SPOT and shades the lights clusters.h assigned to the fragment's cluster
+// UBER turns all of them into uniforms, it is only used while the real variant compiles
 
-struct BasicMaterial {
-    vec3 albedo;
-};
-
-struct TextureMaterial {
-    sampler2D albedo;
-    sampler2D specular;
-    sampler2D normal;
-};
-
-struct PointLight{
-    vec3 lightColor;
-    float lightStrength;
-    vec3 lightPos;
-};
-
-struct DirectionalLight{
-    vec3 lightColor;
-    float lightStrength;
-    vec3 lightDir;
-};
-
-struct SpotLight{
-    vec3 lightColor;
-    float lightStrength;
-    vec3 lightPos;
-    vec3 lightDir;
-    float innerCutoff;
-    float outerCutoff;
-};
+#define E 2.718281828459045
 
+// -------------------------------------------------------------------------------------------------------------------------
 
 out vec4 FragColor;
 // in vec3 vertexColor;
@@ -63,30 +38,27 @@ in vec2 TexCoord;
 in vec3 FragPos;
 in vec3 Normal;
 
-uniform bool useTextures;
-int activeMaterial;
-// uniform int activeMaterial;
-
-uniform BasicMaterial basicMaterial;
-uniform TextureMaterial textureMaterials[MAX_MATERIALS];
-
-uniform PointLight pointLights[max(NR_POINT, 1)];
-uniform DirectionalLight directionalLights[max(NR_DIR, 1)];
-uniform SpotLight spotLights[max(NR_SPOT, 1)];
-
-uniform vec3 viewPos;
-
-const float AMBIENT_STRENGTH = 0.1F; // 0.1F
-const float DIFFUSE_STRENGTH = 0.45F; // 0.45F
-const float SPECULAR_STRENGTH = 0.45F; // 0.45F
-
-const float SPECULAR_POWER = 64.0F;
+#if defined(CLUSTERED) || defined(UBER)
+uniform usamplerBuffer clusterGrid;   // clusters.h, per cluster: x = first index, y = point count | spot count << 16
+uniform usamplerBuffer clusterLights; // per cluster: point light indices, then spot light indices
+#endif
 
-vec3 albedo;
-vec3 specular;
-vec3 localNormal;
+#if defined(OUTLINE) || defined(UBER)
+uniform vec3 outlineColor;
+#endif
 
-vec3 normal;
+#ifdef UBER
+uniform bool useOutline;
+uniform bool useClusters;
+
+    #define POINT_COUNT lightCounts.x
+    #define DIR_COUNT lightCounts.y
+    #define SPOT_COUNT lightCounts.z
+#else
+    #define POINT_COUNT min(lightCounts.x, NR_POINT)
+    #define DIR_COUNT min(lightCounts.y, NR_DIR)
+    #define SPOT_COUNT min(lightCounts.z, NR_SPOT)
+#endif
 
 // -------------------------------------------------------------------------------------------------------------------------
 
@@ -117,116 +89,87 @@ vec3 proprtionalColor(vec3 color)
 float LinearizeDepth(float depth) 
 {
     // * you dont have to convert to NDC, you can use your own inverse function to do the same
+    float near = clipPlanes.x;
+    float far = clipPlanes.y;
     float z = depth * 2.0 - 1.0; // back to NDC 
-    return (2.0 * NEAR_CLIP * FAR_CLIP) / (FAR_CLIP + NEAR_CLIP - z * (FAR_CLIP - NEAR_CLIP));
+    return (2.0 * near * far) / (far + near - z * (far - near));
 }
 
 
-vec3 PointResult(PointLight pointLight)
+// every light of the scene (up to the variant's NR_* caps)
+vec3 LoopedResult()
 {
-    vec3 norm = normalize(normal);
-    vec3 lightDir = normalize(pointLight.lightPos - FragPos);
-    float invDist = inversesqrt(pow(length(1.0 + pointLight.lightPos - FragPos), 2));
-
-    // + AMBIENT
-    vec3 ambientColor = albedo * AMBIENT_STRENGTH;
-
-    // + DIFFUSE
-    float diff = max(dot(lightDir, norm), 0.0);
-    vec3 diffuseColor = diff * albedo * DIFFUSE_STRENGTH * pointLight.lightStrength;
-
-    // + SPECULAR
-    vec3 viewDir = normalize(FragPos - viewPos);
-    vec3 reflectDir = reflect(lightDir, norm);
+    vec3 result = vec3(0.0);
 
-    float spec = max(dot(viewDir, reflectDir), 0.0);
-    spec = pow(spec, SPECULAR_POWER);
-    vec3 specularColor = spec * specular * SPECULAR_STRENGTH * pointLight.lightStrength;
+    for(int i = 0; i < POINT_COUNT; i++)
+        result += PointResult(pointLights[i]);
 
-    // + TOTAL
-    vec3 result = (ambientColor + diffuseColor + specularColor) * pointLight.lightColor * invDist;
+    for(int i = 0; i < SPOT_COUNT; i++)
+        result += SpotResult(spotLights[i]);
 
     return result;
 }
 
-vec3 DirectionalResult(DirectionalLight directionalLight)
+#if defined(CLUSTERED) || defined(UBER)
+// same exponential depth split as ClusteredLights::buildBounds
+int ClusterIndex()
 {
-    vec3 norm = normalize(normal);
-    vec3 lightDir = normalize(-directionalLight.lightDir); // vector should point towards light source for calculations
-
-    // + AMBIENT
-    vec3 ambientColor = albedo * AMBIENT_STRENGTH;
-
-    // + DIFFUSE
-    float diff = max(dot(lightDir, norm), 0.0);
-    vec3 diffuseColor = diff * albedo * DIFFUSE_STRENGTH;
-
-    // + SPECULAR
-    vec3 viewDir = normalize(FragPos - viewPos);
-    vec3 reflectDir = reflect(lightDir, norm);
-
-    float spec = max(dot(viewDir, reflectDir), 0.0);
-    spec = pow(spec, SPECULAR_POWER);
-    vec3 specularColor = spec * specular * SPECULAR_STRENGTH;
-
-    // + TOTAL
-    vec3 result = (ambientColor + diffuseColor + specularColor) * directionalLight.lightColor * directionalLight.lightStrength;
+    float depth = LinearizeDepth(gl_FragCoord.z);
+    int slice = int(log(depth / clipPlanes.x) * CLUSTER_Z / log(clipPlanes.y / clipPlanes.x));
+    ivec2 tile = ivec2(gl_FragCoord.xy / viewport.xy * vec2(CLUSTER_X, CLUSTER_Y));
 
-    return result;
+    ivec3 cluster = clamp(ivec3(tile, slice), ivec3(0), ivec3(CLUSTER_X - 1, CLUSTER_Y - 1, CLUSTER_Z - 1));
+    return cluster.x + cluster.y * CLUSTER_X + cluster.z * CLUSTER_X * CLUSTER_Y;
 }
 
-vec3 SpotResult(SpotLight spotLight)
+// only the lights assigned to this fragment's cluster
+vec3 ClusteredResult()
 {
-    vec3 norm = normalize(normal);
-    vec3 lightDir = normalize(spotLight.lightPos - FragPos); // vector should point towards light source for calculations
-    float invDist = inversesqrt(pow(length(1.0 + spotLight.lightPos - FragPos), 2));
-
-    float theta = dot(lightDir, normalize(-spotLight.lightDir));
-    float intensity = clamp((theta - spotLight.outerCutoff)/(spotLight.innerCutoff - spotLight.outerCutoff) , 0.0, 1.0);
-
-    // + AMBIENT
-    vec3 ambientColor = albedo * AMBIENT_STRENGTH;
+    uvec2 cluster = texelFetch(clusterGrid, ClusterIndex()).xy;
+    int first = int(cluster.x);
+    int pointCount = int(cluster.y & 0xFFFFu);
+    int spotCount = int(cluster.y >> 16);
 
-    // + DIFFUSE
-    float diff = max(dot(lightDir, norm), 0.0);
-    vec3 diffuseColor = diff * albedo * DIFFUSE_STRENGTH * intensity * spotLight.lightStrength;
-
-    // + SPECULAR
-    vec3 viewDir = normalize(FragPos - viewPos);
-    vec3 reflectDir = reflect(lightDir, norm);
+    vec3 result = vec3(0.0);
 
-    float spec = max(dot(viewDir, reflectDir), 0.0);
-    spec = pow(spec, SPECULAR_POWER);
-    vec3 specularColor = spec * specular * SPECULAR_STRENGTH * intensity * spotLight.lightStrength;
+    for(int i = 0; i < pointCount; i++)
+        result += PointResult(pointLights[texelFetch(clusterLights, first + i).x]);
 
-    // + TOTAL
-    vec3 result = (ambientColor + diffuseColor + specularColor) * spotLight.lightColor * invDist;
+    for(int i = 0; i < spotCount; i++)
+        result += SpotResult(spotLights[texelFetch(clusterLights, first + pointCount + i).x]);
 
     return result;
 }
+#endif
 
 void main()
 {
-    // ! activeMaterial is not initialized
-    activeMaterial = 0;
-
-    // doing this to avoid if statements
-    albedo = int(!useTextures)*(basicMaterial.albedo) + int(useTextures)*texture(textureMaterials[activeMaterial].albedo, TexCoord).rgb;
-    specular = int(!useTextures)*(basicMaterial.albedo) + int(useTextures)*texture(textureMaterials[activeMaterial].specular, TexCoord).rgb;
-    localNormal = int(!useTextures)*(vec3(0.5, 0.5, 1)) + int(useTextures)*texture(textureMaterials[activeMaterial].normal, TexCoord).rgb;
+#ifdef OUTLINE
+    FragColor = vec4(outlineColor, 1.0);
+#else
+#ifdef UBER
+    if (useOutline)
+    {
+        FragColor = vec4(outlineColor, 1.0);
+        return;
+    }
+#endif
 
-    normal = Normal + (localNormal - vec3(0.5, 0.5, 1));
+    SampleMaterial(TexCoord, Normal, albedo, specular, normal);
+    surfacePos = FragPos;
 
     vec3 result = vec3(0.0);
 
-    for(int i = 0; i < NR_POINT; i++)
-        result += PointResult(pointLights[i]);
-
-    for(int i = 0; i < NR_DIR; i++)
+    for(int i = 0; i < DIR_COUNT; i++)
         result += DirectionalResult(directionalLights[i]);
 
-    for(int i = 0; i < NR_SPOT; i++)
-        result += SpotResult(spotLights[i]);
+#if defined(UBER)
+    result += useClusters ? ClusteredResult() : LoopedResult();
+#elif defined(CLUSTERED)
+    result += ClusteredResult();
+#else
+    result += LoopedResult();
+#endif
 
 
     // remove clipping 
@@ -237,4 +180,5 @@ void main()
     FragColor =  vec4(result, 1.0);
 
     // FragColor =  vec4(vec3(LinearizeDepth(gl_FragCoord.z)), 1.0);
+#endif
 }
\ No newline at end of file
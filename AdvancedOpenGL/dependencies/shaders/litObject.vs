@@ -11,16 +11,66 @@ out vec3 FragPos;
 out vec3 Normal;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 uniform mat3 normalMat;
+// FrameData comes from frame_data.glsl
 
+// INSTANCED: model + normal matrix per instance (instancing.h), the uniforms are ignored
+#if defined(INSTANCED) || defined(UBER)
+layout (location = 3) in mat4 aInstanceModel;     // 3 - 6
+layout (location = 7) in mat3 aInstanceNormalMat; // 7 - 9
+#endif
+
+// QUANTIZED: PackedVertex (vertex_packing.h), snorm16 position inside the mesh's box, octahedral normal
+#if defined(QUANTIZED) || defined(UBER)
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+vec3 OctahedronDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+#endif
+
+#ifdef UBER
+uniform bool useQuantized;
+uniform bool useInstanced;
+#endif
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec3 position = aPos;
+    vec3 normal = aNormal;
+
+#if defined(UBER)
+    if (useQuantized)
+    {
+        position = aPos * positionScale + positionOffset;
+        normal = OctahedronDecode(aNormal.xy);
+    }
+#elif defined(QUANTIZED)
+    position = aPos * positionScale + positionOffset;
+    normal = OctahedronDecode(aNormal.xy);
+#endif
+
+    mat4 modelMat = model;
+    mat3 normalMatrix = normalMat;
+#if defined(UBER)
+    if (useInstanced)
+    {
+        modelMat = aInstanceModel;
+        normalMatrix = aInstanceNormalMat;
+    }
+#elif defined(INSTANCED)
+    modelMat = aInstanceModel;
+    normalMatrix = aInstanceNormalMat;
+#endif
+
+    gl_Position = projection * view * modelMat * vec4(position, 1.0);
     // vertexColor = aColor;
     TexCoord = aTexCoord;
-    Normal = normalMat * aNormal;
-    FragPos = vec3(model * vec4(aPos, 1.0));
-}
\ No newline at end of file
+    Normal = normalMatrix * normal;
+    FragPos = vec3(modelMat * vec4(position, 1.0));
+}
@@ -0,0 +1,69 @@
+// material sampling, shared by litObject.fs (forward) and gbuffer.fs (deferred)
+// switches: TEXTURED, NORMAL_MAP, UBER turns them into useTextures / useNormalMap
+
+#ifndef MAX_MATERIALS
+    #define MAX_MATERIALS 1
+#endif
+
+struct BasicMaterial {
+    vec3 albedo;
+};
+
+struct TextureMaterial {
+    sampler2D albedo;
+    sampler2D specular;
+    sampler2D normal;
+};
+
+uniform BasicMaterial basicMaterial;
+uniform TextureMaterial textureMaterials[MAX_MATERIALS];
+
+#ifdef UBER
+uniform bool useTextures;
+uniform bool useNormalMap;
+#endif
+
+// normal maps may be two channel (BC5): z comes back from x and y, same result for a full rgb map
+vec3 SampleNormalMap(sampler2D map, vec2 uv)
+{
+    vec2 xy = texture(map, uv).rg * 2.0 - 1.0;
+    float z = sqrt(max(1.0 - dot(xy, xy), 0.0));
+    return vec3(xy, z) * 0.5 + 0.5;
+}
+
+// variants only sample what the material actually has
+void SampleMaterial(vec2 uv, vec3 vertexNormal, out vec3 albedo, out vec3 specular, out vec3 normal)
+{
+    // ! activeMaterial is not a uniform yet
+    int activeMaterial = 0;
+
+#if defined(UBER)
+    if (useTextures)
+    {
+        albedo = texture(textureMaterials[activeMaterial].albedo, uv).rgb;
+        specular = texture(textureMaterials[activeMaterial].specular, uv).rgb;
+    }
+    else
+    {
+        albedo = basicMaterial.albedo;
+        specular = basicMaterial.albedo;
+    }
+#elif defined(TEXTURED)
+    albedo = texture(textureMaterials[activeMaterial].albedo, uv).rgb;
+    specular = texture(textureMaterials[activeMaterial].specular, uv).rgb;
+#else
+    albedo = basicMaterial.albedo;
+    specular = basicMaterial.albedo;
+#endif
+
+    vec3 localNormal;
+#if defined(UBER)
+    localNormal = useNormalMap ? SampleNormalMap(textureMaterials[activeMaterial].normal, uv) : vec3(0.5, 0.5, 1);
+#elif defined(NORMAL_MAP)
+    localNormal = SampleNormalMap(textureMaterials[activeMaterial].normal, uv);
+#else
+    localNormal = vec3(0.5, 0.5, 1);
+#endif
+
+    normal = vertexNormal + (localNormal - vec3(0.5, 0.5, 1));
+}
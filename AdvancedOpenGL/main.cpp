@@ -1,14 +1,14 @@
 // Minecraft fly controls
 // scroll to zoom
 
-// TODO check how many shaders are active after using insertDirective   {shader_s.h}
-// TODO check whether the correct shader is deleted if adding del() to compileAndLink() {shader_s.h}
 // TODO make it so that if useTextures disabled, model doesnt LOAD textures.
 // TODO make a transform struct
 // TODO outline function (pass in VAO, Transform struct)
 
 #pragma region // + INCLUDE
 
+// #define TRACK_ALLOCATIONS // count heap allocations during model import (alloc_stats.h), has to come before the includes
+
 #include <glad/glad.h>
 
 #include <GLFW/glfw3.h>
@@ -18,12 +18,25 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <lib/constants.h>
+#include <lib/gl_extensions.h>
 #include <lib/shader_s.h>
+#include <lib/shader_builder.h>
+#include <lib/shader_permutations.h>
 #include <lib/camera.h>
 #include <lib/lights.h>
 #include <lib/model.h>
 #include <lib/transform.h>
-#include <lib/effects.h>
+#include <lib/stats.h>
+#include <lib/frame_data.h>
+#include <lib/clusters.h>
+#include <lib/culling.h>
+#include <lib/occlusion.h>
+#include <lib/hiz.h>
+#include <lib/gpu_culling.h>
+#include <lib/instancing.h>
+#include <lib/render_queue.h>
+#include <lib/deferred.h>
+#include <lib/gpu_timer.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <lib/stb_image.h>
@@ -54,44 +67,20 @@ float lightStrength = 3.0f;
 
 bool firstMouse = true;
 bool useTextures = true;
+bool useClusters = true; // C toggles, compare against looping over every light
+bool useDeferred = false; // G toggles, deferred shading instead of forward
+bool useGpuCulling = true; // V toggles, GPU culled instance field vs drawing every instance
+int backpackCopiesMode = 0; // B cycles: off, BACKPACK_COPIES backpacks one draw per copy, the same as instances
 
 float lastX, lastY;
 
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 
+// shared (texture_cache.h) and streamed (texture_streamer.h): usable right away, the image shows up a few frames later
+// Textures().Release(*texture) when done with it
 void imgToTexID(const char *filename, unsigned int *texture, GLint wrapMode) // ! check out model.TextureFromFile
 {
-    glGenTextures(1, texture); // +
-
-    glBindTexture(GL_TEXTURE_2D, *texture); // +
-
-    //* Wrapping method
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
-
-    // ! huh this is stupid doing it redundant
-    //* Filtering method
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); // scale down
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);  // scale up
-
-    //* Mipmaps interpolate method
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    int width, height, nrChannels; // number of color channels
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char *data = stbi_load(filename, &width, &height, &nrChannels, 0);
-
-    if (data)
-    {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-    {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    stbi_image_free(data);
+    *texture = Textures().Acquire(filename, wrapMode, true);
 }
 
 int main()
@@ -132,6 +121,7 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    loadGLExtensions((GLADloadproc)glfwGetProcAddress);
 #pragma endregion
 
 #pragma region 'global OpenGL states'
@@ -154,16 +144,50 @@ int main()
 #pragma endregion
 
 #pragma region // + Shader Init
-    Shader litShader("dependencies/shaders/litObject.vs", "dependencies/shaders/litObject.fs");
-    Shader lightSourceShader("dependencies/shaders/light.vs", "dependencies/shaders/light.fs");
-    Shader singleColorShader("dependencies/shaders/singleColor.vs", "dependencies/shaders/singleColor.fs");
-
-    litShader.insertDirective(1, "#define NEAR_CLIP " + std::to_string(NEAR_CLIP));
-    litShader.insertDirective(1, "#define FAR_CLIP " + std::to_string(FAR_CLIP));
-    litShader.insertDirective(1, "#define NR_POINT " + std::to_string(POINT_LIGHT_NR));
-    litShader.insertDirective(1, "#define NR_DIR " + std::to_string(DIR_LIGHT_NR));
-    litShader.insertDirective(1, "#define NR_SPOT " + std::to_string(POINT_LIGHT_NR));
-    litShader.insertDirective(1, "#define MAX_MATERIALS " + std::to_string(MAX_MATERIALS));
+    double shaderStartTime = glfwGetTime();
+
+    // litObject variants are compiled on first use, see shader_permutations.h
+    ShaderPermutations litVariants("dependencies/shaders/litObject.vs", "dependencies/shaders/litObject.fs");
+    litVariants.define(1, "MAX_MATERIALS", MAX_MATERIALS);
+    litVariants.define(1, "MAX_POINT_LIGHTS", MAX_POINT_LIGHTS);
+    litVariants.define(1, "MAX_DIR_LIGHTS", MAX_DIR_LIGHTS);
+    litVariants.define(1, "MAX_SPOT_LIGHTS", MAX_SPOT_LIGHTS);
+    litVariants.define(1, "CLUSTER_X", CLUSTER_X);
+    litVariants.define(1, "CLUSTER_Y", CLUSTER_Y);
+    litVariants.define(1, "CLUSTER_Z", CLUSTER_Z);
+    litVariants.include(0, "dependencies/shaders/frame_data.glsl");
+    litVariants.include(1, "dependencies/shaders/frame_data.glsl");
+    litVariants.include(1, "dependencies/shaders/material.glsl");
+    litVariants.include(1, "dependencies/shaders/lighting.glsl");
+
+    // deferred geometry pass, same feature bits (only the material ones matter), see deferred.h
+    ShaderPermutations gbufferVariants("dependencies/shaders/litObject.vs", "dependencies/shaders/gbuffer.fs");
+    gbufferVariants.define(1, "MAX_MATERIALS", MAX_MATERIALS);
+    gbufferVariants.include(0, "dependencies/shaders/frame_data.glsl");
+    gbufferVariants.include(1, "dependencies/shaders/material.glsl");
+
+    // every light gizmo in one instanced draw
+    Shader lightSourceShader = ShaderBuilder("dependencies/shaders/light.vs", "dependencies/shaders/light.fs")
+                                   .define(0, "INSTANCED")
+                                   .include(0, "dependencies/shaders/frame_data.glsl")
+                                   .buildAsync();
+
+    Shader instancedShader = ShaderBuilder("dependencies/shaders/instanced.vs", "dependencies/shaders/instanced.fs")
+                                 .include(0, "dependencies/shaders/frame_data.glsl")
+                                 .buildAsync();
+
+    // * everything is submitted up front and compiles in the background (KHR_parallel_shader_compile)
+    // the uber shader stands in for variants that aren't linked yet
+    litVariants.Prepare(FEATURE_UBER);
+    litVariants.Prepare(FEATURE_OUTLINE);
+    gbufferVariants.Prepare(FEATURE_UBER);
+    gbufferVariants.Prepare(FEATURE_OUTLINE);
+
+    // warm = every program came out of the binary cache
+    std::cout << "shader startup: " << (glfwGetTime() - shaderStartTime) * 1000.0 << " ms, "
+              << Shader::buildCount << " programs built, "
+              << (!glExt.programBinary ? "binary cache unsupported" : ProgramCache::misses ? "cold cache" : "warm cache")
+              << " (" << ProgramCache::hits << " hits, " << ProgramCache::misses << " misses)" << std::endl;
 #pragma endregion
 
 #pragma region // + Cube Vertices Init
@@ -268,37 +292,124 @@ int main()
     stbi_set_flip_vertically_on_load(true);
 
     Model bagModel("media/backpack/backpack.obj");
+    MeshHeap().Stats().Print();
+    Textures().Print();
 
 #pragma endregion
 
 #pragma region // + Textures and Pre-Loop
 
-    litShader.use();
-    litShader.setBool("useTextures", useTextures);
+    // * lights live in one uniform buffer shared by every variant, see lights.h
+    LightManager lights;
 
     for (int i = 0; i < POINT_LIGHT_NR; i++)
     {
-        PointLight(&litShader, lightColor, lightStrength, lightPositions[i], i);
+        PointLight(&lights, lightColor, lightStrength, lightPositions[i]);
     }
 
     for (int i = 0; i < DIR_LIGHT_NR; i++)
     {
-        DirectionalLight(&litShader, lightColor, lightStrength, sunDir, i);
+        DirectionalLight(&lights, lightColor, lightStrength, sunDir);
     }
 
-    for (int i = 0; i < SPOT_LIGHT_NR; i++)
+    SpotLight flashlight(&lights, lightColor, lightStrength, camera.Position, camera.LookDir, 12.5f, 17.5f);
+
+    // * a field of small colored lights below the scene, each one only reaches a few clusters
+    for (int i = 0; i < SCATTER_LIGHT_NR; i++)
     {
-        SpotLight(&litShader, lightColor, lightStrength, lightPositions[i], camera.LookDir, 12.5f, 17.5f, i);
+        int row = i / 16, column = i % 16;
+        glm::vec3 position = glm::vec3(-12.0f + column * 1.6f, -2.0f, -12.0f + row * 2.0f);
+        glm::vec3 color = 0.5f + 0.5f * glm::cos(glm::vec3(0.0f, 2.1f, 4.2f) + i * 0.7f);
+
+        PointLight(&lights, color, 1.0f, position, 2.5f);
+    }
+
+    // assigns lights to clusters every frame, see clusters.h
+    ClusteredLights clusters;
+
+    // G-buffer + lighting programs, sized to the framebuffer every frame
+    DeferredRenderer deferred(SCR_WIDTH, SCR_HEIGHT);
+
+    // static uniforms, uploaded once into every variant when it gets compiled
+    litVariants.onCompile = [&](Shader &shader)
+    {
+        shader.setVec3("basicMaterial.albedo", glm::value_ptr(objColor));
+    };
+    gbufferVariants.onCompile = litVariants.onCompile;
+
+    // everything the scene allows, each draw narrows this down to what its material has (light buckets get recomputed every frame)
+    unsigned int materialFeatures = useTextures ? FEATURE_TEXTURED | FEATURE_NORMAL_MAP : 0;
+    unsigned int loopedFeatures = materialFeatures | LightFeatures(lights.PointCount(), lights.DirectionalCount(), lights.SpotCount());
+    unsigned int clusteredFeatures = materialFeatures | LightFeatures(0, lights.DirectionalCount(), 0) | FEATURE_CLUSTERED;
+
+    // both paths, so toggling doesn't hit the uber shader
+    for (unsigned int features : {clusteredFeatures, loopedFeatures})
+    {
+        litVariants.Prepare(MatchFeatures(0, features));
+        bagModel.PrepareVariants(&litVariants, features);
     }
+    gbufferVariants.Prepare(MatchFeatures(0, materialFeatures));
+    bagModel.PrepareVariants(&gbufferVariants, materialFeatures);
 
-    if (!useTextures)
-        litShader.setVec3("basicMaterial.albedo", glm::value_ptr(objColor));
+    // A/B numbers for forward vs deferred, clustered vs looped
+    GpuTimer gpuTimer;
 
     Outline outlineProperties;
     outlineProperties.outlineColor = glm::vec3(0.84, 0.568, 0.06);
-    outlineProperties.outlineShader = &singleColorShader;
     outlineProperties.outlineThickness = 0.01f;
 
+    // view, projection, camera position, time and clip planes for every program
+    FrameUniforms frameUniforms;
+
+    // cubes + light gizmos, refilled every frame
+    OcclusionBuffer occlusion;
+    BoundingBoxes sceneBoxes;
+    std::vector<unsigned char> sceneVisible;
+
+    // every opaque draw of the frame (cubes, model meshes) and their outlines, refilled every frame
+    RenderQueue renderQueue;
+
+    // light gizmo placements, refilled every frame
+    InstanceBuffer lightInstanceBuffer;
+    std::vector<InstanceTransform> lightInstances;
+
+    // * a ring of small cubes around the scene, culled on the GPU against the frustum and last frame's depth (gpu_culling.h)
+    HiZPyramid hiZ;
+    GpuInstanceCuller instanceField;
+    {
+        std::vector<GpuInstance> instances(GPU_CULL_INSTANCES);
+        for (int i = 0; i < GPU_CULL_INSTANCES; i++)
+        {
+            float t = (float)i / GPU_CULL_INSTANCES;
+            float angle = i * 2.39996f; // golden angle, evenly spread without a pattern
+            float radius = 15.0f + 45.0f * std::sqrt(t);
+
+            instances[i].positionScale = glm::vec4(std::cos(angle) * radius, 4.0f * std::sin(i * 0.37f), std::sin(angle) * radius, 0.2f + 0.4f * std::fmod(i * 0.618034f, 1.0f));
+            instances[i].color = glm::vec4(0.5f + 0.5f * glm::cos(glm::vec3(0.0f, 2.1f, 4.2f) + i * 0.7f), 1.0f);
+        }
+        instanceField.SetInstances(instances);
+    }
+
+    // * the backpack BACKPACK_COPIES times on a grid behind the scene, drawn copy by copy or instanced (B)
+    std::vector<Transform> backpackCopies;
+    std::vector<ModelPlacement> backpackPlacements(BACKPACK_COPIES); // every copy keeps its own LODs
+    InstanceBuffer backpackInstanceBuffer;
+    {
+        std::vector<InstanceTransform> instances;
+        for (int i = 0; i < BACKPACK_COPIES; i++)
+        {
+            Transform transform;
+            transform.position = glm::vec3(-14.0f + (i % 8) * 4.0f, 0.0f, -12.0f - (i / 8) * 4.0f);
+            backpackCopies.push_back(transform);
+            instances.push_back(InstanceTransform(transform));
+        }
+        backpackInstanceBuffer.Upload(instances);
+    }
+    unsigned int backpackCopiesDrawCalls = 0;
+
+    float lastStatsPrint = 0.0f;
+    bool firstFrame = true;
+
 #pragma endregion
 
     // + RENDER LOOP
@@ -315,31 +426,60 @@ int main()
         glClearColor(0.09f, 0.11f, 0.13f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT); // for after image, remove color buffer bit
 
-        litShader.use();
+        gpuTimer.Begin();
+
+        Streamer().Update();
+        litVariants.Poll();
+        gbufferVariants.Poll();
 
 #pragma region CAMERA
         glm::mat4 view = camera.GetViewMatrix();
         glm::mat4 projection = glm::mat4(1.0f);
         projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, (float)NEAR_CLIP, (float)FAR_CLIP);
 
-        litShader.setVec3("viewPos", glm::value_ptr(camera.Position));
+        FrameData frameData;
+        frameData.view = view;
+        frameData.projection = projection;
+        frameData.cameraPos = glm::vec4(camera.Position, currentFrame);
+        frameData.clipPlanes = glm::vec4(NEAR_CLIP, FAR_CLIP, 0.0f, 0.0f);
+
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        frameData.viewport = glm::vec4(framebufferWidth, framebufferHeight, 0.0f, 0.0f);
+        frameUniforms.Update(frameData);
+
+        // only the flashlight moves, one small upload per frame
+        flashlight.SetLightPos(camera.Position);
+        flashlight.SetLightDir(camera.LookDir);
+        lights.Upload();
+
+        // light buckets from this frame's counts: a light added at runtime moves the scene up a bucket, that variant compiles in the
+        // background (the uber shader covers it until then) instead of the new light being cut off by the old bucket's loop bound
+        loopedFeatures = materialFeatures | LightFeatures(lights.PointCount(), lights.DirectionalCount(), lights.SpotCount());
+        clusteredFeatures = materialFeatures | LightFeatures(0, lights.DirectionalCount(), 0) | FEATURE_CLUSTERED;
 
-        litShader.setVec3("spotLights[0].lightPos", glm::value_ptr(camera.Position));
-        litShader.setVec3("spotLights[0].lightDir", glm::value_ptr(camera.LookDir));
+        // * deferred: the same draws go into the G-buffer, lighting happens afterwards
+        ShaderPermutations *variants = &litVariants;
+        unsigned int sceneFeatures = useClusters ? clusteredFeatures : loopedFeatures;
 
-        litShader.setMat4("view", glm::value_ptr(view));
-        litShader.setMat4("projection", glm::value_ptr(projection));
+        if (useDeferred)
+        {
+            variants = &gbufferVariants;
+            sceneFeatures = materialFeatures;
 
-        singleColorShader.use();
-        singleColorShader.setMat4("view", glm::value_ptr(view));
-        singleColorShader.setMat4("projection", glm::value_ptr(projection));
+            deferred.Resize(framebufferWidth, framebufferHeight);
+            deferred.BeginGeometryPass();
+        }
+        else if (useClusters)
+        {
+            clusters.Update(lights, view, projection, NEAR_CLIP, FAR_CLIP);
+        }
+        clusters.Bind();
 
 #pragma endregion
 
-#pragma region STENCIL & Z-TESTING
+#pragma region CULLING
 
-        // + pass 1 normal cube
-        // -- render cube 1
         Transform cube1Transform;
 
         cube1Transform.position = glm::vec3(5.0, 0.0, 0.0);
@@ -350,54 +490,170 @@ int main()
         cube2Transform.position = glm::vec3(5.0, 4.0, 6.0);
         cube2Transform.scale = glm::vec3(2.0f, 2.0f, 1.0f);
 
-        // ! --------------------------------------------
-        outlineAndDraw(&litShader, &singleColorShader, cubeVAO, numDrawnVertices, cube1Transform, glm::vec3(0.04, 0.28, 0.26), 0.1f);
-        outlineAndDraw(&litShader, &singleColorShader, cubeVAO, numDrawnVertices, cube2Transform, glm::vec3(0.84, 0.568, 0.06), 0.1f);
+        Transform modelTransform;
+
+        modelTransform.position = glm::vec3(0.0f, 0.0f, 0.0f);
+        modelTransform.scale = glm::vec3(1.0f, 1.0f, 1.0f);
+
+        // * occluders (the cubes + the backpack) into the CPU depth buffer, everything drawn below gets tested against it
+        occlusion.Begin(projection * view);
+        occlusion.AddCube(cube1Transform.GetModelMat());
+        occlusion.AddCube(cube2Transform.GetModelMat());
+        bagModel.AddOccluders(occlusion, modelTransform);
+        occlusion.Rasterize();
+
+        // * frustum + occlusion cull what main draws itself, boxes in world space (the unit cube times scale, outline included)
+        // the model culls its own meshes in Draw
+        glm::vec3 cubeHalf1 = (cube1Transform.scale + glm::vec3(0.1f)) * 0.5f, cubeHalf2 = (cube2Transform.scale + glm::vec3(0.1f)) * 0.5f;
+        sceneBoxes.Clear();
+        sceneBoxes.Push(cube1Transform.position - cubeHalf1, cube1Transform.position + cubeHalf1);
+        sceneBoxes.Push(cube2Transform.position - cubeHalf2, cube2Transform.position + cubeHalf2);
+        for (const glm::vec3 &lightPosition : lightPositions)
+            sceneBoxes.Push(lightPosition - glm::vec3(0.05f), lightPosition + glm::vec3(0.05f));
+        sceneBoxes.Pad();
+        CullBoxes(camera.GetFrustum(projection), sceneBoxes, sceneVisible);
+        occlusion.Cull(sceneBoxes, glm::mat4(1.0f), sceneVisible);
 
 #pragma endregion
 
-#pragma region MODEL
+#pragma region RENDER QUEUE
 
-        Transform modelTransform;
+        // * cubes and the model's meshes go into one queue: sorted by program and textures, front to back,
+        // outlines in a pass of their own after every object is in the stencil buffer
 
-        modelTransform.position = glm::vec3(0.0f, 0.0f, 0.0f);
-        modelTransform.scale = glm::vec3(1.0f, 1.0f, 1.0f);
-        glm::mat4 modelMat = modelTransform.GetModelMat();
-        glm::mat3 normalMat = modelTransform.GetNormalMat();
+        // re-fetched every frame, these are the uber shader until the variants are linked
+        Shader *cubeShader = variants->Get(MatchFeatures(0, sceneFeatures));
+        Shader *outlineShader = variants->Get(FEATURE_OUTLINE);
 
-        litShader.setMat3("normalMat", glm::value_ptr(normalMat));
-        litShader.setMat4("model", glm::value_ptr(modelMat));
+        renderQueue.Clear();
+
+        Transform *cubeTransforms[] = {&cube1Transform, &cube2Transform};
+        glm::vec3 cubeOutlineColors[] = {glm::vec3(0.04, 0.28, 0.26), glm::vec3(0.84, 0.568, 0.06)};
+        for (int i = 0; i < 2; i++)
+        {
+            if (!sceneVisible[i])
+                continue;
+
+            RenderItem cube;
+            cube.shader = cubeShader;
+            cube.vao = cubeVAO;
+            cube.vertexCount = numDrawnVertices;
+            cube.model = cubeTransforms[i]->GetModelMat();
+            cube.normalMat = cubeTransforms[i]->GetNormalMat();
+            cube.depth = -(view * glm::vec4(cubeTransforms[i]->position, 1.0f)).z;
+            renderQueue.Submit(cube);
+
+            // absolute thickness: scale + 0.1, not scale * 1.1
+            Transform outlineTransform = *cubeTransforms[i];
+            outlineTransform.scale += 0.1f;
+
+            cube.pass = RENDER_PASS_OUTLINE;
+            cube.shader = outlineShader;
+            cube.model = outlineTransform.GetModelMat();
+            cube.normalMat = outlineTransform.GetNormalMat();
+            cube.color = cubeOutlineColors[i];
+            renderQueue.Submit(cube);
+        }
 
         outlineProperties.transform = modelTransform;
+        outlineProperties.outlineShader = outlineShader;
         bagModel.IsOutlineEnabled(true, outlineProperties);
-        bagModel.Draw(&litShader);
+        bagModel.Submit(renderQueue, variants, sceneFeatures, modelTransform, frameData, &occlusion);
+
+        renderQueue.Execute();
 
 #pragma endregion
 
-#pragma region LIGHT SOURCES
+#pragma region BACKPACK COPIES
 
-        lightSourceShader.use();
-        lightSourceShader.setMat4("view", glm::value_ptr(view));
-        lightSourceShader.setMat4("projection", glm::value_ptr(projection));
+        // O(copies * meshes) draws one copy at a time, O(meshes) instanced
+        if (backpackCopiesMode != 0)
+        {
+            unsigned int drawCallsBefore = frameStats.drawCalls;
+
+            bagModel.IsOutlineEnabled(false, outlineProperties);
+            if (backpackCopiesMode == 1)
+            {
+                for (int i = 0; i < BACKPACK_COPIES; i++)
+                    bagModel.Draw(variants, sceneFeatures, backpackCopies[i], &frameData, NULL, &backpackPlacements[i]);
+            }
+            else
+            {
+                // full detail for every copy, the instanced draw has one LOD for all of them
+                bagModel.DrawInstanced(variants, sceneFeatures, backpackInstanceBuffer, 0);
+            }
+
+            backpackCopiesDrawCalls = frameStats.drawCalls - drawCallsBefore;
+        }
+
+        if (useDeferred)
+            deferred.LightingPass(lights, view, projection);
+
+#pragma endregion
+
+#pragma region LIGHT SOURCES
 
-        glBindVertexArray(lightVAO);
+        // the visible gizmos as instances, one draw for all of them
+        lightInstances.clear();
         for (int i = 0; i < (sizeof(lightPositions) / sizeof(lightPositions[0])); i++)
         {
+            if (!sceneVisible[2 + i])
+                continue;
+
             glm::mat4 model = glm::mat4(1.0f);
             model = glm::translate(model, lightPositions[i]);
             model = glm::scale(model, glm::vec3(0.1));
 
-            lightSourceShader.setMat4("model", glm::value_ptr(model));
-
-            glDrawArrays(GL_TRIANGLES, 0, numDrawnVertices);
+            lightInstances.push_back(InstanceTransform(model));
         }
+        lightInstanceBuffer.Upload(lightInstances);
+
+        lightSourceShader.use();
+        lightInstanceBuffer.DrawArrays(lightVAO, numDrawnVertices);
+
+#pragma endregion
+
+#pragma region INSTANCE FIELD
+
+        // the unit cube's bounding sphere (radius sqrt(3) / 2), each instance scales it
+        if (useGpuCulling)
+            instanceField.Cull(camera.GetFrustum(projection), &hiZ, glm::vec3(0.0f), 0.866f);
+
+        instancedShader.use();
+        if (useGpuCulling)
+            instanceField.Draw(cubeVAO, numDrawnVertices);
+        else
+            instanceField.DrawAll(cubeVAO, numDrawnVertices);
 
 #pragma endregion
 
         glBindVertexArray(0);
 
+        gpuTimer.End();
+
+        // * depth of the finished frame, next frame's GPU culling tests against it
+        if (useGpuCulling)
+            hiZ.Build(framebufferWidth, framebufferHeight, projection * view);
+
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        if (firstFrame)
+        {
+            std::cout << "time to first frame: " << glfwGetTime() * 1000.0 << " ms" << std::endl;
+            firstFrame = false;
+        }
+
+        // * once a second, print what the last frame cost
+        if (currentFrame - lastStatsPrint >= 1.0f)
+        {
+            frameStats.Print();
+            if (backpackCopiesMode != 0)
+                std::cout << "backpack copies: " << BACKPACK_COPIES << (backpackCopiesMode == 1 ? " one draw each" : " instanced")
+                          << ", " << backpackCopiesDrawCalls << " draw calls" << std::endl;
+            lastStatsPrint = currentFrame;
+        }
+        frameStats.Reset();
     }
 
     // + END RENDER LOOP
@@ -406,8 +662,23 @@ int main()
     glDeleteVertexArrays(1, &cubeVAO);
     glDeleteBuffers(1, &VBO);
 
-    litShader.del();
+    litVariants.del();
+    gbufferVariants.del();
+    deferred.del();
+    gpuTimer.del();
     lightSourceShader.del();
+    lightInstanceBuffer.del();
+    backpackInstanceBuffer.del();
+    instancedShader.del();
+    instanceField.del();
+    hiZ.del();
+    frameUniforms.del();
+    lights.del();
+    clusters.del();
+    bagModel.del();
+    MeshHeap().del();
+    Textures().del();
+    Streamer().del();
 
     glfwTerminate();
     return 0;
@@ -430,6 +701,44 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(UP, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
         camera.ProcessKeyboard(DOWN, deltaTime);
+
+    // toggles act on the press, not every frame the key is held
+    static bool clusterKeyHeld = false;
+    bool clusterKey = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+    if (clusterKey && !clusterKeyHeld)
+    {
+        useClusters = !useClusters;
+        std::cout << (useClusters ? "clustered lighting" : "looping over every light") << std::endl;
+    }
+    clusterKeyHeld = clusterKey;
+
+    static bool deferredKeyHeld = false;
+    bool deferredKey = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    if (deferredKey && !deferredKeyHeld)
+    {
+        useDeferred = !useDeferred;
+        std::cout << (useDeferred ? "deferred shading" : "forward shading") << std::endl;
+    }
+    deferredKeyHeld = deferredKey;
+
+    static bool gpuCullingKeyHeld = false;
+    bool gpuCullingKey = glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS;
+    if (gpuCullingKey && !gpuCullingKeyHeld)
+    {
+        useGpuCulling = !useGpuCulling;
+        std::cout << (useGpuCulling ? "GPU culled instances" : "drawing every instance") << std::endl;
+    }
+    gpuCullingKeyHeld = gpuCullingKey;
+
+    static bool backpackCopiesKeyHeld = false;
+    bool backpackCopiesKey = glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS;
+    if (backpackCopiesKey && !backpackCopiesKeyHeld)
+    {
+        backpackCopiesMode = (backpackCopiesMode + 1) % 3;
+        const char *modes[] = {"no backpack copies", "backpack copies, one draw each", "backpack copies, instanced"};
+        std::cout << modes[backpackCopiesMode] << std::endl;
+    }
+    backpackCopiesKeyHeld = backpackCopiesKey;
 }
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
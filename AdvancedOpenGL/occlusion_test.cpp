@@ -0,0 +1,60 @@
+// checks for the software occlusion buffer (occlusion.h), no window or GL context needed
+// clang++ -std=c++17 -O2 -Idependencies/include occlusion_test.cpp -o occlusion_test && ./occlusion_test
+// exit code = number of failed checks
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <lib/constants.h>
+#include <lib/occlusion.h>
+#include <lib/thread_pool.h>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+int failures = 0;
+
+void check(bool passed, const char *what)
+{
+    std::cout << (passed ? "PASS " : "FAIL ") << what << std::endl;
+    failures += !passed;
+}
+
+int main()
+{
+    // camera at the origin looking down -z, same clip planes as the sample
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), (float)OCCLUSION_WIDTH / OCCLUSION_HEIGHT, (float)NEAR_CLIP, (float)FAR_CLIP);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    // one 2 x 2 quad occluder, 5 units in front of the camera
+    std::vector<glm::vec3> quad = {{-1.0f, -1.0f, -5.0f}, {1.0f, -1.0f, -5.0f}, {1.0f, 1.0f, -5.0f}, {-1.0f, 1.0f, -5.0f}};
+    std::vector<unsigned int> indices = {0, 1, 2, 0, 2, 3};
+
+    OcclusionBuffer occlusion;
+    occlusion.Begin(projection * view);
+    occlusion.AddOccluder(quad, indices, glm::mat4(1.0f));
+    occlusion.Rasterize();
+
+    // + boxes, 0.4 wide unless they need to be bigger
+    glm::vec3 half(0.2f);
+    auto visible = [&](glm::vec3 center, glm::vec3 extent)
+    {
+        return occlusion.IsVisible(center - extent, center + extent, glm::mat4(1.0f));
+    };
+
+    check(!visible(glm::vec3(0.0f, 0.0f, -10.0f), half), "box behind the quad is hidden");
+    check(visible(glm::vec3(0.0f, 0.0f, -3.0f), half), "box in front of the quad is visible");
+    check(visible(glm::vec3(3.0f, 0.0f, -5.0f), half), "box beside the quad is visible");
+    check(visible(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.2f, 0.2f, 0.5f)), "box crossing the near plane is visible");
+
+    // + depth buffer, the screen center is covered by the quad, a corner isn't
+    glm::vec4 quadClip = projection * view * glm::vec4(0.0f, 0.0f, -5.0f, 1.0f);
+    float quadDepth = quadClip.z / quadClip.w * 0.5f + 0.5f;
+
+    check(std::abs(occlusion.Depth(OCCLUSION_WIDTH / 2, OCCLUSION_HEIGHT / 2) - quadDepth) < 1e-5f, "depth at a covered pixel is the quad's");
+    check(occlusion.Depth(0, 0) == 1.0f, "depth at an uncovered pixel is cleared");
+
+    std::cout << failures << " failed" << std::endl;
+    return failures;
+}
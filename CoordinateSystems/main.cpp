@@ -191,12 +191,14 @@ int main()
     // ---------------------------------------------------
 
     int numIndices = sizeof(indices) / sizeof(indices[0]);
+    const int numCubes = sizeof(cubePositions) / sizeof(cubePositions[0]);
 
-    unsigned int VBO, EBO, VAO;
+    unsigned int VBO, EBO, VAO, instanceVBO;
 
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
+    glGenBuffers(1, &instanceVBO);
 
     glBindVertexArray(VAO);
 
@@ -212,6 +214,17 @@ int main()
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(3 * sizeof(float)));
     glEnableVertexAttribArray(2);
 
+    // * one model matrix per cube, a mat4 attribute is 4 vec4 columns; divisor 1 = advances per instance, not per vertex
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, numCubes * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+
+    for (int column = 0; column < 4; column++)
+    {
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void *)(column * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(3 + column);
+        glVertexAttribDivisor(3 + column, 1);
+    }
+
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
@@ -269,7 +282,9 @@ int main()
 
         shaderProgram.setMat4("projection", glm::value_ptr(projection));
 
-        for (int i = 0; i < (sizeof(cubePositions) / sizeof(cubePositions[0])); i++)
+        // every cube's model matrix into the instance buffer, then all of them in one draw
+        glm::mat4 models[numCubes];
+        for (int i = 0; i < numCubes; i++)
         {
             float rot = 20.0f * i;
 
@@ -277,10 +292,14 @@ int main()
             model = glm::translate(model, cubePositions[i]);
             model = glm::rotate(model, (float)glfwGetTime() + glm::radians(rot), glm::vec3(0.5f, 0.3f, 0.4f));
 
-            shaderProgram.setMat4("model", glm::value_ptr(model));
-
-            glDrawElements(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, 0);
+            models[i] = model;
         }
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(models), models);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        glDrawElementsInstanced(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, 0, numCubes);
         glBindVertexArray(0); // no need to unbind it every time
 
         glfwSwapBuffers(window);
@@ -289,6 +308,7 @@ int main()
 
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &instanceVBO);
 
     shaderProgram.del();
 